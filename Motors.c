@@ -13,8 +13,10 @@
 #include "driverlib/pin_map.h"
 #include "driverlib/gpio.h"
 #include "driverlib/sysctl.h"
+#include "driverlib/interrupt.h"
 #include "inc/hw_memmap.h"
 
+#include "kernel.h"
 #include "motors.h"
 
 // PWM configuration
@@ -47,9 +49,51 @@
 
 #define PWM_DIVIDER 1
 
+// 1 holds new duties until both are written, then releases them
+// together on each generator's next period boundary. Main and tail are
+// on different PWM modules, so that is the same boundary only as far
+// as the two generators are in phase. 0 updates each at its own next
+// boundary as soon as it is written.
+#define PWM_GLOBAL_SYNC 1
 
-int32_t g_setMainDuty;
-int32_t g_setTailDuty;
+#if PWM_GLOBAL_SYNC
+#define PWM_GEN_MODE (PWM_GEN_MODE_UP_DOWN | PWM_GEN_MODE_SYNC)
+#else
+#define PWM_GEN_MODE (PWM_GEN_MODE_UP_DOWN | PWM_GEN_MODE_NO_SYNC)
+#endif
+
+/*
+ * The generator and output driving each motor
+ */
+typedef struct {
+    uint32_t Base;
+    uint32_t Gen;
+    uint32_t GenBit;
+    uint32_t OutNum;
+} MotorPwm_t;
+
+static const MotorPwm_t g_motorPwm[NUM_MOTORS] = {
+    [MOTOR_MAIN] = {PWM_MAIN_BASE, PWM_MAIN_GEN, PWM_GEN_3_BIT, PWM_MAIN_OUTNUM},
+    [MOTOR_TAIL] = {PWM_TAIL_BASE, PWM_TAIL_GEN, PWM_GEN_2_BIT, PWM_TAIL_OUTNUM}
+};
+
+// Generator period in PWM clocks, set once at PWM_START_RATE_HZ
+static uint32_t g_pwmPeriod;
+
+// Last duty and pulse width written to each motor, so repeats
+// are skipped. Written from both tiers (the controller, and the
+// hover and landing ramps), so only with interrupts masked.
+static uint16_t g_dutyPermille[NUM_MOTORS];
+static uint32_t g_pulseWidth[NUM_MOTORS];
+
+// Latency histograms, kept by the controller and published for readers
+// when they ask, not on every control run
+static uint32_t g_cyclesPerUs;
+static LatencyHist_t g_latency[NUM_MOTORS];
+static LatencyHist_t g_latencyBuffer[NUM_MOTORS][2];
+static Mailbox_t g_latencyMailbox[NUM_MOTORS];
+static volatile bool g_latencyReset;
+static volatile bool g_latencyRequest;
 
 // Initialise PWM M0PWM7 (J4-05, PC5) is used for the main rotor motor
 void
@@ -59,17 +103,23 @@ InitMotors(void)
     SysCtlPeripheralEnable(PWM_MAIN_PERIPH_GPIO);
     GPIOPinConfigure(PWM_MAIN_GPIO_CONFIG);
     GPIOPinTypePWM(PWM_MAIN_GPIO_BASE, MAIN_MOTOR_PIN);
-    PWMGenConfigure(PWM_MAIN_BASE, PWM_MAIN_GEN, PWM_GEN_MODE_UP_DOWN | PWM_GEN_MODE_NO_SYNC);
+    PWMGenConfigure(PWM_MAIN_BASE, PWM_MAIN_GEN, PWM_GEN_MODE);
 
     SysCtlPeripheralEnable(PWM_TAIL_PERIPH_PWM);
     SysCtlPeripheralEnable(PWM_TAIL_PERIPH_GPIO);
     GPIOPinConfigure(PWM_TAIL_GPIO_CONFIG);
     GPIOPinTypePWM(PWM_TAIL_GPIO_BASE, TAIL_MOTOR_PIN);
-    PWMGenConfigure(PWM_TAIL_BASE, PWM_TAIL_GEN, PWM_GEN_MODE_UP_DOWN | PWM_GEN_MODE_NO_SYNC);
+    PWMGenConfigure(PWM_TAIL_BASE, PWM_TAIL_GEN, PWM_GEN_MODE);
 
     // Initial PWM parameters
-    SetMainPWM(PWM_FIXED_DUTY);
-    SetTailPWM(PWM_FIXED_DUTY);
+    g_pwmPeriod = SysCtlClockGet() / PWM_DIVIDER / PWM_START_RATE_HZ;
+    PWMGenPeriodSet(PWM_MAIN_BASE, PWM_MAIN_GEN, g_pwmPeriod);
+    PWMGenPeriodSet(PWM_TAIL_BASE, PWM_TAIL_GEN, g_pwmPeriod);
+
+    // Force the first write
+    g_pulseWidth[MOTOR_MAIN] = UINT32_MAX;
+    g_pulseWidth[MOTOR_TAIL] = UINT32_MAX;
+    SetMotorDuties(PWM_FIXED_DUTY, PWM_FIXED_DUTY);
 
     PWMGenEnable(PWM_MAIN_BASE, PWM_MAIN_GEN);
     PWMGenEnable(PWM_TAIL_BASE, PWM_TAIL_GEN);
@@ -77,40 +127,204 @@ InitMotors(void)
     // Enable the output
     PWMOutputState(PWM_MAIN_BASE, PWM_MAIN_OUTBIT, true);
     PWMOutputState(PWM_TAIL_BASE, PWM_TAIL_OUTBIT, true);
+
+    g_cyclesPerUs = SysCtlClockGet() / 1000000;
+    MailboxInit(&g_latencyMailbox[MOTOR_MAIN], g_latencyBuffer[MOTOR_MAIN], sizeof(LatencyHist_t));
+    MailboxInit(&g_latencyMailbox[MOTOR_TAIL], g_latencyBuffer[MOTOR_TAIL], sizeof(LatencyHist_t));
 }
 
+/*
+ * Has the main rotor generator (PWM0 gen 3) start an ADC conversion
+ * each time its counter reaches zero, once per period in the middle
+ * of the off time
+ */
+void
+EnableMainADCTrigger(void)
+{
+    PWMGenIntTrigEnable(PWM_MAIN_BASE, PWM_MAIN_GEN, PWM_TR_CNT_ZERO);
+}
+
+/*
+ * Writes a motor's pulse width for permille, clamped to DUTY_PERMILLE.
+ * Returns false, writing nothing, if the width hasn't changed. Call with
+ * interrupts masked so the cache and the register stay in step.
+ */
+static bool
+WriteMotorDuty(Motor_t motor, uint16_t permille)
+{
+    const MotorPwm_t* pwm = &g_motorPwm[motor];
+    uint32_t width;
+
+    if (permille > DUTY_PERMILLE) {
+        permille = DUTY_PERMILLE;
+    }
+    g_dutyPermille[motor] = permille;
 
-// Function to set the freq, duty cycle of M0PWM7
+    width = g_pwmPeriod * permille / DUTY_PERMILLE;
+    if (width == g_pulseWidth[motor]) {
+        return false;
+    }
+    g_pulseWidth[motor] = width;
+    PWMPulseWidthSet(pwm->Base, pwm->OutNum, width);
+    return true;
+}
+
+/*
+ * Sets one motor's duty in permille
+ */
 void
-SetMainPWM(uint8_t mainDuty)
+SetMotorDuty(Motor_t motor, uint16_t permille)
+{
+    bool masked = IntMasterDisable();
+
+    if (WriteMotorDuty(motor, permille)) {
+#if PWM_GLOBAL_SYNC
+        PWMSyncUpdate(g_motorPwm[motor].Base, g_motorPwm[motor].GenBit);
+#endif
+    }
+
+    if (!masked) {
+        IntMasterEnable();
+    }
+}
+
+/*
+ * Sets both duties in permille, taking effect together (see
+ * PWM_GLOBAL_SYNC)
+ */
+void
+SetMotorDuties(uint16_t mainPermille, uint16_t tailPermille)
 {
-    g_setMainDuty = mainDuty;
+    bool masked = IntMasterDisable();
+    bool main_changed = WriteMotorDuty(MOTOR_MAIN, mainPermille);
+    bool tail_changed = WriteMotorDuty(MOTOR_TAIL, tailPermille);
 
-    uint32_t ui32Period = SysCtlClockGet() / PWM_DIVIDER / PWM_START_RATE_HZ;
+#if PWM_GLOBAL_SYNC
+    if (main_changed) {
+        PWMSyncUpdate(g_motorPwm[MOTOR_MAIN].Base, g_motorPwm[MOTOR_MAIN].GenBit);
+    }
+    if (tail_changed) {
+        PWMSyncUpdate(g_motorPwm[MOTOR_TAIL].Base, g_motorPwm[MOTOR_TAIL].GenBit);
+    }
+#else
+    (void)main_changed;
+    (void)tail_changed;
+#endif
 
-    PWMGenPeriodSet(PWM_MAIN_BASE, PWM_MAIN_GEN, ui32Period);
-    PWMPulseWidthSet(PWM_MAIN_BASE, PWM_MAIN_OUTNUM, ui32Period * mainDuty / 100);
+    if (!masked) {
+        IntMasterEnable();
+    }
+}
+
+// Function to set the duty cycle of M0PWM7, in percent
+void
+SetMainPWM(uint8_t mainDuty)
+{
+    SetMotorDuty(MOTOR_MAIN, PERCENT_TO_PERMILLE(mainDuty));
 }
 
 void
 SetTailPWM(uint8_t tailDuty)
 {
-    g_setTailDuty = tailDuty;
+    SetMotorDuty(MOTOR_TAIL, PERCENT_TO_PERMILLE(tailDuty));
+}
+
+/*
+ * Adds the age of a sample, just after the PWM write it led to,
+ * to the motor's histogram
+ */
+void
+RecordLatency(Motor_t motor, uint32_t sampleCycles)
+{
+    uint32_t age_us = (GetCycleCount() - sampleCycles) / g_cyclesPerUs;
+    LatencyHist_t* hist = &g_latency[motor];
+    uint8_t bin = 0;
+
+    if (g_latencyReset) {
+        LatencyHist_t empty = {0};
+        g_latency[MOTOR_MAIN] = empty;
+        g_latency[MOTOR_TAIL] = empty;
+        g_latencyReset = false;
+    }
 
-    uint32_t ui32Period = SysCtlClockGet() / PWM_DIVIDER / PWM_START_RATE_HZ;
+    while (bin < LATENCY_BINS - 1 && (age_us >> (bin + 1))) {
+        bin++;
+    }
+    hist->Bins[bin]++;
+    hist->Count++;
+    if (age_us > hist->MaxUs) {
+        hist->MaxUs = age_us;
+    }
+}
+
+/*
+ * Sets both duties, in permille, worked out from samples taken at
+ * mainCycles and tailCycles (GetCycleCount), recording their latency.
+ * Only the controller should use this.
+ */
+void
+SetMotorDutiesSampled(uint16_t mainPermille, uint16_t tailPermille, uint32_t mainCycles,
+                      uint32_t tailCycles)
+{
+    SetMotorDuties(mainPermille, tailPermille);
+    RecordLatency(MOTOR_MAIN, mainCycles);
+    RecordLatency(MOTOR_TAIL, tailCycles);
+
+    if (g_latencyRequest) {
+        MailboxWrite(&g_latencyMailbox[MOTOR_MAIN], &g_latency[MOTOR_MAIN]);
+        MailboxWrite(&g_latencyMailbox[MOTOR_TAIL], &g_latency[MOTOR_TAIL]);
+        g_latencyRequest = false;
+    }
+}
 
-    PWMGenPeriodSet(PWM_TAIL_BASE, PWM_TAIL_GEN, ui32Period);
-    PWMPulseWidthSet(PWM_TAIL_BASE, PWM_TAIL_OUTNUM, ui32Period * tailDuty / 100);
+/*
+ * Has the controller publish both histograms after its next run
+ */
+void
+RequestLatencyHistograms(void)
+{
+    g_latencyRequest = true;
+}
+
+/*
+ * Copies a motor's latency histogram as published after the last
+ * RequestLatencyHistograms(). Returns false if none has been yet.
+ */
+bool
+GetLatencyHistogram(Motor_t motor, LatencyHist_t* hist)
+{
+    return MailboxRead(&g_latencyMailbox[motor], hist);
+}
+
+/*
+ * Clears both histograms, on the next recorded write
+ */
+void
+ResetLatencyHistograms(void)
+{
+    g_latencyReset = true;
+}
+
+/*
+ * Duty last set, in permille
+ */
+uint16_t
+GetMotorDuty(Motor_t motor)
+{
+    return g_dutyPermille[motor];
 }
 
+/*
+ * Duties last set, in whole percent
+ */
 uint8_t
 GetMainDuty(void)
 {
-    return g_setMainDuty;
+    return g_dutyPermille[MOTOR_MAIN] / (DUTY_PERMILLE / 100);
 }
 
 uint8_t
 GetTailDuty(void)
 {
-    return g_setTailDuty;
+    return g_dutyPermille[MOTOR_TAIL] / (DUTY_PERMILLE / 100);
 }
@@ -9,29 +9,65 @@
 **/
 
 #include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    MOTOR_MAIN = 0,
+    MOTOR_TAIL,
+    NUM_MOTORS
+} Motor_t;
+
+// Duties are in permille of the PWM period
+#define DUTY_PERMILLE 1000
+#define PERCENT_TO_PERMILLE(p) ((p) * (DUTY_PERMILLE / 100))
+
+#define LATENCY_BINS 16
 
 /*
- * Control struct
+ * Sensor to actuator latency: the age of the sample behind each
+ * controlled PWM write. Bin 0 counts ages under 2 us, bin n ages from
+ * 2^n to 2^(n+1) us, the last bin everything older.
  */
 typedef struct {
-    int32_t setpoint;
-    int32_t prev_setpoint;
-    int32_t read_value;
-    int32_t prev_read_value;
-    float Kp;
-    float Ki;
-    int32_t Kd;
-} PID_t;
+    uint32_t Bins[LATENCY_BINS];
+    uint32_t Count;
+    uint32_t MaxUs;
+} LatencyHist_t;
 
 void
 InitMotors(void);
 
+void
+EnableMainADCTrigger(void);
+
+void
+SetMotorDuty(Motor_t motor, uint16_t permille);
+
+void
+SetMotorDuties(uint16_t mainPermille, uint16_t tailPermille);
+
 void
 SetMainPWM(uint8_t mainDuty);
 
 void
 SetTailPWM(uint8_t tailDuty);
 
+void
+SetMotorDutiesSampled(uint16_t mainPermille, uint16_t tailPermille, uint32_t mainCycles,
+                      uint32_t tailCycles);
+
+void
+RequestLatencyHistograms(void);
+
+bool
+GetLatencyHistogram(Motor_t motor, LatencyHist_t* hist);
+
+void
+ResetLatencyHistograms(void);
+
+uint16_t
+GetMotorDuty(Motor_t motor);
+
 uint8_t
 GetMainDuty(void);
 
@@ -6,22 +6,33 @@
 **/
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <stdbool.h>
 
 #include "driverlib/adc.h"
+#include "driverlib/interrupt.h"
 #include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#include "driverlib/udma.h"
+#include "inc/hw_adc.h"
 #include "inc/hw_memmap.h"
 #include "buttons4.h"
 
 #include "motors.h"
+#include "pid.h"
+#include "kernel.h"
+#include "ring.h"
+#include "filter.h"
 #include "altitude.h"
 
 // Initialise variables
 #define BUF_SIZE 24
+#define ALT_SAMPLE_HZ 200
+#define SAMPLE_RING_SIZE 16
 #define HELI_ALT_SIGNAL ADC_CTL_CH9
-#define MIN_ALT_OUTPUT 2
-#define MAX_ALT_OUTPUT 70
-#define SCALE_FACTOR_HELI 1241
+// Controller output limits, duty in permille
+#define MIN_ALT_OUTPUT 20
+#define MAX_ALT_OUTPUT 700
 
 // Hovering globals
 static int8_t g_hoveringOffset;
@@ -32,8 +43,55 @@ static uint8_t g_hoverFlag = 1;
 static int32_t g_gndRef = 0;
 static uint8_t g_gndFlag = 1;
 
-// Buffer for signal averaging
-static circBuf_t g_inBuffer;
+// Smoothing of the samples, a BUF_SIZE boxcar until SetAltFilter
+static Filter_t g_altFilter;
+
+// Samples on their way from the ADC interrupt to the averaging buffer
+typedef struct {
+    uint32_t Value;
+    uint32_t Cycles;
+} AltSample_t;
+
+static AltSample_t g_sampleStore[SAMPLE_RING_SIZE];
+static Ring_t g_sampleRing;
+
+// Acquisition backend chosen by InitADC
+static const AltSource_t* g_altSource;
+
+// Block capture: timer 0 starts sequence 0 ALT_DMA_TRIGGER_HZ times a
+// second, each run converts ALT_DMA_STEPS samples, each averaged over
+// ALT_DMA_OVERSAMPLE conversions in hardware, and the uDMA fills one
+// half of g_dmaBlock while the other is averaged. 8 kHz in blocks of
+// 40 queues 200 samples a second, the same as the single-sample source.
+#define ALT_DMA_TRIGGER_HZ 1000
+#define ALT_DMA_STEPS 8
+#define ALT_DMA_OVERSAMPLE 4
+#define ALT_DMA_BLOCK 40
+
+static uint16_t g_dmaBlock[2][ALT_DMA_BLOCK];
+
+// uDMA channel control table, must be 1024 byte aligned
+#if defined(ewarm)
+#pragma data_alignment=1024
+static uint8_t g_dmaControlTable[1024];
+#elif defined(ccs)
+#pragma DATA_ALIGN(g_dmaControlTable, 1024)
+static uint8_t g_dmaControlTable[1024];
+#else
+static uint8_t g_dmaControlTable[1024] __attribute__ ((aligned(1024)));
+#endif
+
+// PWM synchronous capture: one sample per main rotor PWM period
+// (PWM_START_RATE_HZ), averaged over ALT_PWM_OVERSAMPLE conversions
+// (16 us) in hardware
+#define ALT_PWM_OVERSAMPLE 16
+
+// Cycle count of the newest averaged sample, and the hook called on
+// every g_blockSamples new samples
+static uint32_t g_sampleCycles;
+static void (*g_blockCallback)(void) = NULL;
+static uint8_t g_blockSamples;
+static uint8_t g_blockCount;
 
 // Control globals
 static int32_t g_altError;
@@ -42,9 +100,82 @@ static PID_t g_altitudeControl = {.setpoint = 0,
                                   .prev_setpoint = 0,
                                   .read_value = 0,
                                   .prev_read_value = 0,
-                                  .Kp = 3,
-                                  .Ki = 1,
-                                  .Kd = 0};
+                                  .Kp = 30,
+                                  .Ki = 4.4,
+                                  .Kd = 0,
+                                  .Kt = 0.15,
+                                  .OutMin = MIN_ALT_OUTPUT,
+                                  .OutMax = MAX_ALT_OUTPUT};
+
+/*
+ * Moves the samples queued by the ADC interrupt through the filter.
+ * Runs on every read of the filter, from either tier, so
+ * interrupts are masked to keep it the ring's only consumer. That is
+ * at most SAMPLE_RING_SIZE samples, and fewer as long as the display
+ * keeps reading: samples arriving with the ring full are dropped.
+ */
+static void
+DrainAltSamples(void)
+{
+    const void* span;
+    uint32_t count;
+    bool masked = IntMasterDisable();
+
+    while ((count = RingReadSpan(&g_sampleRing, &span)) > 0) {
+        const AltSample_t* samples = span;
+        uint32_t i;
+
+        for (i = 0; i < count; i++) {
+            FilterPush(&g_altFilter, samples[i].Value);
+        }
+        g_sampleCycles = samples[count - 1].Cycles;
+        RingConsume(&g_sampleRing, count);
+    }
+
+    if (!masked) {
+        IntMasterEnable();
+    }
+}
+
+/*
+ * Queues one sample for DrainAltSamples (counted and dropped
+ * if the ring is full) and calls the block callback when due.
+ * Interrupt context.
+ */
+static void
+AltQueueSample(uint32_t value, uint32_t cycles)
+{
+    AltSample_t sample = {.Value = value, .Cycles = cycles};
+
+    RingWrite(&g_sampleRing, &sample);
+
+    if (g_blockCallback && ++g_blockCount >= g_blockSamples) {
+        g_blockCount = 0;
+        g_blockCallback();
+    }
+}
+
+/*
+ * Averages a block of count raw samples into one sample stamped with
+ * cycles, the cycle count when the block completed. Called by the
+ * block capture interrupt; takes no hardware so it can be fed from a
+ * recorded or synthetic block too.
+ */
+void
+AltProcessBlock(const uint16_t* block, uint16_t count, uint32_t cycles)
+{
+    uint32_t sum = 0;
+    uint16_t i;
+
+    if (count == 0) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        sum += block[i];
+    }
+    AltQueueSample((sum + count / 2) / count, cycles);
+}
 
 /*
  * (Original code by P.J. Bones)
@@ -52,6 +183,17 @@ static PID_t g_altitudeControl = {.setpoint = 0,
  */
 void
 ADCProcessTrigger(void)
+{
+    if (g_altSource->Trigger) {
+        g_altSource->Trigger();
+    }
+}
+
+/*
+ * Starts one conversion on sequence 3
+ */
+static void
+AltSingleTrigger(void)
 {
     // Initiate a conversion
     ADCProcessorTrigger(ADC0_BASE, 3);
@@ -64,36 +206,30 @@ ADCProcessTrigger(void)
 void
 ADCIntHandler(void)
 {
-    uint32_t ulValue;
+    uint32_t value;
 
     // Get the single sample from ADC0.  ADC_BASE is defined in
     // inc/hw_memmap.h
-    ADCSequenceDataGet(ADC0_BASE, 3, &ulValue);
-
-    // Place it in the circular buffer (advancing write index)
-    writeCircBuf(&g_inBuffer, ulValue);
+    ADCSequenceDataGet(ADC0_BASE, 3, &value);
 
     // Clean up, clearing the interrupt
     ADCIntClear(ADC0_BASE, 3);
-}
 
+    AltQueueSample(value, GetCycleCount());
+}
 
 /*
  * (Original code by P.J. Bones)
- * Initialises the ADC peripheral to sample altitude
+ * Sets up sequence 3 for one conversion on each trigger
  */
-void
-InitADC(void)
+static void
+AltSequence3Init(uint32_t trigger)
 {
-    // The ADC0 peripheral must be enabled for configuration and use.
-    SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC0);
+    // Enable sample sequence 3 with the given trigger.  Sequence 3
+    // will do a single sample each time the trigger fires.
+    ADCSequenceConfigure(ADC0_BASE, 3, trigger, 0);
 
-    // Enable sample sequence 3 with a processor signal trigger.  Sequence 3
-    // will do a single sample when the processor sends a signal to start the
-    // conversion.
-    ADCSequenceConfigure(ADC0_BASE, 3, ADC_TRIGGER_PROCESSOR, 0);
-
-    // Since sample sequence 3 is now configured, it must be enabled
+    // Configure step 0 on sequence 3, interrupting when it completes
     ADCSequenceStepConfigure(ADC0_BASE, 3, 0, HELI_ALT_SIGNAL | ADC_CTL_IE | ADC_CTL_END);
 
     // Since sample sequence 3 is now configured, it must be enabled.
@@ -104,23 +240,206 @@ InitADC(void)
 
     // Enable interrupts for ADC0 sequence 3 (clears any outstanding interrupts)
     ADCIntEnable(ADC0_BASE, 3);
-    initCircBuf(&g_inBuffer, BUF_SIZE);
+}
+
+/*
+ * One conversion per ADCProcessTrigger()
+ */
+static void
+AltSingleInit(void)
+{
+    AltSequence3Init(ADC_TRIGGER_PROCESSOR);
+}
+
+/*
+ * One conversion per main rotor PWM period, started by the PWM
+ * generator when its counter reaches zero. Counting up/down that is
+ * the middle of the off time, as far from both switching edges as the
+ * period allows, and the same point every period with no software in
+ * the path. ADC_TRIGGER_PWM3 is generator 3 of PWM0, the main rotor.
+ */
+static void
+AltPwmInit(void)
+{
+    ADCHardwareOversampleConfigure(ADC0_BASE, ALT_PWM_OVERSAMPLE);
+    AltSequence3Init(ADC_TRIGGER_PWM3);
+    EnableMainADCTrigger();
+}
+
+/*
+ * Points one half of the ping-pong buffer back at the sequence 0 FIFO
+ */
+static void
+AltDmaArm(uint32_t select, uint16_t* block)
+{
+    uDMAChannelTransferSet(UDMA_CHANNEL_ADC0 | select, UDMA_MODE_PINGPONG,
+                           (void*)(ADC0_BASE + ADC_O_SSFIFO0), block, ALT_DMA_BLOCK);
+}
+
+/*
+ * Runs once per ALT_DMA_BLOCK samples, when the uDMA has filled one
+ * half of the ping-pong buffer and moved on to the other. Averages the
+ * full half and hands it back to the uDMA.
+ */
+void
+ADCBlockIntHandler(void)
+{
+    uint32_t cycles = GetCycleCount();
+
+    ADCIntClear(ADC0_BASE, 0);
+
+    if (uDMAChannelModeGet(UDMA_CHANNEL_ADC0 | UDMA_PRI_SELECT) == UDMA_MODE_STOP) {
+        AltProcessBlock(g_dmaBlock[0], ALT_DMA_BLOCK, cycles);
+        AltDmaArm(UDMA_PRI_SELECT, g_dmaBlock[0]);
+    }
+
+    if (uDMAChannelModeGet(UDMA_CHANNEL_ADC0 | UDMA_ALT_SELECT) == UDMA_MODE_STOP) {
+        AltProcessBlock(g_dmaBlock[1], ALT_DMA_BLOCK, cycles);
+        AltDmaArm(UDMA_ALT_SELECT, g_dmaBlock[1]);
+    }
+}
+
+/*
+ * Sets up timer triggered, hardware averaged conversions on sequence 0,
+ * moved by the uDMA into the ping-pong buffer
+ */
+static void
+AltDmaInit(void)
+{
+    uint32_t step;
+
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER0);
+
+    // Timer 0A starts sequence 0 ALT_DMA_TRIGGER_HZ times a second
+    TimerConfigure(TIMER0_BASE, TIMER_CFG_PERIODIC);
+    TimerLoadSet(TIMER0_BASE, TIMER_A, SysCtlClockGet() / ALT_DMA_TRIGGER_HZ - 1);
+    TimerControlTrigger(TIMER0_BASE, TIMER_A, true);
+
+    // Each step averages ALT_DMA_OVERSAMPLE conversions in hardware. The
+    // last step raises the uDMA request; the interrupt comes from the
+    // uDMA when a whole block is done.
+    ADCHardwareOversampleConfigure(ADC0_BASE, ALT_DMA_OVERSAMPLE);
+    ADCSequenceConfigure(ADC0_BASE, 0, ADC_TRIGGER_TIMER, 0);
+    for (step = 0; step < ALT_DMA_STEPS - 1; step++) {
+        ADCSequenceStepConfigure(ADC0_BASE, 0, step, HELI_ALT_SIGNAL);
+    }
+    ADCSequenceStepConfigure(ADC0_BASE, 0, step, HELI_ALT_SIGNAL | ADC_CTL_IE | ADC_CTL_END);
+
+    // Channel 14 is ADC0 sequence 0 by default
+    uDMAEnable();
+    uDMAControlBaseSet(g_dmaControlTable);
+    uDMAChannelAttributeDisable(UDMA_CHANNEL_ADC0, UDMA_ATTR_ALTSELECT | UDMA_ATTR_USEBURST |
+                                UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+    uDMAChannelControlSet(UDMA_CHANNEL_ADC0 | UDMA_PRI_SELECT,
+                          UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_1);
+    uDMAChannelControlSet(UDMA_CHANNEL_ADC0 | UDMA_ALT_SELECT,
+                          UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_1);
+    AltDmaArm(UDMA_PRI_SELECT, g_dmaBlock[0]);
+    AltDmaArm(UDMA_ALT_SELECT, g_dmaBlock[1]);
+    uDMAChannelEnable(UDMA_CHANNEL_ADC0);
+
+    ADCSequenceDMAEnable(ADC0_BASE, 0);
+    ADCSequenceEnable(ADC0_BASE, 0);
+    ADCIntRegister(ADC0_BASE, 0, ADCBlockIntHandler);
+    ADCIntEnable(ADC0_BASE, 0);
+
+    TimerEnable(TIMER0_BASE, TIMER_A);
+}
+
+const AltSource_t g_adcSingleSource = {.Init = AltSingleInit, .Trigger = AltSingleTrigger};
+const AltSource_t g_adcDmaSource = {.Init = AltDmaInit, .Trigger = NULL};
+const AltSource_t g_adcPwmSource = {.Init = AltPwmInit, .Trigger = NULL};
+
+/*
+ * Samples dropped because DrainAltSamples fell behind
+ */
+uint32_t
+GetAltSampleOverflows(void)
+{
+    return g_sampleRing.Overflows;
+}
+
+/*
+ * Calls callback from the ADC interrupt each time samples new
+ * samples are in, NULL to stop
+ */
+void
+SetAltBlockCallback(void (*callback)(void), uint8_t samples)
+{
+    g_blockCallback = NULL;
+    g_blockSamples = samples;
+    g_blockCount = 0;
+    g_blockCallback = callback;
+}
+
+/*
+ * Cycle count (GetCycleCount) of the newest sample in the last
+ * altitude reading, the one the controller acts on
+ */
+uint32_t
+GetAltSampleCycles(void)
+{
+    return g_altitudeControl.read_cycles;
+}
+
+
+/*
+ * (Original code by P.J. Bones)
+ * Initialises the ADC peripheral to sample altitude
+ * through source
+ */
+void
+InitADC(const AltSource_t* source)
+{
+    // The ADC0 peripheral must be enabled for configuration and use.
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC0);
+
+    FilterInit(&g_altFilter, FILTER_BOXCAR, BUF_SIZE, 0);
+    RingInit(&g_sampleRing, g_sampleStore, SAMPLE_RING_SIZE, sizeof(AltSample_t));
+
+    PidInit(&g_altitudeControl);
+
+    g_altSource = source;
+    source->Init();
+}
+
+/*
+ * Replaces the altitude filter, see FilterInit(). Samples
+ * already filtered are dropped.
+ */
+bool
+SetAltFilter(FilterType_t type, uint8_t param, uint8_t medianTaps)
+{
+    bool masked = IntMasterDisable();
+    bool ok = FilterInit(&g_altFilter, type, param, medianTaps);
+
+    if (!masked) {
+        IntMasterEnable();
+    }
+    return ok;
+}
+
+/*
+ * Group delay (us) and white noise power gain (Q16) of the altitude
+ * filter, at the ALT_SAMPLE_HZ every source delivers
+ */
+void
+GetAltFilterFigures(uint32_t* delayUs, uint32_t* noiseGain)
+{
+    *delayUs = FilterDelayUs(&g_altFilter, ALT_SAMPLE_HZ);
+    *noiseGain = FilterNoiseGain(&g_altFilter);
 }
 
 /*
  * (Original code by P.J. Bones)
- * Calculates the mean voltage by averaging
- * the contents of the circular buffer
+ * Returns the filtered voltage
  */
 int32_t
 GetAltMean(void)
 {
-    uint16_t i;
-    int32_t sum = 0;
-    for (i = 0; i < BUF_SIZE; i++) {
-        sum = sum + readCircBuf (&g_inBuffer);
-    }
-    return ((2 * sum + BUF_SIZE) / 2 / BUF_SIZE);
+    DrainAltSamples();
+    return FilterOutput(&g_altFilter);
 }
 
 /*
@@ -130,8 +449,10 @@ int32_t
 GetAltPercent(void)
 {
     int32_t mean = GetAltMean();
+    uint32_t sample_cycles = g_sampleCycles;
     int32_t alt_percent = 100 * (g_gndRef - mean) / SCALE_FACTOR_HELI; // scales into a percentage
     g_altitudeControl.read_value = alt_percent;
+    g_altitudeControl.read_cycles = sample_cycles;
     return alt_percent;
 }
 
@@ -149,33 +470,20 @@ SetAltitudeRef(void)
 
 /*
  * (Code inspiration from Ciaran Moore Lecture Notes)
- * PI controller for altitude
+ * PI controller for altitude, dtUs since its last run. Returns the
+ * main duty in permille
  */
 int32_t 
-AltController(void)
+AltController(uint32_t dtUs)
 {
-    static float iSumAltitude = 0;
-    float alt_delta_t = 0.01;
-
     if (g_altitudeControl.setpoint != g_altitudeControl.prev_setpoint) {
-        iSumAltitude = 0;
+        PidResetIntegral(&g_altitudeControl);
         g_altitudeControl.prev_setpoint = g_altitudeControl.setpoint;
     }
 
     g_altError = g_altitudeControl.setpoint - g_altitudeControl.read_value;
-
-    float pControl = g_altitudeControl.Kp * g_altError;
-    float iControl = g_altitudeControl.Ki * g_altError * alt_delta_t;
-
-    g_altControlEffort = pControl + iSumAltitude + iControl + g_hoveringOffset;
-
-    iSumAltitude += iControl;
-
-    if (g_altControlEffort > MAX_ALT_OUTPUT) {
-        g_altControlEffort = MAX_ALT_OUTPUT;
-    } else if (g_altControlEffort < MIN_ALT_OUTPUT) {
-        g_altControlEffort = MIN_ALT_OUTPUT;
-    }
+    g_altitudeControl.Offset = PERCENT_TO_PERMILLE(g_hoveringOffset);
+    g_altControlEffort = PidStep(&g_altitudeControl, g_altError, dtUs);
 
     return g_altControlEffort;
 }
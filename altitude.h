@@ -11,7 +11,31 @@
 // Module requirements
 #include <stdint.h>
 #include <stdbool.h>
-#include "circBufT.h"
+#include "filter.h"
+
+// ADC counts the signal falls by from the ground to full height
+#define SCALE_FACTOR_HELI 1241
+
+/*
+ * Where altitude samples come from. Init sets up the hardware, Trigger
+ * (NULL if the hardware paces itself) starts a conversion and runs
+ * from ADCTask. ADCTask is only needed for sources with a Trigger.
+ */
+typedef struct {
+    void (*Init)(void);
+    void (*Trigger)(void);
+} AltSource_t;
+
+// One sequence 3 conversion and interrupt per ADCProcessTrigger()
+extern const AltSource_t g_adcSingleSource;
+
+// Timer paced sequence 0 with hardware averaging, uDMA ping-pong into
+// blocks and one interrupt per block
+extern const AltSource_t g_adcDmaSource;
+
+// One conversion per main rotor PWM period at a fixed phase, started
+// by the PWM generator. Needs InitMotors() first.
+extern const AltSource_t g_adcPwmSource;
 
 void
 ADCProcessTrigger(void);
@@ -20,7 +44,28 @@ void
 ADCIntHandler(void);
 
 void
-InitADC(void);
+ADCBlockIntHandler(void);
+
+void
+AltProcessBlock(const uint16_t* block, uint16_t count, uint32_t cycles);
+
+void
+InitADC(const AltSource_t* source);
+
+uint32_t
+GetAltSampleOverflows(void);
+
+void
+SetAltBlockCallback(void (*callback)(void), uint8_t samples);
+
+uint32_t
+GetAltSampleCycles(void);
+
+bool
+SetAltFilter(FilterType_t type, uint8_t param, uint8_t medianTaps);
+
+void
+GetAltFilterFigures(uint32_t* delayUs, uint32_t* noiseGain);
 
 int32_t
 GetAltMean(void);
@@ -32,7 +77,7 @@ void
 SetAltitudeRef(void);
 
 int32_t
-AltController(void);
+AltController(uint32_t dtUs);
 
 void
 CheckAltitudeSetButton(void);
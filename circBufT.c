@@ -6,32 +6,39 @@
 **/
 
 #include <stdint.h>
-#include "stdlib.h"
+#include <string.h>
 #include "circBufT.h"
 
 // *******************************************************
-// initCircBuf: Initialise the circBuf instance. Reset both indices to
-// the start of the buffer.  Dynamically allocate and clear the the 
-// memory and return a pointer for the data.  Return NULL if 
-// allocation fails.
+// initCircBuf: Initialise the circBuf instance over data, static
+// storage of at least size entries owned by the caller. Reset both
+// indices to the start of the buffer, clear the memory and return a
+// pointer for the data.
 uint32_t *
-initCircBuf (circBuf_t *buffer, uint32_t size)
+initCircBuf (circBuf_t *buffer, uint32_t *data, uint32_t size)
 {
 	buffer->windex = 0;
 	buffer->rindex = 0;
 	buffer->size = size;
-	buffer->data = 
-        (uint32_t *) calloc (size, sizeof(uint32_t));
+	buffer->sum = 0;
+	buffer->sumSq = 0;
+	buffer->data = data;
+	memset (data, 0, size * sizeof(uint32_t));
 	return buffer->data;
 }
-   // Note use of calloc() to clear contents.
 
 // *******************************************************
 // writeCircBuf: insert entry at the current windex location,
-// advance windex, modulo (buffer size).
+// advance windex, modulo (buffer size). The running sums swap the
+// overwritten entry for the new one.
 void
 writeCircBuf (circBuf_t *buffer, uint32_t entry)
 {
+	uint32_t old = buffer->data[buffer->windex];
+
+	buffer->sum += entry - old;
+	buffer->sumSq += (uint64_t)entry * entry;
+	buffer->sumSq -= (uint64_t)old * old;
 	buffer->data[buffer->windex] = entry;
 	buffer->windex++;
 	if (buffer->windex >= buffer->size)
@@ -55,16 +62,29 @@ readCircBuf (circBuf_t *buffer)
 }
 
 // *******************************************************
-// freeCircBuf: Releases the memory allocated to the buffer data,
-// sets pointer to NULL and ohter fields to 0. The buffer can
-// re-initialised by another call to initCircBuf().
-void
-freeCircBuf (circBuf_t * buffer)
+// sumCircBuf: return the sum of all entries.
+uint32_t
+sumCircBuf (circBuf_t *buffer)
 {
-	buffer->windex = 0;
-	buffer->rindex = 0;
-	buffer->size = 0;
-	free (buffer->data);
-	buffer->data = NULL;
+	return buffer->sum;
 }
 
+// *******************************************************
+// meanCircBuf: return the mean of all entries, rounded to nearest.
+uint32_t
+meanCircBuf (circBuf_t *buffer)
+{
+	return (2 * buffer->sum + buffer->size) / 2 / buffer->size;
+}
+
+// *******************************************************
+// varianceCircBuf: return the (population) variance of all entries,
+// (n * sumSq - sum^2) / n^2.
+uint32_t
+varianceCircBuf (circBuf_t *buffer)
+{
+	uint64_t n = buffer->size;
+	uint64_t sum = buffer->sum;
+
+	return (n * buffer->sumSq - sum * sum) / (n * n);
+}
@@ -17,15 +17,17 @@ typedef struct {
 	uint32_t windex;	// index for writing, mod(size)
 	uint32_t rindex;	// index for reading, mod(size)
 	uint32_t *data;		// pointer to the data
+	uint32_t sum;		// running sum of the entries
+	uint64_t sumSq;		// running sum of their squares
 } circBuf_t;
 
 // *******************************************************
-// initCircBuf: Initialise the circBuf instance. Reset both indices to
-// the start of the buffer.  Dynamically allocate and clear the the 
-// memory and return a pointer for the data.  Return NULL if 
-// allocation fails.
+// initCircBuf: Initialise the circBuf instance over data, static
+// storage of at least size entries owned by the caller. Reset both
+// indices to the start of the buffer, clear the memory and return a
+// pointer for the data.
 uint32_t *
-initCircBuf (circBuf_t *buffer, uint32_t size);
+initCircBuf (circBuf_t *buffer, uint32_t *data, uint32_t size);
 
 // *******************************************************
 // writeCircBuf: insert entry at the current windex location,
@@ -41,10 +43,21 @@ uint32_t
 readCircBuf (circBuf_t *buffer);
 
 // *******************************************************
-// freeCircBuf: Releases the memory allocated to the buffer data,
-// sets pointer to NULL and other fields to 0. The buffer can
-// re initialised by another call to initCircBuf().
-void
-freeCircBuf (circBuf_t *buffer);
+// sumCircBuf: return the sum of all entries, kept up to date by
+// writeCircBuf() so it costs the same for any buffer size.
+uint32_t
+sumCircBuf (circBuf_t *buffer);
+
+// *******************************************************
+// meanCircBuf: return the mean of all entries, rounded to nearest.
+uint32_t
+meanCircBuf (circBuf_t *buffer);
+
+// *******************************************************
+// varianceCircBuf: return the (population) variance of all entries.
+// If the buffer is written from an ISR, mask it while calling this
+// for an exact result.
+uint32_t
+varianceCircBuf (circBuf_t *buffer);
 
 #endif /*CIRCBUFT_H_*/
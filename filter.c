@@ -0,0 +1,232 @@
+/**
+ * @filename: filter.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 21.05.2024
+ * @purpose: Function definitions for the sample filters
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "circBufT.h"
+#include "filter.h"
+
+// IIR state is kept in Q8 so small steps still move it
+#define IIR_FRACTION_BITS 8
+
+#define FILTER_MAX_SHIFT 8
+#define NOISE_GAIN_ONE 65536
+
+/*
+ * Sets up a filter, see FilterType_t for param. medianTaps of 3 or 5
+ * puts a median in front to reject single sample spikes. Returns false
+ * for an unsupported combination.
+ */
+bool
+FilterInit(Filter_t* filter, FilterType_t type, uint8_t param, uint8_t medianTaps)
+{
+    if (medianTaps > FILTER_MEDIAN_MAX || (medianTaps > 1 && (medianTaps & 1) == 0)) {
+        return false;
+    }
+    if ((type == FILTER_BOXCAR && (param == 0 || param > FILTER_BOXCAR_MAX)) ||
+        ((type == FILTER_IIR1 || type == FILTER_IIR2 || type == FILTER_CIC2) &&
+         (param == 0 || param > FILTER_MAX_SHIFT))) {
+        return false;
+    }
+
+    if (type == FILTER_BOXCAR) {
+        initCircBuf(&filter->Boxcar, filter->BoxcarData, param);
+    }
+
+    filter->Type = type;
+    filter->Param = param;
+    filter->MedianTaps = (medianTaps > 1) ? medianTaps : 0;
+    filter->MedianIndex = 0;
+    filter->MedianCount = 0;
+    filter->Stage[0] = 0;
+    filter->Stage[1] = 0;
+    filter->Integrator[0] = 0;
+    filter->Integrator[1] = 0;
+    filter->Comb[0] = 0;
+    filter->Comb[1] = 0;
+    filter->Phase = 0;
+    filter->Primed = false;
+    filter->Output = 0;
+    return true;
+}
+
+/*
+ * Median of the last MedianTaps samples, fewer until that many are in
+ */
+static int32_t
+FilterMedian(Filter_t* filter, int32_t sample)
+{
+    int32_t sorted[FILTER_MEDIAN_MAX];
+    uint8_t i;
+    uint8_t j;
+
+    filter->Median[filter->MedianIndex] = sample;
+    filter->MedianIndex = (filter->MedianIndex + 1) % filter->MedianTaps;
+    if (filter->MedianCount < filter->MedianTaps) {
+        filter->MedianCount++;
+    }
+
+    for (i = 0; i < filter->MedianCount; i++) {
+        int32_t value = filter->Median[i];
+
+        for (j = i; j > 0 && sorted[j - 1] > value; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = value;
+    }
+    return sorted[filter->MedianCount / 2];
+}
+
+/*
+ * One first order stage in Q8, alpha = 2^-shift
+ */
+static int32_t
+FilterIirStep(int32_t* stage, int32_t input, uint8_t shift)
+{
+    *stage += (input - *stage) >> shift;
+    return *stage;
+}
+
+/*
+ * Feeds one sample in. Returns true if that gave a new output, which is
+ * every sample except for the CIC between decimations.
+ */
+bool
+FilterPush(Filter_t* filter, int32_t sample)
+{
+    int32_t input;
+
+    if (filter->MedianTaps) {
+        sample = FilterMedian(filter, sample);
+    }
+
+    switch (filter->Type) {
+    case FILTER_BOXCAR:
+        writeCircBuf(&filter->Boxcar, (uint32_t)sample);
+        filter->Output = meanCircBuf(&filter->Boxcar);
+        return true;
+
+    case FILTER_IIR1:
+    case FILTER_IIR2:
+        input = sample << IIR_FRACTION_BITS;
+
+        // Start from the first sample rather than ramping up from 0
+        if (!filter->Primed) {
+            filter->Stage[0] = input;
+            filter->Stage[1] = input;
+            filter->Primed = true;
+        }
+
+        input = FilterIirStep(&filter->Stage[0], input, filter->Param);
+        if (filter->Type == FILTER_IIR2) {
+            input = FilterIirStep(&filter->Stage[1], input, filter->Param);
+        }
+        filter->Output = (input + (1 << (IIR_FRACTION_BITS - 1))) >> IIR_FRACTION_BITS;
+        return true;
+
+    case FILTER_CIC2: {
+        uint32_t comb;
+        uint32_t out;
+
+        // Integrators and combs wrap, the output is still exact while it
+        // fits in 32 bits: 2 * Param bits more than the samples
+        filter->Integrator[0] += (uint32_t)sample;
+        filter->Integrator[1] += filter->Integrator[0];
+        if (++filter->Phase < (1u << filter->Param)) {
+            return false;
+        }
+        filter->Phase = 0;
+
+        comb = filter->Integrator[1] - filter->Comb[0];
+        filter->Comb[0] = filter->Integrator[1];
+        out = comb - filter->Comb[1];
+        filter->Comb[1] = comb;
+        filter->Output = (int32_t)out >> (2 * filter->Param);
+        return true;
+    }
+
+    default:
+        filter->Output = sample;
+        return true;
+    }
+}
+
+/*
+ * The latest output, held between CIC decimations
+ */
+int32_t
+FilterOutput(const Filter_t* filter)
+{
+    return filter->Output;
+}
+
+/*
+ * Group delay in us at sampleHz, median included: how far a step or
+ * a slow ramp lags the input. The CIC output is also held for up to
+ * 2^Param - 1 samples between decimations.
+ */
+uint32_t
+FilterDelayUs(const Filter_t* filter, uint32_t sampleHz)
+{
+    // in half samples
+    uint32_t delay = 0;
+
+    switch (filter->Type) {
+    case FILTER_BOXCAR:
+        delay = filter->Param - 1;
+        break;
+    case FILTER_IIR1:
+        delay = 2 * ((1u << filter->Param) - 1);
+        break;
+    case FILTER_IIR2:
+        delay = 4 * ((1u << filter->Param) - 1);
+        break;
+    case FILTER_CIC2:
+        delay = 2 * ((1u << filter->Param) - 1);
+        break;
+    default:
+        break;
+    }
+
+    if (filter->MedianTaps) {
+        delay += filter->MedianTaps - 1;
+    }
+
+    return (uint32_t)((uint64_t)delay * 500000 / sampleHz);
+}
+
+/*
+ * White noise power out over in, Q16 (65536 passes it all). Covers the
+ * linear filter only: a median in front cuts spikes but correlates
+ * neighbouring samples, so it can raise the figure as well as lower it.
+ */
+uint32_t
+FilterNoiseGain(const Filter_t* filter)
+{
+    float alpha;
+    float ratio;
+
+    switch (filter->Type) {
+    case FILTER_BOXCAR:
+        return NOISE_GAIN_ONE / filter->Param;
+    case FILTER_IIR1:
+        // alpha / (2 - alpha)
+        return NOISE_GAIN_ONE / ((2u << filter->Param) - 1);
+    case FILTER_IIR2:
+        // alpha (1 + (1 - alpha)^2) / (2 - alpha)^3
+        alpha = 1.0f / (1u << filter->Param);
+        return NOISE_GAIN_ONE * alpha * (1.0f + (1.0f - alpha) * (1.0f - alpha)) /
+               ((2.0f - alpha) * (2.0f - alpha) * (2.0f - alpha));
+    case FILTER_CIC2:
+        // sum of the squared triangular weights over R^4, (2R^2 + 1) / 3R^3
+        ratio = (float)(1u << filter->Param);
+        return NOISE_GAIN_ONE * (2.0f * ratio * ratio + 1.0f) / (3.0f * ratio * ratio * ratio);
+    default:
+        return NOISE_GAIN_ONE;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+/**
+ * @filename: filter.h
+ * @authors: Mark Day, Noah Walle
+ * @date: 21.05.2024
+ * @purpose: Smoothing filters for sensor samples, with an optional
+ * median spike rejector in front. Each filter reports its delay and
+ * how much white noise it lets through, to compare them.
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "circBufT.h"
+
+#define FILTER_MEDIAN_MAX 5
+
+// Longest boxcar, its storage is part of Filter_t
+#define FILTER_BOXCAR_MAX 64
+
+/*
+ * Filter types. Param sets the length: the sample count for the boxcar,
+ * the shift k of alpha = 2^-k for the IIRs and the decimation 2^k for
+ * the CIC.
+ */
+typedef enum {
+    FILTER_NONE = 0,    // passes samples through
+    FILTER_BOXCAR,      // mean of the last Param samples
+    FILTER_IIR1,        // first order low pass, y += alpha * (x - y)
+    FILTER_IIR2,        // two first order stages in series, no overshoot
+    FILTER_CIC2         // second order CIC, one output per 2^Param samples
+} FilterType_t;
+
+typedef struct {
+    uint8_t Type;
+    uint8_t Param;
+
+    // median of this many samples first, 0 or 1 for none
+    uint8_t MedianTaps;
+    uint8_t MedianIndex;
+    uint8_t MedianCount;
+    int32_t Median[FILTER_MEDIAN_MAX];
+
+    // FILTER_BOXCAR
+    circBuf_t Boxcar;
+    uint32_t BoxcarData[FILTER_BOXCAR_MAX];
+
+    // FILTER_IIR1 and FILTER_IIR2 stages, Q8, set from the first sample
+    int32_t Stage[2];
+    bool Primed;
+
+    // FILTER_CIC2 integrators, combs and decimation count
+    uint32_t Integrator[2];
+    uint32_t Comb[2];
+    uint16_t Phase;
+
+    // latest output
+    int32_t Output;
+} Filter_t;
+
+bool
+FilterInit(Filter_t* filter, FilterType_t type, uint8_t param, uint8_t medianTaps);
+
+bool
+FilterPush(Filter_t* filter, int32_t sample);
+
+int32_t
+FilterOutput(const Filter_t* filter);
+
+uint32_t
+FilterDelayUs(const Filter_t* filter, uint32_t sampleHz);
+
+uint32_t
+FilterNoiseGain(const Filter_t* filter);
+
+#endif
@@ -10,22 +10,118 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include "inc/hw_types.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_nvic.h"
+#include "driverlib/cpu.h"
+#include "driverlib/interrupt.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/systick.h"
+#include "utils/ustdlib.h"
 
 #include "kernel.h"
 
-#define MAXTASKS 8
+#define STATS_LINE_SIZE 80
+
+// SysTick (and the foreground tier) at the lowest interrupt priority,
+// so the ADC and encoder interrupts preempt foreground tasks
+#define SYSTICK_PRIORITY 0xE0
+
+// Largest SysTick reload value (24 bit counter)
+#define SYSTICK_MAX_RELOAD 0x00FFFFFF
+
+// Timing wheel, one slot per tick modulo WHEEL_SIZE (power of two)
+#define WHEEL_SIZE 64
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+
+// Longest stretch of ticks simulated for the tick load figures
+#define TICK_LOAD_MAX_TICKS 60000
+
+// Cortex-M4 DWT cycle counter
+#define DEMCR           HWREG(0xE000EDFC)
+#define DEMCR_TRCENA    0x01000000
+#define DWT_CTRL        HWREG(0xE0001000)
+#define DWT_CTRL_CYCEN  0x00000001
+#define DWT_CYCCNT      HWREG(0xE0001004)
 
 static uint8_t g_numTasks;
-static Task_t* g_taskArray;
+static Task_t g_taskArray[MAXTASKS];
+static SchedPolicy_t g_policy = SCHED_PRIORITY;
+static uint32_t g_kernelRateHz;
 static volatile uint32_t g_count = 0;
 static volatile uint32_t g_lastCount = 0;
 
+// Dispatch state: tasks waiting on the wheel, due tasks as bits in
+// g_readyMask, bit n being the task at g_runOrder[n]
+static Task_t* g_wheel[WHEEL_SIZE];
+static Task_t* g_runOrder[MAXTASKS];
+static uint32_t g_readyMask = 0;
+
+// Enabled tasks by id (position in g_taskArray)
+static volatile uint32_t g_enabledMask = 0;
+
+// Foreground tier tasks by id
+static uint32_t g_foregroundMask = 0;
+
+// Event tasks by id, and those signalled but not yet released
+static uint32_t g_eventMask = 0;
+static volatile uint32_t g_signalMask = 0;
+
+// Cyclic executive: the non empty frames of the major frame in tick
+// order, NULL when releasing from the timing wheel
+static const CyclicFrame_t* g_cyclicFrames = NULL;
+static uint16_t g_cyclicNumFrames;
+static uint16_t g_cyclicMajorTicks;
+static uint16_t g_cyclicIndex;
+
+// Tick load from the phase assignment
+static uint32_t g_peakTickLoadUs = 0;
+static uint32_t g_avgTickLoadUs = 0;
+
+// Profiling globals
+static volatile uint32_t g_tickCycles = 0;
+static uint32_t g_cyclesPerTick;
+static uint32_t g_cyclesPerUs;
+static uint32_t g_missedTicks = 0;
+
+// Tickless idle globals
+static bool g_tickless = false;
+static uint32_t g_maxSleepTicks;
+
+// Ticks KernelIdle slept through, not missed by RunKernel
+static uint32_t g_sleptTicks = 0;
+
+/*
+ * Starts the free running cycle counter
+ */
 void
-SysTickIntHandler(void)
+InitCycleCounter(void)
 {
-    g_count++;
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCEN;
+}
+
+uint32_t
+GetCycleCount(void)
+{
+    return DWT_CYCCNT;
+}
+
+uint32_t
+GetTickCount(void)
+{
+    return g_count;
+}
+
+/*
+ * Number of kernel ticks that passed without RunKernel seeing them,
+ * i.e. a task ran for longer than a tick
+ */
+uint32_t
+GetMissedTicks(void)
+{
+    return g_missedTicks;
 }
 
 void
@@ -36,89 +132,1377 @@ InitClock(uint32_t KERNEL_RATE_HZ)
 
     // Set up the period for the SysTick timer.  The SysTick timer period is
     // set as a function of the system clock.
-    SysTickPeriodSet(SysCtlClockGet() / KERNEL_RATE_HZ);
+    g_cyclesPerTick = SysCtlClockGet() / KERNEL_RATE_HZ;
+    g_cyclesPerUs = SysCtlClockGet() / 1000000;
+    g_maxSleepTicks = (SYSTICK_MAX_RELOAD - g_cyclesPerTick) / g_cyclesPerTick;
+    SysTickPeriodSet(g_cyclesPerTick);
 
     // Register the interrupt handler
     SysTickIntRegister(SysTickIntHandler);
+    IntPrioritySet(FAULT_SYSTICK, SYSTICK_PRIORITY);
+
+    // Foreground event tasks run from PendSV, level with SysTick
+    IntRegister(FAULT_PENDSV, PendSVIntHandler);
+    IntPrioritySet(FAULT_PENDSV, SYSTICK_PRIORITY);
 
     // Enable interrupt and device
     SysTickIntEnable();
     SysTickEnable();
 }
 
-void 
+void
 InitKernel(uint32_t KERNEL_RATE_HZ)
 {
     g_numTasks = 0;
-    g_taskArray = calloc(MAXTASKS, sizeof(Task_t));
+    g_kernelRateHz = KERNEL_RATE_HZ;
 
+    InitCycleCounter();
     InitClock(KERNEL_RATE_HZ);
 }
 
-int 
+/*
+ * Index of the lowest set bit, mask must be non zero
+ * (de Bruijn multiply, constant time without a CLZ intrinsic)
+ */
+uint8_t
+LowestSetBit(uint32_t mask)
+{
+    static const uint8_t debruijn[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+    return debruijn[(uint32_t)((mask & -mask) * 0x077CB531U) >> 27];
+}
+
+/*
+ * Period of a task in ticks, tasks with 0 ticks run every tick
+ */
+uint32_t
+TaskPeriod(const Task_t* task)
+{
+    return (task->NumTicks == 0) ? 1 : task->NumTicks;
+}
+
+uint32_t
+TaskPeriodUs(const Task_t* task)
+{
+    return (uint64_t)TaskPeriod(task) * 1000000 / g_kernelRateHz;
+}
+
+/*
+ * Puts a task on the wheel slot of its NextRun tick
+ */
+void
+WheelInsert(Task_t* task)
+{
+    Task_t** slot = &g_wheel[task->NextRun & WHEEL_MASK];
+
+    task->Prev = NULL;
+    task->Next = *slot;
+    if (*slot) {
+        (*slot)->Prev = task;
+    }
+    *slot = task;
+    task->Queued = 1;
+}
+
+void
+WheelRemove(Task_t* task)
+{
+    if (task->Prev) {
+        task->Prev->Next = task->Next;
+    } else {
+        g_wheel[task->NextRun & WHEEL_MASK] = task->Next;
+    }
+    if (task->Next) {
+        task->Next->Prev = task->Prev;
+    }
+    task->Next = NULL;
+    task->Prev = NULL;
+    task->Queued = 0;
+}
+
+/*
+ * Schedules a task for its next release. The first release, and one
+ * after being disabled for longer than a period, goes to the next tick
+ * on the task's phase grid (ticks where tick % period == Phase), but
+ * never before one full period has passed since start up.
+ * Foreground tasks count from the interrupt's tick and stay off the
+ * wheel, callers mask interrupts around them. Event tasks wait for
+ * their signal instead.
+ */
+void
+TaskSchedule(Task_t* task)
+{
+    if (task->Activation == ACTIVATE_EVENT) {
+        return;
+    }
+
+    uint32_t now = (task->Tier == TIER_FOREGROUND) ? g_count : g_lastCount;
+    uint32_t period = TaskPeriod(task);
+    uint32_t next = task->Release + period;
+    if (task->LastRun == 0 || (int32_t)(next - now) <= 0) {
+        next = now + 1;
+        if (task->LastRun == 0 && next < period) {
+            next = period;
+        }
+        next += (task->Phase + period - next % period) % period;
+    }
+    task->Release = next;
+    task->NextRun = next;
+    if (task->Tier == TIER_BACKGROUND) {
+        WheelInsert(task);
+    }
+}
+
+/*
+ * Moves an enabled task that is waiting for its release onto its
+ * current phase grid
+ */
+void
+TaskRegrid(Task_t* task)
+{
+    if (task->Queued) {
+        WheelRemove(task);
+        TaskSchedule(task);
+    } else if (task->Tier == TIER_FOREGROUND && task->RunTask) {
+        bool masked = IntMasterDisable();
+        TaskSchedule(task);
+        if (!masked) {
+            IntMasterEnable();
+        }
+    }
+}
+
+/*
+ * Schedules the release after the one just handled, by the task's
+ * overrun policy. Releases stay on the phase grid. Catch up tasks whose
+ * next release has already passed wait on the next tick, one late run
+ * per tick; the others skip to the next grid tick, counting what they
+ * missed.
+ */
+void
+TaskReschedule(Task_t* task, uint32_t now)
+{
+    uint32_t period = TaskPeriod(task);
+    uint32_t release = task->Release + period;
+
+    if (task->Overrun != OVERRUN_CATCH_UP && (int32_t)(release - now) <= 0) {
+        uint32_t missed = (now - release) / period + 1;
+        task->Stats.Missed += missed;
+        release += missed * period;
+    }
+
+    task->Release = release;
+    task->NextRun = ((int32_t)(release - now) > 0) ? release : now + 1;
+    if (task->Tier == TIER_BACKGROUND) {
+        WheelInsert(task);
+    }
+}
+
+/*
+ * Orders tasks by hand assigned priority, or by period
+ * for rate monotonic and EDF (EDF uses it to break deadline ties)
+ */
+int
 TaskCompare(const void * t_task_A, const void * t_task_B)
 {
-    const Task_t* task_A = (const Task_t *)t_task_A;
-    const Task_t* task_B = (const Task_t *)t_task_B;
+    const Task_t* task_A = *(Task_t * const *)t_task_A;
+    const Task_t* task_B = *(Task_t * const *)t_task_B;
+
+    if (g_policy != SCHED_PRIORITY && task_A->NumTicks != task_B->NumTicks) {
+        return (int)TaskPeriod(task_A) - (int)TaskPeriod(task_B);
+    }
 
     return (int)task_A->Priority - (int)task_B->Priority;
 }
 
-void 
-AddTask(void* functionPtr, uint16_t numTicks, uint8_t priority, uint8_t runTask)
+/*
+ * Sorts the run order for the current policy and renumbers the
+ * ready mask to match. Only runs when the task set or policy changes.
+ */
+void
+SortRunOrder(void)
 {
-    Task_t task = {functionPtr, numTicks, priority, runTask, 0};
-    g_taskArray[g_numTasks] = task;
-    g_numTasks++;
+    uint32_t ready = 0;
+    uint8_t i;
+
+    qsort(g_runOrder, g_numTasks, sizeof(Task_t*), TaskCompare);
 
-    if (g_numTasks >= 2) {
-        qsort(g_taskArray, g_numTasks, sizeof(Task_t), TaskCompare);
+    for (i = 0; i < g_numTasks; i++) {
+        Task_t* task = g_runOrder[i];
+        if (g_readyMask & (1UL << task->Rank)) {
+            ready |= 1UL << i;
+        }
+    }
+    for (i = 0; i < g_numTasks; i++) {
+        g_runOrder[i]->Rank = i;
     }
+    g_readyMask = ready;
 }
 
-void 
-TaskEnable(void* functionPtr)
+/*
+ * Foreground tasks all run back to back in one tick interrupt in the
+ * worst case, so together they must fit in a tick, and each needs a
+ * budget. Their response time is that whole interrupt.
+ */
+bool
+ForegroundSchedulable(void)
 {
+    uint32_t tick_us = 1000000 / g_kernelRateHz;
+    uint32_t total = 0;
     uint8_t i;
-    for (i = 0; i < g_numTasks; i++)
-    {
-        if (functionPtr == g_taskArray[i].FunctionPtr)
-        {
-            g_taskArray[i].RunTask = 1;
+
+    for (i = 0; i < g_numTasks; i++) {
+        const Task_t* task = &g_taskArray[i];
+        if (task->Tier == TIER_FOREGROUND) {
+            if (task->WcetUs == 0) {
+                return false;
+            }
+            total += task->WcetUs;
+        }
+    }
+    if (total > tick_us) {
+        return false;
+    }
+
+    for (i = 0; i < g_numTasks; i++) {
+        Task_t* task = &g_taskArray[i];
+        if (task->Tier == TIER_FOREGROUND) {
+            task->ResponseUs = total;
         }
     }
+    return true;
 }
 
-void 
-TaskDisable(void* functionPtr)
+/*
+ * Most time the foreground tier can take from the background loop
+ * in any interval of us microseconds
+ */
+uint32_t
+ForegroundInterference(uint32_t us)
 {
+    uint32_t interference = 0;
     uint8_t i;
-    for (i = 0; i < g_numTasks; i++)
-    {
-        if (functionPtr == g_taskArray[i].FunctionPtr)
-        {
-            g_taskArray[i].RunTask = 0;
+
+    for (i = 0; i < g_numTasks; i++) {
+        const Task_t* task = &g_taskArray[i];
+        if (task->Tier == TIER_FOREGROUND) {
+            interference += (us / TaskPeriodUs(task) + 1) * task->WcetUs;
         }
     }
+    return interference;
 }
 
-void 
-RunKernel(void)
+/*
+ * EDF admission: the non-preemptive utilisation test
+ * U + Cmax / Tmin <= 1, with U including the foreground tier and
+ * Cmax, Tmin over the background tasks only.
+ * A task's response is bounded by its period.
+ */
+bool
+EDFSchedulable(void)
+{
+    uint32_t utilisation = 0;   // parts per million
+    uint32_t max_wcet = 0;
+    uint32_t min_period = UINT32_MAX;
+    uint8_t i;
+
+    for (i = 0; i < g_numTasks; i++) {
+        Task_t* task = g_runOrder[i];
+        uint32_t period = TaskPeriodUs(task);
+        if (task->WcetUs == 0) {
+            continue;
+        }
+        utilisation += (uint64_t)task->WcetUs * 1000000 / period;
+        if (task->Tier == TIER_FOREGROUND) {
+            continue;
+        }
+        if (task->WcetUs > max_wcet) {
+            max_wcet = task->WcetUs;
+        }
+        if (period < min_period) {
+            min_period = period;
+        }
+    }
+
+    if (min_period == UINT32_MAX) {
+        return true;
+    }
+    if (utilisation + (uint64_t)max_wcet * 1000000 / min_period > 1000000) {
+        return false;
+    }
+
+    for (i = 0; i < g_numTasks; i++) {
+        Task_t* task = g_runOrder[i];
+        if (task->Tier == TIER_BACKGROUND) {
+            task->ResponseUs = task->WcetUs ? TaskPeriodUs(task) : 0;
+        }
+    }
+    return true;
+}
+
+/*
+ * Fixed priority admission (hand assigned or rate monotonic), response
+ * time analysis for the non-preemptive background loop. For task i in
+ * run order:
+ *   w = B + sum over higher priority j of (floor(w / Tj) + 1) * Cj
+ *         + sum over foreground f of (floor((w + Ci) / Tf) + 1) * Cf
+ *   R = tick + w + Ci
+ * where B is the longest lower priority task (it may have just started)
+ * and one tick is lost waiting for the tick that releases the task.
+ * Foreground tasks preempt, so they also count while task i runs.
+ * Event tasks count as periodic at their shortest signal spacing.
+ */
+bool
+FixedPrioritySchedulable(void)
+{
+    uint32_t tick_us = 1000000 / g_kernelRateHz;
+    uint8_t i, j;
+
+    for (i = 0; i < g_numTasks; i++) {
+        Task_t* task = g_runOrder[i];
+        uint32_t period = TaskPeriodUs(task);
+        uint32_t blocking = 0;
+        uint32_t w, w_next;
+
+        if (task->Tier == TIER_FOREGROUND) {
+            continue;
+        }
+        task->ResponseUs = 0;
+        if (task->WcetUs == 0) {
+            continue;
+        }
+
+        for (j = i + 1; j < g_numTasks; j++) {
+            if (g_runOrder[j]->Tier == TIER_BACKGROUND && g_runOrder[j]->WcetUs > blocking) {
+                blocking = g_runOrder[j]->WcetUs;
+            }
+        }
+
+        w_next = blocking;
+        do {
+            w = w_next;
+            w_next = blocking + ForegroundInterference(w + task->WcetUs);
+            for (j = 0; j < i; j++) {
+                if (g_runOrder[j]->Tier == TIER_BACKGROUND) {
+                    w_next += (w / TaskPeriodUs(g_runOrder[j]) + 1) * g_runOrder[j]->WcetUs;
+                }
+            }
+            if (tick_us + w_next + task->WcetUs > period) {
+                return false;
+            }
+        } while (w_next != w);
+
+        task->ResponseUs = tick_us + w + task->WcetUs;
+    }
+    return true;
+}
+
+bool
+Schedulable(void)
+{
+    if (!ForegroundSchedulable()) {
+        return false;
+    }
+    if (g_policy == SCHED_EDF) {
+        return EDFSchedulable();
+    }
+    return FixedPrioritySchedulable();
+}
+
+/*
+ * Sets the scheduling policy and re-checks the current task set.
+ * Returns false and keeps the old policy if the set fails under the new one.
+ */
+bool
+SetSchedPolicy(SchedPolicy_t policy)
+{
+    SchedPolicy_t old_policy = g_policy;
+
+    g_policy = policy;
+    SortRunOrder();
+
+    if (!Schedulable()) {
+        g_policy = old_policy;
+        SortRunOrder();
+        Schedulable();
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Drops every task added from position first on, after a failed admission
+ */
+void
+RemoveTasksFrom(uint8_t first)
+{
+    uint8_t i;
+
+    g_numTasks = first;
+    for (i = 0; i < g_numTasks; i++) {
+        g_runOrder[i] = &g_taskArray[i];
+    }
+    SortRunOrder();
+    Schedulable();
+}
+
+/*
+ * Adds a table of tasks, sorting and checking the set once.
+ * A budget of 0 marks a best effort task that is left out of the analysis
+ * (background only, foreground tasks need a budget).
+ * Returns false, without adding any of them, if the task set would miss
+ * a period. Task n of the table is GetTask(n) when added to an empty kernel.
+ */
+bool
+AddTaskTable(const TaskConfig_t* table, uint8_t numTasks)
+{
+    uint8_t first = g_numTasks;
+    uint8_t i;
+
+    if (first + numTasks > MAXTASKS) {
+        return false;
+    }
+
+    for (i = 0; i < numTasks; i++) {
+        Task_t* task = &g_taskArray[first + i];
+        Task_t empty = {0};
+        *task = empty;
+        task->Function = table[i].Function;
+        task->NumTicks = table[i].NumTicks;
+        task->Priority = table[i].Priority;
+        task->WcetUs = table[i].WcetUs;
+        task->Overrun = table[i].Overrun;
+        task->Tier = table[i].Tier;
+        task->Activation = table[i].Activation;
+        task->Rank = first + i;
+        task->Stats.MinCycles = UINT32_MAX;
+        task->Stats.MinLatency = UINT32_MAX;
+        g_runOrder[first + i] = task;
+    }
+    g_numTasks += numTasks;
+    SortRunOrder();
+
+    if (!Schedulable()) {
+        RemoveTasksFrom(first);
+        return false;
+    }
+
+    for (i = 0; i < numTasks; i++) {
+        if (table[i].Tier == TIER_FOREGROUND) {
+            g_foregroundMask |= 1UL << (first + i);
+        }
+        if (table[i].Activation == ACTIVATE_EVENT) {
+            g_eventMask |= 1UL << (first + i);
+        }
+        if (table[i].RunTask) {
+            TaskEnable(&g_taskArray[first + i]);
+        }
+    }
+    return true;
+}
+
+/*
+ * Adds a single task, see AddTaskTable.
+ * Returns a handle for TaskEnable/TaskDisable, or NULL if refused.
+ */
+TaskHandle_t
+AddTask(TaskFunction_t function, uint16_t numTicks, uint8_t priority, uint8_t runTask, uint32_t wcetUs,
+        OverrunPolicy_t overrun, TaskTier_t tier, Activation_t activation)
+{
+    TaskConfig_t config = {function, numTicks, priority, runTask, wcetUs, overrun, tier, activation};
+
+    if (!AddTaskTable(&config, 1)) {
+        return NULL;
+    }
+    return &g_taskArray[g_numTasks - 1];
+}
+
+TaskHandle_t
+GetTask(uint8_t id)
+{
+    return (id < g_numTasks) ? &g_taskArray[id] : NULL;
+}
+
+uint8_t
+TaskId(const Task_t* task)
+{
+    return task - g_taskArray;
+}
+
+/*
+ * Releases background tasks from a generated cyclic executive schedule
+ * instead of the timing wheel. frames lists the ticks of the major frame
+ * that release tasks, in order, each with a mask of task ids. Every
+ * background period must divide the major frame. The foreground tier
+ * and event tasks keep their own releases. NULL goes back to the wheel.
+ * Returns false if the schedule doesn't fit the task set.
+ */
+bool
+UseCyclicSchedule(const CyclicFrame_t* frames, uint16_t numFrames, uint16_t majorTicks)
+{
+    uint8_t i;
+
+    if (frames) {
+        if (majorTicks == 0 || numFrames == 0) {
+            return false;
+        }
+        for (i = 0; i < g_numTasks; i++) {
+            const Task_t* task = &g_taskArray[i];
+            if (task->Tier == TIER_BACKGROUND && task->Activation == ACTIVATE_PERIODIC &&
+                majorTicks % TaskPeriod(task) != 0) {
+                return false;
+            }
+        }
+    }
+
+    for (i = 0; i < g_numTasks; i++) {
+        Task_t* task = &g_taskArray[i];
+        if (task->Queued) {
+            WheelRemove(task);
+        }
+    }
+
+    g_cyclicFrames = frames;
+    g_cyclicNumFrames = numFrames;
+    g_cyclicMajorTicks = majorTicks;
+
+    if (frames) {
+        // First frame at or after the next tick to process
+        uint16_t offset = (g_lastCount + 1) % majorTicks;
+        g_cyclicIndex = 0;
+        while (g_cyclicIndex < numFrames && frames[g_cyclicIndex].Tick < offset) {
+            g_cyclicIndex++;
+        }
+        if (g_cyclicIndex == numFrames) {
+            g_cyclicIndex = 0;
+        }
+    } else {
+        for (i = 0; i < g_numTasks; i++) {
+            Task_t* task = &g_taskArray[i];
+            if (task->Tier == TIER_BACKGROUND && task->RunTask &&
+                !(g_readyMask & (1UL << task->Rank))) {
+                TaskSchedule(task);
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Load a task puts on the tick it runs in, best effort tasks are
+ * assumed to fill the tick
+ */
+uint32_t
+TaskLoadUs(const Task_t* task)
 {
-    if (g_count != g_lastCount){
-        uint8_t i;
+    return task->WcetUs ? task->WcetUs : 1000000 / g_kernelRateHz;
+}
+
+uint32_t
+Gcd(uint32_t a, uint32_t b)
+{
+    while (b) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/*
+ * Works out the peak and mean load of a tick over one hyperperiod
+ * (capped at TICK_LOAD_MAX_TICKS). Event tasks aren't tied to a tick
+ * and are left out.
+ */
+void
+UpdateTickLoad(void)
+{
+    uint32_t hyperperiod = 1;
+    uint32_t total = 0;
+    uint32_t tick;
+    uint8_t i;
+
+    g_peakTickLoadUs = 0;
+    for (i = 0; i < g_numTasks; i++) {
+        const Task_t* task = &g_taskArray[i];
+        uint32_t period = TaskPeriod(task);
+        if (task->Activation == ACTIVATE_EVENT) {
+            continue;
+        }
+        hyperperiod = hyperperiod / Gcd(hyperperiod, period) * period;
+        if (hyperperiod > TICK_LOAD_MAX_TICKS) {
+            hyperperiod = TICK_LOAD_MAX_TICKS;
+        }
+    }
+
+    for (tick = 0; tick < hyperperiod; tick++) {
+        uint32_t load = 0;
         for (i = 0; i < g_numTasks; i++) {
+            const Task_t* task = &g_taskArray[i];
+            if (task->Activation == ACTIVATE_PERIODIC && tick % TaskPeriod(task) == task->Phase) {
+                load += TaskLoadUs(task);
+            }
+        }
+        total += load;
+        if (load > g_peakTickLoadUs) {
+            g_peakTickLoadUs = load;
+        }
+    }
+    g_avgTickLoadUs = total / hyperperiod;
+}
+
+/*
+ * Spreads the tasks' phases so as few as possible share a tick.
+ * Tasks are placed shortest period first (priority breaking ties), each
+ * at the phase with the least load from already placed tasks it can
+ * ever coincide with: tasks i and j meet iff their phases are equal
+ * modulo gcd(Ti, Tj). Event tasks have no phase.
+ * tools/gen_schedule.py repeats this exactly.
+ */
+void
+AssignPhases(void)
+{
+    Task_t* order[MAXTASKS];
+    uint8_t num_periodic = 0;
+    uint8_t i, j;
+
+    for (i = 0; i < g_numTasks; i++) {
+        Task_t* task = &g_taskArray[i];
+        if (task->Activation == ACTIVATE_EVENT) {
+            continue;
+        }
+        for (j = num_periodic; j > 0 && (TaskPeriod(order[j - 1]) > TaskPeriod(task) ||
+                                         (TaskPeriod(order[j - 1]) == TaskPeriod(task) &&
+                                          order[j - 1]->Priority > task->Priority)); j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = task;
+        num_periodic++;
+    }
+
+    for (i = 0; i < num_periodic; i++) {
+        Task_t* task = order[i];
+        uint32_t period = TaskPeriod(task);
+        uint32_t best_cost = UINT32_MAX;
+        uint32_t best_phase = 0;
+        uint32_t phase;
+
+        for (phase = 0; phase < period && best_cost > 0; phase++) {
+            uint32_t cost = 0;
+            for (j = 0; j < i; j++) {
+                uint32_t common = Gcd(period, TaskPeriod(order[j]));
+                if (phase % common == order[j]->Phase % common) {
+                    cost += TaskLoadUs(order[j]);
+                }
+            }
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_phase = phase;
+            }
+        }
+        task->Phase = best_phase;
+    }
+
+    // Move waiting tasks onto their new grid
+    for (i = 0; i < g_numTasks; i++) {
+        TaskRegrid(&g_taskArray[i]);
+    }
+    UpdateTickLoad();
+}
+
+/*
+ * Sets a task's phase by hand, in ticks less than its period
+ */
+void
+SetTaskPhase(TaskHandle_t task, uint16_t phase)
+{
+    task->Phase = phase % TaskPeriod(task);
+    TaskRegrid(task);
+    UpdateTickLoad();
+}
+
+/*
+ * Peak and mean kernel tick load in microseconds
+ */
+void
+GetTickLoad(uint32_t* peakUs, uint32_t* avgUs)
+{
+    *peakUs = g_peakTickLoadUs;
+    *avgUs = g_avgTickLoadUs;
+}
+
+/*
+ * Worst case response time in microseconds found by the admission
+ * test, 0 for best effort tasks
+ */
+uint32_t
+GetTaskResponseTime(TaskHandle_t task)
+{
+    return task->ResponseUs;
+}
+
+/*
+ * For a task to call on itself: the time between the release of this
+ * run and the last one, its real period for a controller's dt. Timed on
+ * the tick grid for periodic tasks and from the signal for event tasks,
+ * so start jitter doesn't show. The first run after TaskEnable gets the
+ * nominal period.
+ */
+uint32_t
+GetTaskElapsedUs(TaskHandle_t task)
+{
+    return task->ElapsedUs;
+}
+
+/*
+ * Switches a task on or off. The background loop may switch any task,
+ * foreground tasks only other foreground tasks.
+ */
+void
+TaskEnable(TaskHandle_t task)
+{
+    bool masked = IntMasterDisable();
+
+    if (!task->RunTask) {
+        if (g_cyclicFrames == NULL || task->Tier == TIER_FOREGROUND) {
+            TaskSchedule(task);
+        }
+        task->RunTask = 1;
+        task->Resumed = 1;
+        g_enabledMask |= 1UL << TaskId(task);
+    }
+
+    if (!masked) {
+        IntMasterEnable();
+    }
+}
+
+void
+TaskDisable(TaskHandle_t task)
+{
+    bool masked = IntMasterDisable();
+
+    task->RunTask = 0;
+    g_enabledMask &= ~(1UL << TaskId(task));
+    g_signalMask &= ~(1UL << TaskId(task));
+    if (task->Queued) {
+        WheelRemove(task);
+    }
+    g_readyMask &= ~(1UL << task->Rank);
+
+    if (!masked) {
+        IntMasterEnable();
+    }
+}
+
+/*
+ * Folds one run of a task into its profile
+ */
+void
+UpdateTaskStats(TaskStats_t* stats, uint32_t latency, uint32_t cycles)
+{
+    stats->Runs++;
+    stats->TotalCycles += cycles;
+    stats->TotalLatency += latency;
+
+    if (cycles < stats->MinCycles) {
+        stats->MinCycles = cycles;
+    }
+    if (cycles > stats->MaxCycles) {
+        stats->MaxCycles = cycles;
+    }
+    if (latency < stats->MinLatency) {
+        stats->MinLatency = latency;
+    }
+    if (latency > stats->MaxLatency) {
+        stats->MaxLatency = latency;
+    }
+    if (cycles > g_cyclesPerTick) {
+        stats->Overruns++;
+    }
+}
+
+/*
+ * Cyclic executive release: when the tick reaches the next frame the
+ * enabled tasks in its mask become ready
+ */
+void
+ReleaseFrame(uint32_t tick)
+{
+    const CyclicFrame_t* frame = &g_cyclicFrames[g_cyclicIndex];
+    if (frame->Tick != tick % g_cyclicMajorTicks) {
+        return;
+    }
+
+    g_cyclicIndex++;
+    if (g_cyclicIndex == g_cyclicNumFrames) {
+        g_cyclicIndex = 0;
+    }
+
+    uint32_t mask = frame->Mask & g_enabledMask & ~(g_foregroundMask | g_eventMask);
+    while (mask) {
+        Task_t* task = &g_taskArray[LowestSetBit(mask)];
+        // As on the wheel, nothing runs before a full period from start up
+        if (g_readyMask & (1UL << task->Rank)) {
+            // Still waiting from its last release
+            task->Stats.Missed++;
+        } else if (task->LastRun != 0 || tick >= TaskPeriod(task)) {
+            task->Release = tick;
+            g_readyMask |= 1UL << task->Rank;
+        }
+        mask &= mask - 1;
+    }
+}
+
+/*
+ * Moves the tasks released on one tick from its wheel slot to the
+ * ready mask. Tasks further than a wheel turn away stay in the slot.
+ */
+void
+ReleaseTick(uint32_t tick)
+{
+    if (g_cyclicFrames) {
+        ReleaseFrame(tick);
+        return;
+    }
+
+    Task_t* task = g_wheel[tick & WHEEL_MASK];
+
+    while (task) {
+        Task_t* next = task->Next;
+        if (task->NextRun == tick) {
+            WheelRemove(task);
+            g_readyMask |= 1UL << task->Rank;
+        }
+        task = next;
+    }
+}
+
+/*
+ * Next ready task to run: lowest rank, or for EDF the earliest
+ * absolute deadline (release + period) with rank breaking ties
+ */
+Task_t*
+NextReadyTask(void)
+{
+    if (g_policy != SCHED_EDF) {
+        return g_runOrder[LowestSetBit(g_readyMask)];
+    }
+
+    uint32_t mask = g_readyMask;
+    Task_t* best = g_runOrder[LowestSetBit(mask)];
+    uint32_t best_deadline = best->Release + TaskPeriod(best);
+
+    mask &= mask - 1;
+    while (mask) {
+        Task_t* task = g_runOrder[LowestSetBit(mask)];
+        uint32_t deadline = task->Release + TaskPeriod(task);
+        if ((int32_t)(deadline - best_deadline) < 0) {
+            best = task;
+            best_deadline = deadline;
+        }
+        mask &= mask - 1;
+    }
+    return best;
+}
+
+/*
+ * Runs a released task and profiles it, latency counted from its
+ * release (the signal for event tasks). A periodic drop task whose
+ * next release has already passed skips the run instead.
+ */
+void
+ExecuteTask(Task_t* task, uint32_t now, uint32_t tick_cycles)
+{
+    if (task->Activation == ACTIVATE_PERIODIC && task->Overrun == OVERRUN_DROP &&
+        now - task->Release >= TaskPeriod(task)) {
+        task->Stats.Dropped++;
+        return;
+    }
+
+    task->LastRun = now;
+
+    uint32_t release = (task->Activation == ACTIVATE_EVENT) ? task->ReleaseCycles : task->Release;
+    if (task->Resumed) {
+        task->ElapsedUs = TaskPeriodUs(task);
+        task->Resumed = 0;
+    } else if (task->Activation == ACTIVATE_EVENT) {
+        task->ElapsedUs = (release - task->PrevRelease) / g_cyclesPerUs;
+    } else {
+        task->ElapsedUs = (uint64_t)(release - task->PrevRelease) * 1000000 / g_kernelRateHz;
+    }
+    task->PrevRelease = release;
+
+    uint32_t start = DWT_CYCCNT;
+    uint32_t latency = (task->Activation == ACTIVATE_EVENT)
+                       ? start - task->ReleaseCycles
+                       : (now - task->Release) * g_cyclesPerTick + (start - tick_cycles);
+
+    //run task
+    task->Function();
+
+    UpdateTaskStats(&task->Stats, latency, DWT_CYCCNT - start);
+}
+
+void
+DispatchTask(Task_t* task, uint32_t now, uint32_t tick_cycles)
+{
+    g_readyMask &= ~(1UL << task->Rank);
+
+    ExecuteTask(task, now, tick_cycles);
+
+    // The task may have disabled itself (or been re-enabled) while running
+    if (task->Activation == ACTIVATE_PERIODIC && task->RunTask && !task->Queued &&
+        g_cyclicFrames == NULL) {
+        TaskReschedule(task, now);
+    }
+}
+
+/*
+ * Runs the enabled periodic foreground tasks released on this tick,
+ * in task id order, from the tick interrupt
+ */
+void
+RunForeground(uint32_t now, uint32_t tick_cycles)
+{
+    uint32_t mask = g_foregroundMask & g_enabledMask & ~g_eventMask;
+
+    while (mask) {
+        Task_t* task = &g_taskArray[LowestSetBit(mask)];
+        if ((int32_t)(now - task->NextRun) >= 0) {
+            ExecuteTask(task, now, tick_cycles);
+            if (task->RunTask) {
+                TaskReschedule(task, now);
+            }
+        }
+        mask &= mask - 1;
+    }
+}
+
+void
+SysTickIntHandler(void)
+{
+    g_count++;
+    g_tickCycles = DWT_CYCCNT;
+
+    if (g_foregroundMask & g_enabledMask & ~g_eventMask) {
+        RunForeground(g_count, g_tickCycles);
+    }
+}
+
+/*
+ * Releases an enabled event task. Safe from any interrupt: a
+ * foreground task runs as soon as the interrupts above the kernel
+ * return, a background one on the next pass of RunKernel. A signal
+ * while the last is still waiting counts as missed.
+ */
+void
+TaskSignal(TaskHandle_t task)
+{
+    uint32_t bit = 1UL << TaskId(task);
+    bool masked = IntMasterDisable();
+
+    if (task->RunTask) {
+        if (g_signalMask & bit) {
+            task->Stats.Missed++;
+        } else {
+            task->Release = g_count;
+            task->ReleaseCycles = DWT_CYCCNT;
+            g_signalMask |= bit;
+            if (task->Tier == TIER_FOREGROUND) {
+                IntPendSet(FAULT_PENDSV);
+            }
+        }
+    }
+
+    if (!masked) {
+        IntMasterEnable();
+    }
+}
+
+/*
+ * Takes the pending signals in mask, clearing them
+ */
+uint32_t
+TakeSignals(uint32_t mask)
+{
+    bool masked = IntMasterDisable();
+    uint32_t signals = g_signalMask & mask;
+    g_signalMask &= ~signals;
+    if (!masked) {
+        IntMasterEnable();
+    }
+    return signals;
+}
+
+/*
+ * Runs the signalled foreground event tasks, in task id order
+ */
+void
+PendSVIntHandler(void)
+{
+    uint32_t mask = TakeSignals(g_foregroundMask);
+
+    while (mask) {
+        Task_t* task = &g_taskArray[LowestSetBit(mask)];
+        if (task->RunTask) {
+            ExecuteTask(task, g_count, g_tickCycles);
+        }
+        mask &= mask - 1;
+    }
+}
+
+/*
+ * Moves the signalled background event tasks to the ready mask
+ */
+void
+ReleaseSignals(void)
+{
+    uint32_t mask = TakeSignals(~g_foregroundMask);
 
-            Task_t task = g_taskArray[i];
-            uint32_t delta_ticks = g_count - task.LastRun;
-            if (task.RunTask && (task.NumTicks == 0 || delta_ticks >= task.NumTicks)){ //runs if enabled and 0 or its due to
+    while (mask) {
+        Task_t* task = &g_taskArray[LowestSetBit(mask)];
+        if (task->RunTask) {
+            g_readyMask |= 1UL << task->Rank;
+        }
+        mask &= mask - 1;
+    }
+}
+
+/*
+ * Enables sleeping between due tasks instead of polling every tick
+ */
+void
+SetTicklessIdle(bool enable)
+{
+    g_tickless = enable;
+}
+
+/*
+ * Ticks until the earliest enabled task is due, 0 if one is ready now.
+ * Sleep also ends on a foreground release so its tick interrupt fires.
+ * Event tasks wake the CPU with the interrupt that signals them.
+ */
+uint32_t
+TicksToNextTask(void)
+{
+    uint32_t next = g_maxSleepTicks;
+    uint32_t mask = g_foregroundMask & g_enabledMask & ~g_eventMask;
+    uint8_t i;
 
-                task.LastRun = g_count;
-                g_taskArray[i] = task;
-                //run task
-                ((void(*)(Task_t*))(task.FunctionPtr))(&task);
+    if (g_readyMask || (g_signalMask & ~g_foregroundMask)) {
+        return 0;
+    }
+
+    while (mask) {
+        const Task_t* task = &g_taskArray[LowestSetBit(mask)];
+        int32_t ticks = (int32_t)(task->NextRun - g_count);
+        if (ticks < 1) {
+            ticks = 1;
+        }
+        if ((uint32_t)ticks < next) {
+            next = ticks;
+        }
+        mask &= mask - 1;
+    }
+
+    if (g_cyclicFrames) {
+        uint16_t offset = g_count % g_cyclicMajorTicks;
+        uint16_t index = g_cyclicIndex;
+        uint16_t n;
+        for (n = 0; n < g_cyclicNumFrames; n++) {
+            const CyclicFrame_t* frame = &g_cyclicFrames[index];
+            uint32_t ticks = (frame->Tick + g_cyclicMajorTicks - offset) % g_cyclicMajorTicks;
+            if (ticks == 0) {
+                ticks = g_cyclicMajorTicks;
+            }
+            if (ticks >= next) {
+                break;
             }
+            if (frame->Mask & g_enabledMask & ~(g_foregroundMask | g_eventMask)) {
+                return ticks;
+            }
+            index = (index + 1 == g_cyclicNumFrames) ? 0 : index + 1;
+        }
+        return next;
+    }
+
+    for (i = 0; i < g_numTasks; i++) {
+        const Task_t* task = g_runOrder[i];
+        if (task->Queued) {
+            int32_t ticks = (int32_t)(task->NextRun - g_count);
+            if (ticks <= 0) {
+                return 0;
+            }
+            if ((uint32_t)ticks < next) {
+                next = ticks;
+            }
+        }
+    }
+    return next;
+}
+
+/*
+ * Number of tick boundaries passed after sleeping for elapsed cycles,
+ * when the first boundary was first_tick cycles away
+ */
+uint32_t
+TicksElapsed(uint32_t elapsed, uint32_t first_tick)
+{
+    if (elapsed < first_tick) {
+        return 0;
+    }
+    return 1 + (elapsed - first_tick) / g_cyclesPerTick;
+}
+
+/*
+ * Sleeps until the next task is due or any interrupt fires.
+ * For sleeps longer than a tick SysTick is stretched to the deadline
+ * and the skipped ticks are added to g_count on wake up, so tick time
+ * stays correct whichever interrupt woke the CPU. The counter is
+ * stopped for a few cycles while it is reprogrammed.
+ */
+void
+KernelIdle(void)
+{
+    IntMasterDisable();
+
+    uint32_t sleep_ticks = TicksToNextTask();
+    if (sleep_ticks == 0 || g_count != g_lastCount) {
+        IntMasterEnable();
+        return;
+    }
+
+    if (sleep_ticks == 1) {
+        // Next tick is the deadline, SysTick wakes us as normal
+        CPUwfi();
+        IntMasterEnable();
+        return;
+    }
+
+    // SysTickDisable() reads, and so clears, the COUNT flag; a tick that
+    // ended shows as the SysTick interrupt pending behind the mask
+    SysTickDisable();
+    if (HWREG(NVIC_INT_CTRL) & NVIC_INT_CTRL_PEND_SYST) {
+        // A tick ended before disabling, let it be handled first
+        SysTickEnable();
+        IntMasterEnable();
+        return;
+    }
+
+    uint32_t first_tick = SysTickValueGet();
+    uint32_t reload = first_tick + (sleep_ticks - 1) * g_cyclesPerTick;
+    SysTickPeriodSet(reload);
+    HWREG(NVIC_ST_CURRENT) = 0;
+    SysTickEnable();
+
+    CPUwfi();
+
+    // Interrupts are still masked here, fix the tick count before any run
+    SysTickDisable();
+    uint32_t elapsed;
+    uint32_t passed;
+    if (HWREG(NVIC_INT_CTRL) & NVIC_INT_CTRL_PEND_SYST) {
+        // Slept to the deadline, the pending SysTick interrupt adds the last
+        // tick. The counter restarted from reload - 1, or still reads 0 on
+        // the cycle it wrapped.
+        uint32_t value = SysTickValueGet();
+        elapsed = reload + (value ? reload - value : 0);
+        passed = sleep_ticks - 1;
+    } else {
+        // Woken early by another interrupt
+        elapsed = reload - SysTickValueGet();
+        passed = TicksElapsed(elapsed, first_tick);
+    }
+    g_count += passed;
+    g_sleptTicks += passed;
+
+    // Finish the partly elapsed tick, then back to the normal period
+    uint32_t into_tick = (elapsed >= first_tick) ? (elapsed - first_tick) % g_cyclesPerTick
+                                                 : elapsed + g_cyclesPerTick - first_tick;
+    uint32_t left = g_cyclesPerTick - into_tick;
+    SysTickPeriodSet(left ? left : g_cyclesPerTick);
+    HWREG(NVIC_ST_CURRENT) = 0;
+    SysTickEnable();
+    SysTickPeriodSet(g_cyclesPerTick);
+
+    IntMasterEnable();
+}
+
+/*
+ * Releases every tick since the last pass from the wheel, and any
+ * signalled event tasks, then runs the ready tasks once each. Work per
+ * tick is the size of one wheel slot plus the tasks actually due,
+ * independent of the task count.
+ */
+void
+RunKernel(void)
+{
+    uint32_t now = g_count;
+    uint32_t tick_cycles = g_tickCycles;
+
+    if (now != g_lastCount){
+        uint32_t tick;
+
+        uint32_t skipped = now - g_lastCount - 1;
+        if (skipped > g_sleptTicks) {
+            g_missedTicks += skipped - g_sleptTicks;
+        }
+        g_sleptTicks = 0;
+
+        for (tick = g_lastCount + 1; tick != now + 1; tick++) {
+            ReleaseTick(tick);
         }
-        g_lastCount= g_count;
+        g_lastCount = now;
+    }
+
+    if (g_signalMask & ~g_foregroundMask) {
+        ReleaseSignals();
+    }
+
+    while (g_readyMask) {
+        DispatchTask(NextReadyTask(), now, tick_cycles);
     }
+
+    if (g_tickless) {
+        KernelIdle();
+    }
+}
+
+/*
+ * Copies a task's profile, with interrupts masked so a foreground run
+ * can't update it halfway through
+ */
+bool
+GetTaskStats(TaskHandle_t task, TaskStats_t* stats)
+{
+    if (task == NULL) {
+        return false;
+    }
+
+    bool masked = IntMasterDisable();
+    *stats = task->Stats;
+    if (!masked) {
+        IntMasterEnable();
+    }
+    return true;
+}
+
+void
+ResetTaskStats(void)
+{
+    uint8_t i;
+    bool masked = IntMasterDisable();
+
+    for (i = 0; i < g_numTasks; i++)
+    {
+        TaskStats_t empty = {0};
+        empty.MinCycles = UINT32_MAX;
+        empty.MinLatency = UINT32_MAX;
+        g_runOrder[i]->Stats = empty;
+    }
+    g_missedTicks = 0;
+
+    if (!masked) {
+        IntMasterEnable();
+    }
+}
+
+/*
+ * Prints one line per task (in run order) through t_print,
+ * times in microseconds: exec min/mean/max, latency min/mean/max,
+ * jitter, then overrun, missed release and dropped run counts
+ */
+void
+DumpTaskStats(void (*t_print)(const char*))
+{
+    char line[STATS_LINE_SIZE];
+    uint8_t i;
+
+    usnprintf(line, sizeof(line), "task\tticks\truns\texec\tlatency\tjit\tovr\tmis\tdrp\r\n");
+    t_print(line);
+
+    for (i = 0; i < g_numTasks; i++)
+    {
+        TaskStats_t snapshot;
+        const TaskStats_t* stats = &snapshot;
+        if (!GetTaskStats(g_runOrder[i], &snapshot) || (stats->Runs == 0 && stats->Dropped == 0)) {
+            continue;
+        }
+
+        uint32_t runs = stats->Runs ? stats->Runs : 1;
+        uint32_t mean_exec = stats->TotalCycles / runs;
+        uint32_t mean_latency = stats->TotalLatency / runs;
+
+        usnprintf(line, sizeof(line), "%d\t%d\t%u\t%u/%u/%u\t%u/%u/%u\t%u\t%u\t%u\t%u\r\n",
+                  i,
+                  g_runOrder[i]->NumTicks,
+                  stats->Runs,
+                  stats->MinCycles / g_cyclesPerUs,
+                  mean_exec / g_cyclesPerUs,
+                  stats->MaxCycles / g_cyclesPerUs,
+                  stats->MinLatency / g_cyclesPerUs,
+                  mean_latency / g_cyclesPerUs,
+                  stats->MaxLatency / g_cyclesPerUs,
+                  (stats->MaxLatency - stats->MinLatency) / g_cyclesPerUs,
+                  stats->Overruns,
+                  stats->Missed,
+                  stats->Dropped);
+        t_print(line);
+    }
+
+    usnprintf(line, sizeof(line), "missed ticks: %u\r\n", g_missedTicks);
+    t_print(line);
+}
+
+/*
+ * Sets up a mailbox over buffer, which must hold 2 * size bytes
+ */
+void
+MailboxInit(Mailbox_t* mailbox, void* buffer, uint16_t size)
+{
+    mailbox->Seq = 0;
+    mailbox->Size = size;
+    mailbox->Buffer = buffer;
+}
+
+/*
+ * Publishes size bytes from data. Only one tier may write a mailbox.
+ */
+void
+MailboxWrite(Mailbox_t* mailbox, const void* data)
+{
+    uint32_t seq = mailbox->Seq + 1;
+    volatile uint8_t* copy = &mailbox->Buffer[(seq & 1) * mailbox->Size];
+    const uint8_t* from = data;
+    uint16_t i;
+
+    for (i = 0; i < mailbox->Size; i++) {
+        copy[i] = from[i];
+    }
+    mailbox->Seq = seq;
+}
+
+/*
+ * Copies the last published value into data.
+ * Returns false if nothing has been written yet.
+ */
+bool
+MailboxRead(Mailbox_t* mailbox, void* data)
+{
+    uint8_t* to = data;
+    uint32_t seq;
+    uint16_t i;
+
+    do {
+        seq = mailbox->Seq;
+        const volatile uint8_t* copy = &mailbox->Buffer[(seq & 1) * mailbox->Size];
+        for (i = 0; i < mailbox->Size; i++) {
+            to[i] = copy[i];
+        }
+    } while (mailbox->Seq != seq);
+
+    return seq != 0;
 }
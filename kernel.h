@@ -9,15 +9,96 @@
 **/
 
 #include <stdint.h>
+#include <stdbool.h>
 
+/*
+ * Order in which due tasks run within a tick
+ */
+typedef enum {
+    SCHED_PRIORITY = 0,     // hand assigned Priority, 0 first
+    SCHED_RATE_MONOTONIC,   // shortest NumTicks first
+    SCHED_EDF               // earliest absolute deadline first
+} SchedPolicy_t;
+
+/*
+ * What happens to a task released again before its late run is done
+ */
+typedef enum {
+    OVERRUN_REALIGN = 0,    // run late once, skip to the next grid tick
+    OVERRUN_CATCH_UP,       // run once for every release, late ones back to back
+    OVERRUN_DROP            // skip a run a whole period late
+} OverrunPolicy_t;
+
+/*
+ * Where a task runs. Foreground tasks run from the SysTick interrupt
+ * on their release tick, ahead of and preempting the background loop,
+ * so they must be short and have a budget.
+ */
+typedef enum {
+    TIER_BACKGROUND = 0,    // from RunKernel in the main loop
+    TIER_FOREGROUND         // from SysTickIntHandler
+} TaskTier_t;
+
+/*
+ * What releases a task. NumTicks of an event task is the shortest time
+ * between its signals, used by the admission test.
+ */
+typedef enum {
+    ACTIVATE_PERIODIC = 0,  // by the tick, on its phase grid
+    ACTIVATE_EVENT          // by TaskSignal, e.g. from an interrupt
+} Activation_t;
+
+/*
+ * Per-task profiling, all times in CPU cycles.
+ * Latency is measured from the tick the task became due
+ * to the moment it started, jitter is MaxLatency - MinLatency.
+ */
 typedef struct {
-    // function name
-    void* FunctionPtr;
+    uint32_t Runs;
+    uint32_t MinCycles;
+    uint32_t MaxCycles;
+    uint64_t TotalCycles;
+    uint32_t MinLatency;
+    uint32_t MaxLatency;
+    uint64_t TotalLatency;
+
+    // Runs that took longer than one kernel tick
+    uint32_t Overruns;
+
+    // Releases skipped because the task was late (for event tasks,
+    // signals merged into one still waiting to run)
+    uint32_t Missed;
+
+    // Late runs dropped by OVERRUN_DROP
+    uint32_t Dropped;
+} TaskStats_t;
+
+#define MAXTASKS 32
+
+typedef void (*TaskFunction_t)(void);
+
+/*
+ * Static description of a task, for const tables in flash
+ */
+typedef struct {
+    TaskFunction_t Function;
+    uint16_t NumTicks;
+    uint8_t Priority;
+    uint8_t RunTask;
+    uint32_t WcetUs;
+    OverrunPolicy_t Overrun;
+    TaskTier_t Tier;
+    Activation_t Activation;
+} TaskConfig_t;
+
+typedef struct Task_s {
+    // function to run
+    TaskFunction_t Function;
 
     // Number of ticks before the function gets called again
     uint16_t NumTicks;
 
-    // The order tasks run, 0 first. 
+    // The order tasks run, 0 first.
     uint8_t Priority;
 
     // 0 or 1, if task should run
@@ -25,8 +106,83 @@ typedef struct {
 
     // last time task ran
     uint32_t LastRun;
+
+    // tick the task is next due on the phase grid
+    uint32_t Release;
+
+    // tick the task waits for on the timing wheel (after Release
+    // when catching up)
+    uint32_t NextRun;
+
+    // OverrunPolicy_t
+    uint8_t Overrun;
+
+    // TaskTier_t
+    uint8_t Tier;
+
+    // Activation_t
+    uint8_t Activation;
+
+    // cycle count when an event task was signalled
+    uint32_t ReleaseCycles;
+
+    // release behind the last run (tick, or cycle count for event
+    // tasks) and the time from it to the release of the current run
+    uint32_t PrevRelease;
+    uint32_t ElapsedUs;
+
+    // 1 until the first run after being enabled
+    uint8_t Resumed;
+
+    // releases fall on ticks where tick % NumTicks == Phase
+    uint16_t Phase;
+
+    // worst case execution time budget in us, 0 for best effort
+    uint32_t WcetUs;
+
+    // worst case response time in us from the admission test
+    uint32_t ResponseUs;
+
+    // position in the run order, bit in the ready mask
+    uint8_t Rank;
+
+    // 1 while waiting on the timing wheel
+    uint8_t Queued;
+
+    // timing wheel slot list
+    struct Task_s* Next;
+    struct Task_s* Prev;
+
+    // execution profile
+    TaskStats_t Stats;
 } Task_t ;
 
+typedef Task_t* TaskHandle_t;
+
+/*
+ * One entry of a generated cyclic executive schedule
+ */
+typedef struct {
+    // tick within the major frame
+    uint16_t Tick;
+
+    // task ids released on that tick
+    uint32_t Mask;
+} CyclicFrame_t;
+
+/*
+ * Hands a value between the tiers, one writer and any number of readers.
+ * Buffer holds two copies of Size bytes. A write fills the copy that is
+ * not published and then bumps Seq, so a foreground reader always gets a
+ * whole value and a background reader retries if a write lands while it
+ * is copying.
+ */
+typedef struct {
+    volatile uint32_t Seq;
+    uint16_t Size;
+    volatile uint8_t* Buffer;
+} Mailbox_t;
+
 
 void
 SysTickIntHandler(void);
@@ -37,16 +193,83 @@ InitClock(uint32_t KERNEL_RATE_HZ);
 void
 InitKernel(uint32_t KERNEL_RATE_HZ);
 
+bool
+SetSchedPolicy(SchedPolicy_t policy);
+
+TaskHandle_t
+AddTask(TaskFunction_t function, uint16_t numTicks, uint8_t priority, uint8_t runTask, uint32_t wcetUs,
+        OverrunPolicy_t overrun, TaskTier_t tier, Activation_t activation);
+
+bool
+AddTaskTable(const TaskConfig_t* table, uint8_t numTasks);
+
+TaskHandle_t
+GetTask(uint8_t id);
+
+bool
+UseCyclicSchedule(const CyclicFrame_t* frames, uint16_t numFrames, uint16_t majorTicks);
+
+void
+AssignPhases(void);
+
+void
+SetTaskPhase(TaskHandle_t task, uint16_t phase);
+
+void
+GetTickLoad(uint32_t* peakUs, uint32_t* avgUs);
+
+uint32_t
+GetTaskResponseTime(TaskHandle_t task);
+
+uint32_t
+GetTaskElapsedUs(TaskHandle_t task);
+
+void
+TaskEnable(TaskHandle_t task);
+
 void
-AddTask(void* functionPtr, uint16_t numTicks, uint8_t priority, uint8_t runTask);
+TaskDisable(TaskHandle_t task);
 
 void
-TaskEnable(void* functionPtr);
+TaskSignal(TaskHandle_t task);
 
 void
-TaskDisable(void* functionPtr);
+PendSVIntHandler(void);
 
 void
 RunKernel(void);
 
+void
+SetTicklessIdle(bool enable);
+
+void
+KernelIdle(void);
+
+uint32_t
+GetCycleCount(void);
+
+uint32_t
+GetTickCount(void);
+
+uint32_t
+GetMissedTicks(void);
+
+bool
+GetTaskStats(TaskHandle_t task, TaskStats_t* stats);
+
+void
+ResetTaskStats(void);
+
+void
+DumpTaskStats(void (*t_print)(const char*));
+
+void
+MailboxInit(Mailbox_t* mailbox, void* buffer, uint16_t size);
+
+void
+MailboxWrite(Mailbox_t* mailbox, const void* data);
+
+bool
+MailboxRead(Mailbox_t* mailbox, void* data);
+
 #endif
@@ -6,9 +6,13 @@
  * adds tasks to scheduler and calls it
 **/
 
+#include <stddef.h>
+#include <string.h>
+
 #include "buttons4.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/interrupt.h"
+#include "utils/ustdlib.h"
 
 // Helper modules
 #include "altitude.h"
@@ -18,41 +22,55 @@
 #include "switch.h"
 #include "kernel.h"
 #include "serial.h"
+#include "tasks.h"
+#include "schedule.h"
 
 // Macros for the kernel
-#define KERNEL_RATE_HZ 2000
-#define OFF 0
-#define ON 1
+#define TICKLESS_IDLE 1
+#define SCHED_POLICY SCHED_RATE_MONOTONIC
+#define CYCLIC_EXECUTIVE 0
 
-/*
- * Priorities and ticks for each task.
- *
- * You can calculate the equivalent frequency of a given task by:
- * TASK_FREQUENCY = KERNEL_RATE_HZ / TASK_TICKS
- */
-#define ADC_PRIORITY 0
-#define ADC_TICKS 10
+// Altitude acquisition, g_adcSingleSource, g_adcDmaSource or g_adcPwmSource
+#define ALT_SOURCE g_adcPwmSource
 
-#define SETPOINT_PRIORITY 1
-#define SETPOINT_TICKS 75
+// Altitude smoothing (FilterType_t, param, median taps). Two first order
+// stages with alpha 1/4 behind a median of 3 lag 35 ms, against 57.5 ms
+// for the old 24 sample boxcar (FILTER_BOXCAR, 24, 0), and pass 7% of
+// the white noise power against 4%.
+#define ALT_FILTER FILTER_IIR2
+#define ALT_FILTER_PARAM 2
+#define ALT_FILTER_MEDIAN 3
 
-#define SWITCH_PRIORITY 6
-#define SWITCH_TICKS 200
+// Yaw sensing, g_yawGpioSource or g_yawQeiSource (encoder moved to
+// PD6/PD7/PD3)
+#define YAW_SOURCE g_yawGpioSource
 
-#define CONTROL_PRIORITY 3
-#define CONTROL_TICKS 45
+// Send task profiles and the sensor to actuator latency histograms
+// over UART instead of the flight data
+#define REPORT_TIMING 0
 
-#define DISPLAY_PRIORITY 4
-#define DISPLAY_TICKS 100
+// Longest report line: a histogram line with every count at 10 digits
+#define TIMING_LINE_SIZE 200
+#define TIMING_REPORT_SIZE 1024
 
-#define GND_PRIORITY 2
-#define GND_TICKS 3000
+// The report (about 600 bytes) is far more than a UART run can send:
+// each run (50 ms) earns this many bytes of credit, and whole lines go
+// out as the credit covers them. 800 B/s against the 960 B/s of 9600
+// baud, so about 0.75 s a report.
+#define REPORT_BYTES_PER_RUN 40
 
-#define UART_PRIORITY 5
-#define UART_TICKS 500
+// Handles for tasks switched on and off at run time
+static TaskHandle_t g_controlTask;
+static TaskHandle_t g_setPointTask;
+static TaskHandle_t g_switchLogicTask;
+static TaskHandle_t g_groundRefTask;
 
-#define RESET_PRIORITY 7
-#define RESET_TICKS 500
+#if REPORT_TIMING
+// Timing report text, and how much of it has been sent
+static char g_report[TIMING_REPORT_SIZE];
+static uint16_t g_reportLength;
+static uint16_t g_reportSent;
+#endif
 
 /*
  * Main initialiser function
@@ -62,13 +80,15 @@ void
 MainInit(void)
 {
     InitKernel(KERNEL_RATE_HZ);
-    InitADC();
+    SetTicklessIdle(TICKLESS_IDLE);
+    InitMotors();
+    InitADC(&ALT_SOURCE);
+    SetAltFilter(ALT_FILTER, ALT_FILTER_PARAM, ALT_FILTER_MEDIAN);
     initButtons();
     InitDisplay();
-    InitMotors();
     InitSwitch();
     InitUart();
-    InitQuad();
+    InitQuad(&YAW_SOURCE);
     IntMasterEnable();
 }
 
@@ -78,13 +98,30 @@ ADCTask(void)
     ADCProcessTrigger();
 }
 
+/*
+ * Runs in the foreground, reads its own measurements
+ * rather than waiting for the display to refresh them
+ */
 void
 ControlTask(void)
 {
-    int32_t altitude_effort = AltController();
-    int32_t yaw_effort = YawController();
-    SetMainPWM(altitude_effort);
-    SetTailPWM(yaw_effort);
+    uint32_t dt_us = GetTaskElapsedUs(g_controlTask);
+
+    GetAltPercent();
+    GetYawAngle();
+
+    int32_t altitude_effort = AltController(dt_us);
+    int32_t yaw_effort = YawController(dt_us, altitude_effort);
+    SetMotorDutiesSampled(altitude_effort, yaw_effort, GetAltSampleCycles(), GetYawSampleCycles());
+}
+
+/*
+ * ADC block callback, releases the controller on fresh samples
+ */
+void
+SignalControl(void)
+{
+    TaskSignal(g_controlTask);
 }
 
 /*
@@ -105,18 +142,18 @@ void
 SwitchLogicTask(void)
 {
     if(SwitchUp() && Hover() && Stable()) {
-        TaskEnable(&ControlTask);
-        TaskEnable(&SetPointTask);
+        TaskEnable(g_controlTask);
+        TaskEnable(g_setPointTask);
 
     } else if (!SwitchUp() && !AltitudeLand() && !YawLand()) {
-        TaskEnable(&ControlTask);
-        TaskDisable(&SetPointTask);
+        TaskEnable(g_controlTask);
+        TaskDisable(g_setPointTask);
 
     } else if (!SwitchUp() && AltitudeLand() && YawLand()) {
-        TaskDisable(&ControlTask);
-        TaskDisable(&SetPointTask);
+        TaskDisable(g_controlTask);
+        TaskDisable(g_setPointTask);
     } else {
-        TaskDisable(&ControlTask);
+        TaskDisable(g_controlTask);
     }
 }
 
@@ -127,8 +164,8 @@ void
 GroundRefTask(void)
 {
     SetAltitudeRef();
-    TaskDisable(&GroundRefTask);
-    TaskEnable(&SwitchLogicTask);
+    TaskDisable(g_groundRefTask);
+    TaskEnable(g_switchLogicTask);
 }
 
 void
@@ -137,10 +174,110 @@ DisplayTask(void)
     UpdateDisplay();
 }
 
+#if REPORT_TIMING
+/*
+ * Adds a line to the timing report, whole or not at all
+ */
+static void
+ReportAppend(const char* line)
+{
+    uint16_t length = strlen(line);
+
+    if (g_reportLength + length <= sizeof(g_report)) {
+        memcpy(&g_report[g_reportLength], line, length);
+        g_reportLength += length;
+    }
+}
+
+/*
+ * Formats the timing report: task profiles, the peak and mean tick
+ * load the phases give (check against tools/gen_schedule.py), the
+ * altitude filter's delay and noise gain, then a line per rotor of latency bin counts (see
+ * LatencyHist_t) and the worst latency in us, as of the last report
+ */
+static void
+ReportTiming(void)
+{
+    static const char* const names[NUM_MOTORS] = {"main", "tail"};
+    char line[TIMING_LINE_SIZE];
+    LatencyHist_t hist;
+    uint8_t motor, bin;
+    uint32_t delay_us, noise_gain;
+    uint32_t peak_us, mean_us;
+    int32_t length;
+
+    g_reportLength = 0;
+    g_reportSent = 0;
+    DumpTaskStats(ReportAppend);
+
+    GetTickLoad(&peak_us, &mean_us);
+    usnprintf(line, sizeof(line), "load %uus %uus\r\n", peak_us, mean_us);
+    ReportAppend(line);
+
+    GetAltFilterFigures(&delay_us, &noise_gain);
+    usnprintf(line, sizeof(line), "alt %uus %u/65536\r\n", delay_us, noise_gain);
+    ReportAppend(line);
+
+    for (motor = 0; motor < NUM_MOTORS; motor++) {
+        if (!GetLatencyHistogram(motor, &hist)) {
+            continue;
+        }
+        length = usnprintf(line, sizeof(line), "%s", names[motor]);
+        for (bin = 0; bin < LATENCY_BINS; bin++) {
+            length += usnprintf(&line[length], sizeof(line) - length, " %u", hist.Bins[bin]);
+        }
+        usnprintf(&line[length], sizeof(line) - length, " max %u\r\n", hist.MaxUs);
+        ReportAppend(line);
+    }
+
+    // Fresh histograms for the next report
+    RequestLatencyHistograms();
+}
+
+/*
+ * Sends the report's next whole lines as far as the credit goes, each
+ * in one UartWrite(), and formats a new report once it is all sent
+ */
+static void
+SendTimingReport(void)
+{
+    static uint32_t credit;
+    const char* start;
+    const char* end;
+    uint16_t length;
+
+    if (g_reportSent >= g_reportLength) {
+        ReportTiming();
+    }
+
+    // Capped at a line so a quiet spell doesn't bank a burst
+    credit += REPORT_BYTES_PER_RUN;
+    if (credit > TIMING_LINE_SIZE) {
+        credit = TIMING_LINE_SIZE;
+    }
+
+    while (g_reportSent < g_reportLength) {
+        start = &g_report[g_reportSent];
+        end = memchr(start, '\n', g_reportLength - g_reportSent);
+        length = end ? (end - start + 1) : (g_reportLength - g_reportSent);
+        if (length > credit) {
+            break;
+        }
+        UartWrite(start, length);
+        credit -= length;
+        g_reportSent += length;
+    }
+}
+#endif
+
 void
 UARTTask(void)
 {
+#if REPORT_TIMING
+    SendTimingReport();
+#else
     SendValues();
+#endif
 }
 
 /*
@@ -155,19 +292,47 @@ ResetTask(void)
     }
 }
 
+// The task table, in flash
+#define TASK_CONFIG(function, ticks, priority, state, wcet, overrun, tier, activation) \
+    {function, ticks, priority, state, wcet, overrun, tier, activation},
+static const TaskConfig_t g_taskTable[NUM_TASKS] = {
+    TASK_TABLE(TASK_CONFIG)
+};
+
 int
 main(void)
 {
     MainInit();
 
-    AddTask(&ADCTask,         ADC_TICKS,      ADC_PRIORITY,      ON);
-    AddTask(&SetPointTask,    SETPOINT_TICKS, SETPOINT_PRIORITY, OFF);
-    AddTask(&SwitchLogicTask, SWITCH_TICKS,   SWITCH_PRIORITY,   OFF);
-    AddTask(&ControlTask,     CONTROL_TICKS,  CONTROL_PRIORITY,  OFF);
-    AddTask(&DisplayTask,     DISPLAY_TICKS,  DISPLAY_PRIORITY,  ON);
-    AddTask(&GroundRefTask,   GND_TICKS,      GND_PRIORITY,      ON);
-    AddTask(&UARTTask,        UART_TICKS,     UART_PRIORITY,     ON);
-    AddTask(&ResetTask,       RESET_TICKS,    RESET_PRIORITY,    ON);
+    SetSchedPolicy(SCHED_POLICY);
+
+    // A task set that can miss a period doesn't fly: report it and
+    // stop here, with the motors at the zero duty InitMotors() left
+    if (!AddTaskTable(g_taskTable, NUM_TASKS)) {
+        UartSend("task table not schedulable\r\n");
+        while(1)
+        {
+        }
+    }
+    AssignPhases();
+
+    g_controlTask     = GetTask(ControlTask_ID);
+    g_setPointTask    = GetTask(SetPointTask_ID);
+    g_switchLogicTask = GetTask(SwitchLogicTask_ID);
+    g_groundRefTask   = GetTask(GroundRefTask_ID);
+
+    // Hardware paced sources need no ADC task
+    if (ALT_SOURCE.Trigger == NULL) {
+        TaskDisable(GetTask(ADCTask_ID));
+    }
+
+    if (CONTROL_ACTIVATION == ACTIVATE_EVENT) {
+        SetAltBlockCallback(SignalControl, CONTROL_SAMPLES);
+    }
+
+#if CYCLIC_EXECUTIVE
+    UseCyclicSchedule(g_cyclicSchedule, CYCLIC_NUM_FRAMES, CYCLIC_MAJOR_TICKS);
+#endif
 
     while(1)
     {
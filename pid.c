@@ -0,0 +1,248 @@
+/**
+ * @filename: pid.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 22.05.2024
+ * @purpose: Function definitions for the PID controllers
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pid.h"
+
+/*
+ * Q16.16 product
+ */
+static q16_t
+QMul(q16_t a, q16_t b)
+{
+    return (q16_t)(((int64_t)a * b) >> 16);
+}
+
+/*
+ * Saturates a wide value to [low, high]
+ */
+static int64_t
+Clamp64(int64_t value, int64_t low, int64_t high)
+{
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+/*
+ * An integer as Q16.16, saturated to the +-32767 that fits
+ */
+static q16_t
+ToQ16(int32_t value)
+{
+    return (q16_t)Clamp64(value, -Q16_INT_MAX, Q16_INT_MAX) * Q16_ONE;
+}
+
+static float
+ClampF(float value, float low, float high)
+{
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+/*
+ * Takes the fixed point gains from the float ones and clears the
+ * state. Call after setting the gains, limits and Offset.
+ */
+void
+PidInit(PID_t* pid)
+{
+    if (pid->DFilter <= 0 || pid->DFilter > 1) {
+        pid->DFilter = 1;
+    }
+
+    pid->KpQ = FLOAT_TO_Q16(pid->Kp);
+    pid->KiQ = FLOAT_TO_Q16(pid->Ki);
+    pid->KdQ = FLOAT_TO_Q16(pid->Kd);
+    pid->DFilterQ = FLOAT_TO_Q16(pid->DFilter);
+    pid->KtQ = FLOAT_TO_Q16(pid->Kt);
+
+    pid->Integral = 0;
+    pid->Derivative = 0;
+    pid->IntegralQ = 0;
+    pid->DerivativeQ = 0;
+    pid->Primed = false;
+}
+
+/*
+ * Forgets the integral, e.g. on a new setpoint
+ */
+void
+PidResetIntegral(PID_t* pid)
+{
+    pid->Integral = 0;
+    pid->IntegralQ = 0;
+}
+
+/*
+ * Float update, dt in seconds since the last one. Returns the
+ * saturated output rounded to the nearest integer.
+ */
+int32_t
+PidUpdate(PID_t* pid, int32_t error, float dt)
+{
+    float derivative;
+    float out;
+    float sat;
+
+    if (!pid->Primed) {
+        pid->prev_read_value = pid->read_value;
+        pid->Primed = true;
+    }
+
+    // Derivative on measurement, low passed. With no time passed there
+    // is nothing to difference, so it holds.
+    if (pid->RateInput) {
+        derivative = -pid->Kd * pid->read_rate;
+    } else if (pid->Kd != 0 && dt > 0) {
+        derivative = -pid->Kd * (pid->read_value - pid->prev_read_value) / dt;
+    } else {
+        derivative = pid->Derivative;
+    }
+    pid->prev_read_value = pid->read_value;
+    pid->Derivative += pid->DFilter * (derivative - pid->Derivative);
+
+    // Integral clamped to what the output can use
+    pid->Integral += pid->Ki * error * dt;
+    pid->Integral = ClampF(pid->Integral, pid->OutMin - pid->Offset, pid->OutMax - pid->Offset);
+
+    out = pid->Offset + pid->Kp * error + pid->Integral + pid->Derivative;
+    sat = ClampF(out, pid->OutMin, pid->OutMax);
+
+    // Back-calculation: bleed off what saturation cut
+    pid->Integral += pid->Kt * dt * (sat - out);
+
+    return (sat < 0) ? (int32_t)(sat - 0.5f) : (int32_t)(sat + 0.5f);
+}
+
+/*
+ * Q16.16 update, dt in seconds since the last one. Same maths as
+ * PidUpdate() with no float operations. The error and the step in
+ * read_value saturate at +-Q16_INT_MAX.
+ */
+int32_t
+PidUpdateQ16(PID_t* pid, int32_t error, q16_t dt)
+{
+    q16_t e = ToQ16(error);
+    q16_t dm;
+    q16_t derivative;
+    int64_t inv_dt;
+    int64_t low = (int64_t)(pid->OutMin - pid->Offset) << 32;
+    int64_t high = (int64_t)(pid->OutMax - pid->Offset) << 32;
+    int64_t out;
+    int64_t sat;
+
+    if (!pid->Primed) {
+        pid->prev_read_value = pid->read_value;
+        pid->Primed = true;
+    }
+
+    // Derivative on measurement, low passed. With no time passed there
+    // is nothing to difference, so it holds.
+    if (pid->RateInput) {
+        derivative = -(q16_t)((int64_t)pid->KdQ * pid->read_rate);
+    } else if (pid->KdQ != 0 && dt > 0) {
+        inv_dt = ((int64_t)1 << 32) / dt;
+        dm = ToQ16(pid->read_value - pid->prev_read_value);
+        derivative = -(q16_t)(((int64_t)QMul(pid->KdQ, dm) * inv_dt) >> 16);
+    } else {
+        derivative = pid->DerivativeQ;
+    }
+    pid->prev_read_value = pid->read_value;
+    pid->DerivativeQ += QMul(pid->DFilterQ, derivative - pid->DerivativeQ);
+
+    // Integral (Q32.32) clamped to what the output can use
+    pid->IntegralQ += (int64_t)QMul(pid->KiQ, e) * dt;
+    pid->IntegralQ = Clamp64(pid->IntegralQ, low, high);
+
+    out = ((int64_t)pid->Offset << 16) + QMul(pid->KpQ, e) + (pid->IntegralQ >> 16) + pid->DerivativeQ;
+    sat = Clamp64(out, (int64_t)pid->OutMin << 16, (int64_t)pid->OutMax << 16);
+
+    // Back-calculation: bleed off what saturation cut. Kt * dt is kept
+    // whole, with the yaw loop's Kt and dt it is under one Q16 count.
+    pid->IntegralQ += ((int64_t)pid->KtQ * dt * (sat - out)) >> 16;
+
+    return (int32_t)((sat + Q16_ONE / 2) >> 16);
+}
+
+/*
+ * Update with dt in us, through the implementation PID_FIXED_POINT picks
+ */
+int32_t
+PidStep(PID_t* pid, int32_t error, uint32_t dtUs)
+{
+#if PID_FIXED_POINT
+    return PidUpdateQ16(pid, error, (q16_t)(((uint64_t)dtUs << 16) / 1000000));
+#else
+    return PidUpdate(pid, error, dtUs * 1e-6f);
+#endif
+}
+
+/*
+ * Appends a copy of an initialised controller to a batch, its read_value
+ * taken as the last measurement. Returns false if the batch is full.
+ */
+bool
+PidBatchAdd(PidBatch_t* batch, const PID_t* pid)
+{
+    uint8_t i = batch->Count;
+
+    if (i >= PID_BATCH_MAX) {
+        return false;
+    }
+
+    batch->Kp[i] = pid->KpQ;
+    batch->Ki[i] = pid->KiQ;
+    batch->Kd[i] = pid->KdQ;
+    batch->DFilter[i] = pid->DFilterQ;
+    batch->Kt[i] = pid->KtQ;
+    batch->Offset[i] = pid->Offset * Q16_ONE;
+    batch->OutMin[i] = pid->OutMin * Q16_ONE;
+    batch->OutMax[i] = pid->OutMax * Q16_ONE;
+    batch->Integral[i] = 0;
+    batch->Derivative[i] = 0;
+    batch->PrevMeasurement[i] = pid->read_value * Q16_ONE;
+    batch->Count = i + 1;
+    return true;
+}
+
+/*
+ * Runs every controller in the batch once, with the same maths as
+ * PidUpdateQ16(). error, measurement and output are Q16.16 arrays of
+ * batch->Count, dt is shared. No branches beyond selects, so the loop
+ * pipelines (or vectorises where the target can). The derivative
+ * always differences the measurement, RateInput isn't carried over.
+ */
+void
+PidUpdateBatch(PidBatch_t* batch, const q16_t* error, const q16_t* measurement, q16_t dt, q16_t* output)
+{
+    // With no time passed the derivative holds, as in PidUpdateQ16()
+    int64_t inv_dt = (dt > 0) ? ((int64_t)1 << 32) / dt : 0;
+    uint8_t i;
+
+    for (i = 0; i < batch->Count; i++) {
+        q16_t dm = measurement[i] - batch->PrevMeasurement[i];
+        q16_t differenced = -(q16_t)(((int64_t)QMul(batch->Kd[i], dm) * inv_dt) >> 16);
+        q16_t derivative = (dt > 0) ? differenced : batch->Derivative[i];
+        int64_t low = (int64_t)(batch->OutMin[i] - batch->Offset[i]) << 16;
+        int64_t high = (int64_t)(batch->OutMax[i] - batch->Offset[i]) << 16;
+        int64_t out;
+        int64_t sat;
+
+        batch->PrevMeasurement[i] = measurement[i];
+        batch->Derivative[i] += QMul(batch->DFilter[i], derivative - batch->Derivative[i]);
+
+        batch->Integral[i] += (int64_t)QMul(batch->Ki[i], error[i]) * dt;
+        batch->Integral[i] = Clamp64(batch->Integral[i], low, high);
+
+        out = (int64_t)batch->Offset[i] + QMul(batch->Kp[i], error[i]) + (batch->Integral[i] >> 16) +
+              batch->Derivative[i];
+        sat = Clamp64(out, batch->OutMin[i], batch->OutMax[i]);
+
+        batch->Integral[i] += ((int64_t)batch->Kt[i] * dt * (sat - out)) >> 16;
+        output[i] = (q16_t)sat;
+    }
+}
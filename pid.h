@@ -0,0 +1,122 @@
+#ifndef PID_H
+#define PID_H
+
+/**
+ * @filename: pid.h
+ * @authors: Mark Day, Noah Walle
+ * @date: 22.05.2024
+ * @purpose: PID controllers shared by the altitude and yaw loops, in
+ * float and Q16.16 fixed point, with a batch update over several
+ * controllers at once.
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// PidStep() uses the Q16.16 update if 1, the float one if 0
+#define PID_FIXED_POINT 1
+
+// Q16.16: 16 integer and 16 fraction bits
+typedef int32_t q16_t;
+
+#define Q16_ONE 65536
+#define Q16_INT_MAX 32767
+#define FLOAT_TO_Q16(x) ((q16_t)((x) * 65536.0f + (((x) < 0) ? -0.5f : 0.5f)))
+
+/*
+ * Control struct. The error passed to an update is setpoint - read_value
+ * (after any wrap-around); the derivative acts on read_value alone (or
+ * a measured read_rate) so setpoint steps don't kick the output.
+ */
+typedef struct {
+    int32_t setpoint;
+    int32_t prev_setpoint;
+    int32_t read_value;
+    int32_t prev_read_value;
+    float Kp;
+    float Ki;
+    float Kd;
+
+    // cycle count (GetCycleCount) of the sample read_value came from
+    uint32_t read_cycles;
+
+    // rate of change of read_value per second, used for the derivative
+    // in place of differencing read_value when RateInput is set
+    int32_t read_rate;
+    bool RateInput;
+
+    // derivative low pass, d += DFilter * (new d - d), 0 or 1 for none
+    float DFilter;
+
+    // back-calculation anti-windup: the integral is pulled towards
+    // the saturated output at Kt per second, 0 to only clamp it
+    float Kt;
+
+    // added ahead of saturation (hover throttle, tail bias)
+    int32_t Offset;
+
+    // output saturation
+    int32_t OutMin;
+    int32_t OutMax;
+
+    // float state
+    float Integral;
+    float Derivative;
+
+    // Q16.16 gains from PidInit() and state. The integral keeps 32
+    // fraction bits so small Ki * dt steps don't round away.
+    q16_t KpQ;
+    q16_t KiQ;
+    q16_t KdQ;
+    q16_t DFilterQ;
+    q16_t KtQ;
+    int64_t IntegralQ;
+    q16_t DerivativeQ;
+
+    // prev_read_value is valid
+    bool Primed;
+} PID_t;
+
+#define PID_BATCH_MAX 4
+
+/*
+ * Several Q16.16 controllers as a structure of arrays, so one pass of
+ * PidUpdateBatch() runs the same straight-line maths down each column
+ */
+typedef struct {
+    uint8_t Count;
+    q16_t Kp[PID_BATCH_MAX];
+    q16_t Ki[PID_BATCH_MAX];
+    q16_t Kd[PID_BATCH_MAX];
+    q16_t DFilter[PID_BATCH_MAX];
+    q16_t Kt[PID_BATCH_MAX];
+    q16_t Offset[PID_BATCH_MAX];
+    q16_t OutMin[PID_BATCH_MAX];
+    q16_t OutMax[PID_BATCH_MAX];
+    int64_t Integral[PID_BATCH_MAX];
+    q16_t Derivative[PID_BATCH_MAX];
+    q16_t PrevMeasurement[PID_BATCH_MAX];
+} PidBatch_t;
+
+void
+PidInit(PID_t* pid);
+
+void
+PidResetIntegral(PID_t* pid);
+
+int32_t
+PidUpdate(PID_t* pid, int32_t error, float dt);
+
+int32_t
+PidUpdateQ16(PID_t* pid, int32_t error, q16_t dt);
+
+int32_t
+PidStep(PID_t* pid, int32_t error, uint32_t dtUs);
+
+bool
+PidBatchAdd(PidBatch_t* batch, const PID_t* pid);
+
+void
+PidUpdateBatch(PidBatch_t* batch, const q16_t* error, const q16_t* measurement, q16_t dt, q16_t* output);
+
+#endif
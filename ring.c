@@ -0,0 +1,174 @@
+/**
+ * @filename: ring.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 20.05.2024
+ * @purpose: Function definitions for the single producer,
+ * single consumer ring buffer
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "ring.h"
+
+/*
+ * Sets up a ring over data, which holds capacity elements of
+ * elementSize bytes. Returns false unless capacity is a power of two.
+ */
+bool
+RingInit(Ring_t* ring, void* data, uint32_t capacity, uint16_t elementSize)
+{
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+
+    ring->Head = 0;
+    ring->Tail = 0;
+    ring->Mask = capacity - 1;
+    ring->ElementSize = elementSize;
+    ring->Data = data;
+    ring->Overflows = 0;
+    ring->Underruns = 0;
+    return true;
+}
+
+/*
+ * Elements waiting to be read
+ */
+uint32_t
+RingCount(const Ring_t* ring)
+{
+    return ring->Head - ring->Tail;
+}
+
+/*
+ * Elements that can be written
+ */
+uint32_t
+RingSpace(const Ring_t* ring)
+{
+    return ring->Mask + 1 - (ring->Head - ring->Tail);
+}
+
+/*
+ * Producer: adds one element, or counts an overflow and drops it
+ * if the ring is full
+ */
+bool
+RingWrite(Ring_t* ring, const void* element)
+{
+    uint32_t head = ring->Head;
+
+    if (head - ring->Tail > ring->Mask) {
+        ring->Overflows++;
+        return false;
+    }
+
+    memcpy(&ring->Data[(head & ring->Mask) * ring->ElementSize], element, ring->ElementSize);
+    RING_BARRIER();
+    ring->Head = head + 1;
+    return true;
+}
+
+/*
+ * Consumer: takes the oldest element, or counts an underrun
+ * if the ring is empty
+ */
+bool
+RingRead(Ring_t* ring, void* element)
+{
+    uint32_t tail = ring->Tail;
+
+    if (ring->Head == tail) {
+        ring->Underruns++;
+        return false;
+    }
+
+    RING_BARRIER();
+    memcpy(element, &ring->Data[(tail & ring->Mask) * ring->ElementSize], ring->ElementSize);
+    RING_BARRIER();
+    ring->Tail = tail + 1;
+    return true;
+}
+
+/*
+ * Consumer: copies the element offset places after the oldest
+ * without taking it. Returns false if there is no such element.
+ */
+bool
+RingPeek(const Ring_t* ring, uint32_t offset, void* element)
+{
+    uint32_t tail = ring->Tail;
+
+    if (ring->Head - tail <= offset) {
+        return false;
+    }
+
+    RING_BARRIER();
+    memcpy(element, &ring->Data[((tail + offset) & ring->Mask) * ring->ElementSize], ring->ElementSize);
+    return true;
+}
+
+/*
+ * Producer: points span at the free space up to the end of the
+ * storage and returns how many elements fit there. Fill some of it,
+ * then RingCommit() them. A full ring counts an overflow.
+ */
+uint32_t
+RingWriteSpan(Ring_t* ring, void** span)
+{
+    uint32_t head = ring->Head;
+    uint32_t index = head & ring->Mask;
+    uint32_t space = ring->Mask + 1 - (head - ring->Tail);
+    uint32_t to_end = ring->Mask + 1 - index;
+
+    if (space == 0) {
+        ring->Overflows++;
+    }
+
+    *span = &ring->Data[index * ring->ElementSize];
+    return (space < to_end) ? space : to_end;
+}
+
+/*
+ * Producer: publishes count elements written through RingWriteSpan()
+ */
+void
+RingCommit(Ring_t* ring, uint32_t count)
+{
+    RING_BARRIER();
+    ring->Head += count;
+}
+
+/*
+ * Consumer: points span at the oldest elements up to the end of the
+ * storage and returns how many there are. Use some of them, then
+ * RingConsume() them. An empty ring counts an underrun.
+ */
+uint32_t
+RingReadSpan(Ring_t* ring, const void** span)
+{
+    uint32_t tail = ring->Tail;
+    uint32_t index = tail & ring->Mask;
+    uint32_t count = ring->Head - tail;
+    uint32_t to_end = ring->Mask + 1 - index;
+
+    if (count == 0) {
+        ring->Underruns++;
+    }
+
+    RING_BARRIER();
+    *span = &ring->Data[index * ring->ElementSize];
+    return (count < to_end) ? count : to_end;
+}
+
+/*
+ * Consumer: releases count elements read through RingReadSpan()
+ */
+void
+RingConsume(Ring_t* ring, uint32_t count)
+{
+    RING_BARRIER();
+    ring->Tail += count;
+}
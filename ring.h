@@ -0,0 +1,78 @@
+#ifndef RING_H
+#define RING_H
+
+/**
+ * @filename: ring.h
+ * @authors: Mark Day, Noah Walle
+ * @date: 20.05.2024
+ * @purpose: Single producer, single consumer ring buffer for passing
+ * samples from an interrupt to a task without locking. Elements are
+ * any fixed size, the capacity a power of two.
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Orders memory accesses either side of it, for the compiler and the
+ * CPU: the element is written before the producer publishes Head,
+ * and read before the consumer releases it through Tail.
+ */
+#if defined(__GNUC__) && defined(__ARM_ARCH)
+#define RING_BARRIER() __asm volatile ("dmb" ::: "memory")
+#elif defined(__GNUC__)
+#define RING_BARRIER() __sync_synchronize()
+#else
+#define RING_BARRIER() __asm(" dmb")
+#endif
+
+/*
+ * Head and Tail run freely and are masked on use, so Head - Tail is
+ * the count even after they wrap. Only the producer writes Head and
+ * Overflows, only the consumer Tail and Underruns.
+ */
+typedef struct {
+    volatile uint32_t Head;
+    volatile uint32_t Tail;
+    uint32_t Mask;
+    uint16_t ElementSize;
+    uint8_t* Data;
+
+    // writes refused because the ring was full
+    volatile uint32_t Overflows;
+
+    // reads refused because the ring was empty
+    volatile uint32_t Underruns;
+} Ring_t;
+
+bool
+RingInit(Ring_t* ring, void* data, uint32_t capacity, uint16_t elementSize);
+
+uint32_t
+RingCount(const Ring_t* ring);
+
+uint32_t
+RingSpace(const Ring_t* ring);
+
+bool
+RingWrite(Ring_t* ring, const void* element);
+
+bool
+RingRead(Ring_t* ring, void* element);
+
+bool
+RingPeek(const Ring_t* ring, uint32_t offset, void* element);
+
+uint32_t
+RingWriteSpan(Ring_t* ring, void** span);
+
+void
+RingCommit(Ring_t* ring, uint32_t count);
+
+uint32_t
+RingReadSpan(Ring_t* ring, const void** span);
+
+void
+RingConsume(Ring_t* ring, uint32_t count);
+
+#endif
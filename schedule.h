@@ -0,0 +1,48 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+/**
+ * @filename: schedule.h
+ * @purpose: Cyclic executive schedule, generated by
+ * tools/gen_schedule.py from tasks.h. Do not edit.
+ * Bit n of a frame is task id n:
+ *    0 ADCTask          every   10 ticks, phase 1, foreground
+ *    1 SetPointTask     every   75 ticks, phase 0
+ *    2 SwitchLogicTask  every  200 ticks, phase 5
+ *    3 ControlTask      every    4 ticks, phase 0, foreground
+ *    4 DisplayTask      every  100 ticks, phase 2
+ *    5 GroundRefTask    every 3000 ticks, phase 7
+ *    6 UARTTask         every  100 ticks, phase 3
+ *    7 ResetTask        every  500 ticks, phase 6
+**/
+
+#include "kernel.h"
+
+#define CYCLIC_MAJOR_TICKS 3000
+#define CYCLIC_NUM_FRAMES 122
+
+static const CyclicFrame_t g_cyclicSchedule[CYCLIC_NUM_FRAMES] = {
+    {0, 0x02}, {2, 0x10}, {3, 0x40}, {5, 0x04}, {6, 0x80}, {7, 0x20},
+    {75, 0x02}, {102, 0x10}, {103, 0x40}, {150, 0x02}, {202, 0x10}, {203, 0x40},
+    {205, 0x04}, {225, 0x02}, {300, 0x02}, {302, 0x10}, {303, 0x40}, {375, 0x02},
+    {402, 0x10}, {403, 0x40}, {405, 0x04}, {450, 0x02}, {502, 0x10}, {503, 0x40},
+    {506, 0x80}, {525, 0x02}, {600, 0x02}, {602, 0x10}, {603, 0x40}, {605, 0x04},
+    {675, 0x02}, {702, 0x10}, {703, 0x40}, {750, 0x02}, {802, 0x10}, {803, 0x40},
+    {805, 0x04}, {825, 0x02}, {900, 0x02}, {902, 0x10}, {903, 0x40}, {975, 0x02},
+    {1002, 0x10}, {1003, 0x40}, {1005, 0x04}, {1006, 0x80}, {1050, 0x02}, {1102, 0x10},
+    {1103, 0x40}, {1125, 0x02}, {1200, 0x02}, {1202, 0x10}, {1203, 0x40}, {1205, 0x04},
+    {1275, 0x02}, {1302, 0x10}, {1303, 0x40}, {1350, 0x02}, {1402, 0x10}, {1403, 0x40},
+    {1405, 0x04}, {1425, 0x02}, {1500, 0x02}, {1502, 0x10}, {1503, 0x40}, {1506, 0x80},
+    {1575, 0x02}, {1602, 0x10}, {1603, 0x40}, {1605, 0x04}, {1650, 0x02}, {1702, 0x10},
+    {1703, 0x40}, {1725, 0x02}, {1800, 0x02}, {1802, 0x10}, {1803, 0x40}, {1805, 0x04},
+    {1875, 0x02}, {1902, 0x10}, {1903, 0x40}, {1950, 0x02}, {2002, 0x10}, {2003, 0x40},
+    {2005, 0x04}, {2006, 0x80}, {2025, 0x02}, {2100, 0x02}, {2102, 0x10}, {2103, 0x40},
+    {2175, 0x02}, {2202, 0x10}, {2203, 0x40}, {2205, 0x04}, {2250, 0x02}, {2302, 0x10},
+    {2303, 0x40}, {2325, 0x02}, {2400, 0x02}, {2402, 0x10}, {2403, 0x40}, {2405, 0x04},
+    {2475, 0x02}, {2502, 0x10}, {2503, 0x40}, {2506, 0x80}, {2550, 0x02}, {2602, 0x10},
+    {2603, 0x40}, {2605, 0x04}, {2625, 0x02}, {2700, 0x02}, {2702, 0x10}, {2703, 0x40},
+    {2775, 0x02}, {2802, 0x10}, {2803, 0x40}, {2805, 0x04}, {2850, 0x02}, {2902, 0x10},
+    {2903, 0x40}, {2925, 0x02},
+};
+
+#endif
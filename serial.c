@@ -8,7 +8,6 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "driverlib/gpio.h"
@@ -18,6 +17,8 @@
 #include "driverlib/pin_map.h"
 #include "utils/ustdlib.h"
 
+#include "ring.h"
+#include "kernel.h"
 #include "serial.h"
 #include "yaw.h"
 #include "altitude.h"
@@ -32,8 +33,54 @@
 #define UART_BUFFER_SIZE 40
 #define BAUD_RATE 9600
 
-// Global pointer to Buffer
-static char *g_buffer;
+// 1 sends flight data as binary frames (see SendValues), 0 as a
+// tab separated text line
+#define TELEMETRY_BINARY 1
+
+// Binary frame: TELEMETRY_FRAME_ID, then the fields below little
+// endian, then a CRC-16/CCITT of everything before it. COBS encoding
+// removes every zero, so a zero byte ends each frame.
+#define TELEMETRY_FRAME_ID 1
+#define TELEMETRY_PAYLOAD_SIZE 22
+#define TELEMETRY_FRAME_SIZE (TELEMETRY_PAYLOAD_SIZE + 2)
+#define COBS_MAX_SIZE(n) ((n) + (n) / 254 + 1)
+
+// Frame flags
+#define TELEMETRY_FLAG_FLYING 0x01
+
+// Bytes waiting for the UART, drained into its FIFO by UartIntHandler.
+// At 9600 baud this is about half a second of output.
+#define UART_TX_RING_SIZE 512
+
+static uint8_t g_txStore[UART_TX_RING_SIZE];
+static Ring_t g_txRing;
+static volatile uint32_t g_txDropped;
+
+/*
+ * Moves bytes from the ring into the TX FIFO until either runs out.
+ * The UART interrupt is the ring's consumer, so from a task call this
+ * with it disabled.
+ */
+static void
+UartFillFifo(void)
+{
+    uint8_t c;
+
+    while (RingCount(&g_txRing) > 0 && UARTSpaceAvail(UART0_BASE)) {
+        RingRead(&g_txRing, &c);
+        UARTCharPutNonBlocking(UART0_BASE, c);
+    }
+}
+
+/*
+ * UART0 interrupt: the TX FIFO has drained to 2 bytes, top it up
+ */
+void
+UartIntHandler(void)
+{
+    UARTIntClear(UART0_BASE, UARTIntStatus(UART0_BASE, true));
+    UartFillFifo();
+}
 
 /*
  * Enables Uart0 and Rx Tx pins
@@ -41,8 +88,6 @@ static char *g_buffer;
 void
 InitUart(void)
 {
-    g_buffer = calloc(UART_BUFFER_SIZE, sizeof(char));
-
     SysCtlPeripheralEnable(SYSCTL_PERIPH_UART0);
     SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
 
@@ -52,27 +97,183 @@ InitUart(void)
 
     UARTConfigSetExpClk(UART0_BASE, SysCtlClockGet(), BAUD_RATE, (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE));
     UARTFIFOEnable(UART0_BASE);
+
+    RingInit(&g_txRing, g_txStore, UART_TX_RING_SIZE, sizeof(uint8_t));
+    UARTFIFOLevelSet(UART0_BASE, UART_FIFO_TX1_8, UART_FIFO_RX4_8);
+    UARTTxIntModeSet(UART0_BASE, UART_TXINT_MODE_FIFO);
+    UARTIntRegister(UART0_BASE, UartIntHandler);
+    UARTIntEnable(UART0_BASE, UART_INT_TX);
+
     UARTEnable(UART0_BASE);
 }
 
+/*
+ * Queues length bytes for transmission and returns at once. If they
+ * don't all fit, none are queued, so a line is never cut short.
+ * Returns the number of bytes dropped, 0 or length.
+ */
+uint32_t
+UartWrite(const void* data, uint32_t length)
+{
+    const uint8_t* bytes = data;
+    uint8_t* span;
+    uint32_t count;
+
+    if (RingSpace(&g_txRing) < length) {
+        g_txDropped += length;
+        return length;
+    }
+
+    while (length > 0) {
+        count = RingWriteSpan(&g_txRing, (void**)&span);
+        if (count > length) {
+            count = length;
+        }
+        memcpy(span, bytes, count);
+        RingCommit(&g_txRing, count);
+        bytes += count;
+        length -= count;
+    }
+
+    // Start the FIFO off: its interrupt only fires as it drains
+    UARTIntDisable(UART0_BASE, UART_INT_TX);
+    UartFillFifo();
+    UARTIntEnable(UART0_BASE, UART_INT_TX);
+    return 0;
+}
+
+/*
+ * Bytes UartWrite() has dropped for want of ring space
+ */
+uint32_t
+GetUartDropped(void)
+{
+    return g_txDropped;
+}
+
 /*
  * (Original Code by P.J. Bones)
- * Formats the string to send via UART and then sends it
+ * Queues a string to send via UART, see UartWrite()
  */
 void UartSend(const char *t_buffer)
 {
-    while (*t_buffer)
-    {
-        UARTCharPut(UART0_BASE, *t_buffer);
-        t_buffer++;
+    UartWrite(t_buffer, strlen(t_buffer));
+}
+
+#if TELEMETRY_BINARY
+/*
+ * Little endian field writers, returning the position after the field
+ */
+static uint8_t*
+Put16(uint8_t* out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+static uint8_t*
+Put32(uint8_t* out, uint32_t value)
+{
+    out = Put16(out, value & 0xFFFF);
+    return Put16(out, value >> 16);
+}
+
+/*
+ * CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF
+ */
+static uint16_t
+Crc16(const uint8_t* data, uint32_t length)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t bit;
+
+    while (length--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/*
+ * Consistent overhead byte stuffing: copies length bytes to out with
+ * no zeros left in them, COBS_MAX_SIZE(length) at most. Returns the
+ * encoded length.
+ */
+static uint32_t
+CobsEncode(const uint8_t* in, uint32_t length, uint8_t* out)
+{
+    uint32_t code_index = 0;
+    uint32_t out_index = 1;
+    uint8_t code = 1;
+
+    while (length--) {
+        if (*in == 0) {
+            out[code_index] = code;
+            code_index = out_index++;
+            code = 1;
+        } else {
+            out[out_index++] = *in;
+            if (++code == 0xFF) {
+                out[code_index] = code;
+                code_index = out_index++;
+                code = 1;
+            }
+        }
+        in++;
     }
+    out[code_index] = code;
+    return out_index;
+}
+
+/*
+ * Sends one binary flight data frame, decoded by
+ * tools/decode_telemetry.py:
+ *   id u8, sequence u16, kernel tick u32, altitude and its setpoint
+ *   (percent) i16 i16, yaw (tenths of a degree) and its setpoint
+ *   (degrees) i16 i16, main and tail duty (permille) u16 u16, yaw rate
+ *   (degrees/s) i16, flags u8, CRC u16
+ * 26 bytes on the wire against about 45 for the text line.
+ */
+static void
+SendTelemetryFrame(void)
+{
+    static uint16_t sequence;
+    uint8_t frame[TELEMETRY_FRAME_SIZE];
+    uint8_t encoded[COBS_MAX_SIZE(TELEMETRY_FRAME_SIZE) + 1];
+    uint8_t* p = frame;
+    uint32_t length;
+
+    *p++ = TELEMETRY_FRAME_ID;
+    p = Put16(p, sequence++);
+    p = Put32(p, GetTickCount());
+    p = Put16(p, GetAltPercent());
+    p = Put16(p, GetAltitudeSetpoint());
+    p = Put16(p, GetYaw());
+    p = Put16(p, GetYawSetpoint());
+    p = Put16(p, GetMotorDuty(MOTOR_MAIN));
+    p = Put16(p, GetMotorDuty(MOTOR_TAIL));
+    p = Put16(p, GetYawRate());
+    *p++ = SwitchUp() ? TELEMETRY_FLAG_FLYING : 0;
+    Put16(p, Crc16(frame, TELEMETRY_PAYLOAD_SIZE));
+
+    length = CobsEncode(frame, TELEMETRY_FRAME_SIZE, encoded);
+    encoded[length++] = 0;
+    UartWrite(encoded, length);
 }
 
+#else
+// Text line being formatted
+static char g_buffer[UART_BUFFER_SIZE];
+
 /*
  * Gets values and adds them to string g_buffer
  * Calls uart_send to send string
  */
-void SendValues(void)
+static void
+SendTextLine(void)
 {
     int32_t altitude = GetAltPercent();
     int32_t altitude_setpoint = GetAltitudeSetpoint();
@@ -82,7 +283,7 @@ void SendValues(void)
     uint8_t tail_duty = GetTailDuty();
     int flight_mode = SwitchUp();
 
-    usprintf(g_buffer,
+    usnprintf(g_buffer, UART_BUFFER_SIZE,
             "a%d\tA%d\ty%d\tY%d\tMD%d\tTD%d\tOM%d\r\n", 
             altitude, 
             altitude_setpoint, 
@@ -94,3 +295,17 @@ void SendValues(void)
 
     UartSend(g_buffer);
 }
+
+#endif
+
+/*
+ * Sends the flight data, in the format TELEMETRY_BINARY picks
+ */
+void SendValues(void)
+{
+#if TELEMETRY_BINARY
+    SendTelemetryFrame();
+#else
+    SendTextLine();
+#endif
+}
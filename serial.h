@@ -13,6 +13,15 @@
 void
 InitUart(void);
 
+void
+UartIntHandler(void);
+
+uint32_t
+UartWrite(const void* data, uint32_t length);
+
+uint32_t
+GetUartDropped(void);
+
 void
 UartSend(const char *t_buffer);
 
@@ -10,6 +10,18 @@
 
 #include <stdbool.h>
 
+// Defines for Switch 1 
+#define SW1_PERIPH       SYSCTL_PERIPH_GPIOA
+#define SW1_PORT_BASE    GPIO_PORTA_BASE
+#define SW1_PIN          GPIO_PIN_7
+#define SW1_NORMAL       false
+
+// Virtual Reset switch (Switch 2)
+#define RESET_PERIPH     SYSCTL_PERIPH_GPIOA
+#define RESET_PORT_BASE  GPIO_PORTA_BASE
+#define RESET_PIN        GPIO_PIN_6
+#define RESET_NORMAL     false
+
 void
 InitSwitch(void);
 
@@ -0,0 +1,102 @@
+#ifndef TASKS_H
+#define TASKS_H
+
+/**
+ * @filename: tasks.h
+ * @authors: Mark Day, Noah Walle
+ * @date: 16.05.2024
+ * @purpose: The task set, declared once. Expanded in main.c into the
+ * const task table and read by tools/gen_schedule.py to build the
+ * cyclic executive schedule in schedule.h. Rerun the script after
+ * changing this file.
+**/
+
+#define KERNEL_RATE_HZ 2000
+#define OFF 0
+#define ON 1
+
+/*
+ * Priorities, ticks and worst case execution budgets (us) for each task.
+ *
+ * You can calculate the equivalent frequency of a given task by:
+ * TASK_FREQUENCY = KERNEL_RATE_HZ / TASK_TICKS
+ *
+ * Background tasks run rate monotonic, priorities only break ties
+ * between equal periods, and AssignPhases() spreads the phases of
+ * both tiers at start up. Foreground budgets must fit in one tick
+ * together.
+ * A budget of 0 leaves a task out of the admission test: the display
+ * blocks for milliseconds on the OLED and has no useful bound yet. The
+ * UART task only formats and queues, the UART interrupt sends.
+ */
+#define ADC_PRIORITY 0
+#define ADC_TICKS 10
+#define ADC_WCET_US 10
+
+#define SETPOINT_PRIORITY 1
+#define SETPOINT_TICKS 75
+#define SETPOINT_WCET_US 50
+
+#define SWITCH_PRIORITY 6
+#define SWITCH_TICKS 200
+#define SWITCH_WCET_US 100
+
+// The controller runs at 500 Hz on the timer and takes its dt from the
+// kernel, so the yaw loop acts on encoder edges promptly and the
+// altitude loop on each 200 Hz sample within 2 ms. Set
+// CONTROL_ACTIVATION to ACTIVATE_EVENT to run it on every
+// CONTROL_SAMPLES new altitude samples instead, with CONTROL_TICKS set
+// to ADC_TICKS * CONTROL_SAMPLES.
+#define CONTROL_PRIORITY 3
+#define CONTROL_SAMPLES 4
+#define CONTROL_TICKS 4
+#define CONTROL_WCET_US 100
+#define CONTROL_ACTIVATION ACTIVATE_PERIODIC
+
+#define DISPLAY_PRIORITY 4
+#define DISPLAY_TICKS 100
+#define DISPLAY_WCET_US 0
+
+#define GND_PRIORITY 2
+#define GND_TICKS 3000
+#define GND_WCET_US 50
+
+// 20 Hz of 26 byte telemetry frames is about half the 9600 baud link
+#define UART_PRIORITY 5
+#define UART_TICKS 100
+#define UART_WCET_US 500
+
+#define RESET_PRIORITY 7
+#define RESET_TICKS 500
+#define RESET_WCET_US 10
+
+/*
+ * TASK(function, ticks, priority, initial state, budget, overrun policy,
+ *      tier, activation)
+ * The position in this list is the task's id (and its bit in schedule.h)
+ *
+ * Sampling and control keep their grid and skip missed releases, the
+ * button poll catches up so debouncing counts every poll, and the
+ * display and UART drop a run rather than run late.
+ *
+ * The ADC trigger and the controller run in the foreground tier, from
+ * the tick interrupt, so a slow display or UART update can't delay
+ * them. They only share single words with the background tasks; use a
+ * Mailbox_t for anything larger. The ADC task only starts conversions,
+ * and main() switches it off when ALT_SOURCE is paced by hardware.
+ */
+#define TASK_TABLE(TASK) \
+    TASK(ADCTask,         ADC_TICKS,      ADC_PRIORITY,      ON,  ADC_WCET_US,      OVERRUN_REALIGN,  TIER_FOREGROUND, ACTIVATE_PERIODIC) \
+    TASK(SetPointTask,    SETPOINT_TICKS, SETPOINT_PRIORITY, OFF, SETPOINT_WCET_US, OVERRUN_CATCH_UP, TIER_BACKGROUND, ACTIVATE_PERIODIC) \
+    TASK(SwitchLogicTask, SWITCH_TICKS,   SWITCH_PRIORITY,   OFF, SWITCH_WCET_US,   OVERRUN_REALIGN,  TIER_BACKGROUND, ACTIVATE_PERIODIC) \
+    TASK(ControlTask,     CONTROL_TICKS,  CONTROL_PRIORITY,  OFF, CONTROL_WCET_US,  OVERRUN_REALIGN,  TIER_FOREGROUND, CONTROL_ACTIVATION) \
+    TASK(DisplayTask,     DISPLAY_TICKS,  DISPLAY_PRIORITY,  ON,  DISPLAY_WCET_US,  OVERRUN_DROP,     TIER_BACKGROUND, ACTIVATE_PERIODIC) \
+    TASK(GroundRefTask,   GND_TICKS,      GND_PRIORITY,      ON,  GND_WCET_US,      OVERRUN_REALIGN,  TIER_BACKGROUND, ACTIVATE_PERIODIC) \
+    TASK(UARTTask,        UART_TICKS,     UART_PRIORITY,     ON,  UART_WCET_US,     OVERRUN_DROP,     TIER_BACKGROUND, ACTIVATE_PERIODIC) \
+    TASK(ResetTask,       RESET_TICKS,    RESET_PRIORITY,    ON,  RESET_WCET_US,    OVERRUN_DROP,     TIER_BACKGROUND, ACTIVATE_PERIODIC)
+
+// Task ids, e.g. ControlTask_ID
+#define TASK_ID(function, ticks, priority, state, wcet, overrun, tier, activation) function##_ID,
+enum taskIds {TASK_TABLE(TASK_ID) NUM_TASKS};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+/**
+ * @filename: check.h
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Checks and wall clock timing for the host tests. Each test
+ * program returns CheckDone(), non zero if any check failed. Modules
+ * keep their state in statics, so tests that need a fresh module run
+ * in a child process with CheckIsolated().
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static uint32_t g_checks;
+static uint32_t g_checkFailures;
+
+#define CHECK(cond) \
+    CheckTrue((cond), #cond, __FILE__, __LINE__)
+
+#define CHECK_EQ(actual, expected) \
+    CheckEqual((int64_t)(actual), (int64_t)(expected), #actual, __FILE__, __LINE__)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    CheckNear((double)(actual), (double)(expected), (double)(tolerance), #actual, __FILE__, __LINE__)
+
+static inline void
+CheckTrue(bool ok, const char* what, const char* file, int line)
+{
+    g_checks++;
+    if (!ok) {
+        g_checkFailures++;
+        printf("%s:%d: FAIL %s\n", file, line, what);
+    }
+}
+
+static inline void
+CheckEqual(int64_t actual, int64_t expected, const char* what, const char* file, int line)
+{
+    g_checks++;
+    if (actual != expected) {
+        g_checkFailures++;
+        printf("%s:%d: FAIL %s is %lld, expected %lld\n", file, line, what,
+               (long long)actual, (long long)expected);
+    }
+}
+
+static inline void
+CheckNear(double actual, double expected, double tolerance, const char* what, const char* file, int line)
+{
+    g_checks++;
+    if (!(actual >= expected - tolerance && actual <= expected + tolerance)) {
+        g_checkFailures++;
+        printf("%s:%d: FAIL %s is %g, expected %g +- %g\n", file, line, what,
+               actual, expected, tolerance);
+    }
+}
+
+/*
+ * Monotonic wall clock in nanoseconds, for the benchmarks
+ */
+static inline uint64_t
+BenchNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/*
+ * Runs test in a child process, adding its checks to this one's
+ */
+static inline void
+CheckIsolated(void (*test)(void))
+{
+    uint32_t counts[2] = {0, 0};
+    int status = 0;
+    int fds[2];
+    pid_t pid;
+
+    fflush(stdout);
+    if (pipe(fds) != 0 || (pid = fork()) < 0) {
+        perror("CheckIsolated");
+        g_checkFailures++;
+        return;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        g_checks = 0;
+        g_checkFailures = 0;
+        test();
+        fflush(stdout);
+        counts[0] = g_checks;
+        counts[1] = g_checkFailures;
+        _exit(write(fds[1], counts, sizeof(counts)) == sizeof(counts) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    if (read(fds[0], counts, sizeof(counts)) != sizeof(counts)) {
+        counts[1]++;
+    }
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("FAIL test process ended with status %d\n", status);
+        counts[1]++;
+    }
+    g_checks += counts[0];
+    g_checkFailures += counts[1];
+}
+
+static inline int
+CheckDone(const char* name)
+{
+    printf("%s: %u checks, %u failed\n", name, g_checks, g_checkFailures);
+    return g_checkFailures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,244 @@
+/**
+ * @filename: rig.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: The simulated rig of rig.h, and main.c's tasks for it
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "host.h"
+#include "altitude.h"
+#include "buttons4.h"
+#include "kernel.h"
+#include "motors.h"
+#include "serial.h"
+#include "switch.h"
+#include "tasks.h"
+#include "yaw.h"
+#include "rig.h"
+
+Rig_t g_rig;
+
+static uint8_t g_phase;
+
+// Channel levels forward, B the high bit
+static const uint8_t g_phases[4] = {0x0, 0x1, 0x3, 0x2};
+
+static TaskHandle_t g_controlTask;
+static TaskHandle_t g_setPointTask;
+static TaskHandle_t g_switchLogicTask;
+static TaskHandle_t g_groundRefTask;
+
+/*
+ * main.c's tasks. The ADC task also plays the sequencer, which on the
+ * stand-in converts at once and raises no interrupt of its own.
+ */
+static void
+RigADCTask(void)
+{
+    HostAdcSet(RIG_GROUND_ADC - (uint32_t)lround(g_rig.Height * SCALE_FACTOR_HELI / 100));
+    ADCProcessTrigger();
+    ADCIntHandler();
+}
+
+static void
+RigControlTask(void)
+{
+    uint32_t dt_us = GetTaskElapsedUs(g_controlTask);
+
+    GetAltPercent();
+    GetYawAngle();
+
+    int32_t altitude_effort = AltController(dt_us);
+    int32_t yaw_effort = YawController(dt_us, altitude_effort);
+    SetMotorDutiesSampled(altitude_effort, yaw_effort, GetAltSampleCycles(), GetYawSampleCycles());
+}
+
+static void
+RigSetPointTask(void)
+{
+    updateButtons();
+    CheckAltitudeSetButton();
+    CheckYawSetButton();
+}
+
+static void
+RigSwitchLogicTask(void)
+{
+    if(SwitchUp() && Hover() && Stable()) {
+        TaskEnable(g_controlTask);
+        TaskEnable(g_setPointTask);
+
+    } else if (!SwitchUp() && !AltitudeLand() && !YawLand()) {
+        TaskEnable(g_controlTask);
+        TaskDisable(g_setPointTask);
+
+    } else if (!SwitchUp() && AltitudeLand() && YawLand()) {
+        TaskDisable(g_controlTask);
+        TaskDisable(g_setPointTask);
+    } else {
+        TaskDisable(g_controlTask);
+    }
+}
+
+static void
+RigGroundRefTask(void)
+{
+    SetAltitudeRef();
+    TaskDisable(g_groundRefTask);
+    TaskEnable(g_switchLogicTask);
+}
+
+// No display on the host
+static void
+RigDisplayTask(void)
+{
+}
+
+static void
+RigUARTTask(void)
+{
+    SendValues();
+}
+
+// The rig never throws the reset switch
+static void
+RigResetTask(void)
+{
+}
+
+#define TASK_CONFIG(function, ticks, priority, state, wcet, overrun, tier, activation) \
+    {Rig##function, ticks, priority, state, wcet, overrun, tier, activation},
+static const TaskConfig_t g_rigTaskTable[NUM_TASKS] = {
+    TASK_TABLE(TASK_CONFIG)
+};
+
+/*
+ * Sets up the firmware as MainInit() and main() do, with the single
+ * conversion ADC source, and the heli on the ground. The controller
+ * runs every controlTicks, 0 for tasks.h's CONTROL_TICKS. Tickless
+ * idle stays off: the rig steps every tick.
+ */
+void
+RigStart(uint16_t controlTicks)
+{
+    TaskConfig_t table[NUM_TASKS];
+
+    memset(&g_rig, 0, sizeof(g_rig));
+    g_phase = 0;
+    RigInputs(false, false, false);
+
+    InitKernel(KERNEL_RATE_HZ);
+    InitMotors();
+    InitADC(&g_adcSingleSource);
+    SetAltFilter(FILTER_IIR2, 2, 3);
+    initButtons();
+    InitSwitch();
+    InitUart();
+    InitQuad(&g_yawGpioSource);
+    IntMasterEnable();
+
+    memcpy(table, g_rigTaskTable, sizeof(table));
+    if (controlTicks != 0) {
+        table[ControlTask_ID].NumTicks = controlTicks;
+    }
+    SetSchedPolicy(SCHED_RATE_MONOTONIC);
+    AddTaskTable(table, NUM_TASKS);
+    AssignPhases();
+
+    g_controlTask = GetTask(ControlTask_ID);
+    g_setPointTask = GetTask(SetPointTask_ID);
+    g_switchLogicTask = GetTask(SwitchLogicTask_ID);
+    g_groundRefTask = GetTask(GroundRefTask_ID);
+
+    // Found the yaw reference
+    HostGpioSet(GPIO_PORTC_BASE, REF_CHANNEL);
+}
+
+/*
+ * The flight mode switch and the UP and DOWN buttons, LEFT and RIGHT
+ * released
+ */
+void
+RigInputs(bool switchUp, bool up, bool down)
+{
+    HostGpioSet(UP_BUT_PORT_BASE, up ? UP_BUT_PIN : 0);
+    HostGpioSet(DOWN_BUT_PORT_BASE, down ? DOWN_BUT_PIN : 0);
+    HostGpioSet(LEFT_BUT_PORT_BASE, LEFT_BUT_PIN | RIGHT_BUT_PIN);
+    HostGpioSet(SW1_PORT_BASE, switchUp ? SW1_PIN : 0);
+}
+
+/*
+ * One tick of the rig under the duties the firmware last set
+ */
+static void
+RigStep(double dt)
+{
+    double main = GetMotorDuty(MOTOR_MAIN);
+    double tail = GetMotorDuty(MOTOR_TAIL);
+    double accel;
+
+    g_rig.MainSpeed += (main - g_rig.MainSpeed) * dt / RIG_MAIN_TAU;
+    g_rig.TailThrust += (tail - g_rig.TailThrust) * dt / RIG_TAIL_TAU;
+
+    accel = RIG_CLIMB_ACCEL * (g_rig.MainSpeed - RIG_HOVER_MAIN - RIG_HOVER_SLOPE * g_rig.Height) -
+            RIG_CLIMB_DAMP * g_rig.Climb - g_rig.Load;
+    g_rig.Climb += accel * dt;
+    g_rig.Height += g_rig.Climb * dt;
+    if (g_rig.Height <= 0) {
+        g_rig.Height = 0;
+        g_rig.Climb = fmax(g_rig.Climb, 0);
+    }
+
+    // Sitting on the ground, the rig holds the heli's yaw
+    if (g_rig.Height > 0) {
+        accel = -RIG_YAW_ACCEL * (g_rig.TailThrust - RIG_TAIL_BIAS - RIG_TAIL_GAIN * g_rig.MainSpeed) -
+                RIG_YAW_DAMP * g_rig.YawRate + g_rig.YawGust;
+        g_rig.YawRate += accel * dt;
+        g_rig.Yaw += g_rig.YawRate * dt;
+    }
+}
+
+/*
+ * Quadrature edges for the counts the yaw has moved through, each
+ * taken by QuadHandler as it comes
+ */
+static void
+RigEncoder(void)
+{
+    int32_t count = (int32_t)floor(g_rig.Yaw * STEP_MAX / 360.0);
+
+    while (g_rig.Count != count) {
+        int32_t direction = (count > g_rig.Count) ? 1 : -1;
+
+        g_rig.Count += direction;
+        g_phase = (g_phase + direction) & 3;
+        HostGpioSet(GPIO_PORTB_BASE, g_phases[g_phase]);
+    }
+}
+
+/*
+ * A kernel tick: the tick interrupt with the foreground tasks, the
+ * background loop, then the rig moving on a tick under the duties
+ */
+void
+RigTick(void)
+{
+    HostAdvance(RIG_TICK_CYCLES);
+    RunKernel();
+    RigStep(1.0 / KERNEL_RATE_HZ);
+    RigEncoder();
+}
+
+/*
+ * The switch logic has handed the heli to the controller
+ */
+bool
+RigFlying(void)
+{
+    return g_controlTask->RunTask;
+}
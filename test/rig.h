@@ -0,0 +1,69 @@
+#ifndef RIG_H
+#define RIG_H
+
+/**
+ * @filename: rig.h
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: The heli on its rig, simulated for the closed loop host
+ * tests. It is flown by the firmware's own modules under the kernel,
+ * with main.c's task set expanded from tasks.h: the ground reference,
+ * the switch logic taking off through Hover() and Stable(), the
+ * setpoint buttons, the controller and the telemetry.
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Ticks of the rig, one a kernel tick
+#define RIG_TICK_CYCLES (HOST_CLOCK_HZ / KERNEL_RATE_HZ)
+
+// ADC reading with the heli on the ground
+#define RIG_GROUND_ADC 2600
+
+// The rig. Main rotor speed and tail thrust follow their duties with
+// a lag. Height needs more main duty the higher it goes (the rig's
+// cable and counterweight). The main rotor's reaction torque is
+// balanced by the tail at RIG_TAIL_BIAS + RIG_TAIL_GAIN * main duty;
+// any tail duty beyond that accelerates the heli towards lower yaw.
+#define RIG_MAIN_TAU 0.3
+#define RIG_TAIL_TAU 0.1
+#define RIG_HOVER_MAIN 330.0
+#define RIG_HOVER_SLOPE 2.2
+#define RIG_CLIMB_ACCEL 0.1
+#define RIG_CLIMB_DAMP 3.0
+#define RIG_TAIL_BIAS 120.0
+#define RIG_TAIL_GAIN 0.65
+#define RIG_YAW_ACCEL 1.0
+#define RIG_YAW_DAMP 2.5
+
+typedef struct {
+    double Height;      // percent
+    double Climb;       // percent/s
+    double Yaw;         // degrees
+    double YawRate;     // degrees/s
+    double MainSpeed;   // main rotor speed as the duty it settles at
+    double TailThrust;  // likewise the tail
+    int32_t Count;      // encoder count given to the decoder
+
+    // Disturbances, added to the accelerations while set: a gust on
+    // the tail in degrees/s^2 and a load on the rig in percent/s^2
+    double YawGust;
+    double Load;
+} Rig_t;
+
+extern Rig_t g_rig;
+
+void
+RigStart(uint16_t controlTicks);
+
+void
+RigInputs(bool switchUp, bool up, bool down);
+
+void
+RigTick(void);
+
+bool
+RigFlying(void);
+
+#endif
@@ -0,0 +1,889 @@
+/**
+ * @filename: host.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Linux stand-in for the TivaWare calls, see host.h
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+
+#define HOST_REGISTERS 64
+#define DWT_CYCCNT_ADDRESS 0xE0001004
+
+#define UART_FIFO_SIZE 16
+#define UART_TX_TRIGGER 2
+#define UART_BITS_PER_CHAR 10
+
+// Register table
+static uint32_t g_regAddress[HOST_REGISTERS];
+static volatile uint32_t g_regValue[HOST_REGISTERS];
+static uint32_t g_numRegs;
+
+// Interrupts
+static void (*g_handlers[HOST_NUM_IRQS])(void);
+static uint32_t g_pending;
+static uint32_t g_raised;
+static bool g_masked;
+static bool g_active;
+static uint32_t g_handlerCycles[HOST_NUM_IRQS];
+
+uint32_t g_hostWfiCount;
+uint64_t g_hostWfiCycles;
+uint32_t g_hostSysTicks;
+
+// SysTick: while enabled the counter reaches 0 at g_stZero, and the
+// COUNT flag is set until NVIC_ST_CTRL is next read
+static uint32_t g_stZero;
+static bool g_stCounted;
+
+// External wake up
+static bool g_wakeArmed;
+static uint32_t g_wakeAt;
+
+// GPIO and QEI, with a stream of levels played into one port
+static uint8_t g_gpio[6];
+static uint8_t g_gpioIntMask[6];
+static uint32_t g_playPort;
+static const uint8_t* g_playLevels;
+static uint32_t g_playCount;
+static uint32_t g_playPeriod;
+static uint32_t g_playAt;
+static uint32_t g_qeiPosition;
+static uint32_t g_qeiVelocity;
+static int32_t g_qeiDirection = 1;
+static uint32_t g_qeiIntEnabled;
+
+// PWM, main and tail outputs, and their generators' periods and the
+// cycle each started counting. g_pwmNextZero is the main rotor's next
+// counter zero, where it triggers the ADC.
+static HostPwm_t g_pwm[2];
+static uint32_t g_pwmPeriodWrites;
+static uint32_t g_pwmPeriod[2];
+static uint32_t g_pwmStart[2];
+static bool g_pwmRunning[2];
+static bool g_pwmAdcTrigger;
+static uint32_t g_pwmNextZero;
+
+// UART
+static uint8_t g_uartFifo[UART_FIFO_SIZE];
+static uint32_t g_uartHead;
+static uint32_t g_uartLevel;
+static uint32_t g_uartCharCycles;
+static uint32_t g_uartCharDone;
+static bool g_uartEnabled;
+static uint32_t g_uartRaw;
+static uint32_t g_uartMask;
+uint8_t g_hostUartWire[HOST_UART_CAPTURE];
+uint32_t g_hostUartWireCount;
+
+// ADC and uDMA. With a signal, a sequence 3 conversion is busy until
+// g_adcDone.
+static uint32_t g_adcValue;
+static uint32_t (*g_adcSignal)(uint32_t cycles);
+static uint32_t g_adcTrigger;
+static uint32_t g_adcOversample = 1;
+static bool g_adcBusy;
+static uint32_t g_adcDone;
+uint32_t g_hostAdcStarts[HOST_ADC_CAPTURE];
+uint32_t g_hostAdcConversions;
+static uint16_t* g_dmaDest[2];
+static uint32_t g_dmaCount[2];
+static uint32_t g_dmaMode[2];
+static uint32_t g_dmaArms[2];
+
+static volatile uint32_t*
+RawRegister(uint32_t address)
+{
+    uint32_t i;
+
+    for (i = 0; i < g_numRegs; i++) {
+        if (g_regAddress[i] == address) {
+            return &g_regValue[i];
+        }
+    }
+    if (g_numRegs == HOST_REGISTERS) {
+        fprintf(stderr, "host: register table full at 0x%08x\n", address);
+        abort();
+    }
+    g_regAddress[g_numRegs] = address;
+    g_regValue[g_numRegs] = 0;
+    return &g_regValue[g_numRegs++];
+}
+
+volatile uint32_t*
+HostRegister(uint32_t address)
+{
+    volatile uint32_t* reg = RawRegister(address);
+
+    if (address == NVIC_ST_CTRL) {
+        *reg = (*reg & ~NVIC_ST_CTRL_COUNT) | (g_stCounted ? NVIC_ST_CTRL_COUNT : 0);
+        g_stCounted = false;
+    } else if (address == NVIC_INT_CTRL) {
+        bool pending = (g_pending & (1u << HOST_IRQ_SYSTICK)) != 0;
+        *reg = (*reg & ~NVIC_INT_CTRL_PEND_SYST) | (pending ? NVIC_INT_CTRL_PEND_SYST : 0);
+    }
+    return reg;
+}
+
+uint32_t
+HostCycles(void)
+{
+    return *RawRegister(DWT_CYCCNT_ADDRESS);
+}
+
+/*
+ * Runs pending handlers unless masked or already in one; the stand-in
+ * has one priority level, so handlers don't nest
+ */
+static void
+HostDeliver(void)
+{
+    while (g_pending && !g_masked && !g_active) {
+        uint32_t irq = __builtin_ctz(g_pending);
+
+        g_pending &= ~(1u << irq);
+        if (irq == HOST_IRQ_SYSTICK) {
+            g_hostSysTicks++;
+        }
+        g_active = true;
+        HostAdvance(HOST_IRQ_ENTRY_CYCLES);
+        if (g_handlers[irq]) {
+            g_handlers[irq]();
+        }
+        HostAdvance(g_handlerCycles[irq]);
+        g_active = false;
+    }
+}
+
+void
+HostRaise(HostIrq_t irq)
+{
+    g_pending |= 1u << irq;
+    g_raised++;
+    HostDeliver();
+}
+
+bool
+HostMasked(void)
+{
+    return g_masked;
+}
+
+void
+HostHandlerCycles(HostIrq_t irq, uint32_t cycles)
+{
+    g_handlerCycles[irq] = cycles;
+}
+
+static bool
+SysTickRunning(void)
+{
+    return (*RawRegister(NVIC_ST_CTRL) & NVIC_ST_CTRL_ENABLE) != 0;
+}
+
+/*
+ * Cycles from now to t, for events no further than 2^31 cycles out
+ */
+static uint32_t
+Until(uint32_t t)
+{
+    return t - HostCycles();
+}
+
+static bool
+PwmAdcTriggering(void)
+{
+    return g_adcSignal && g_adcTrigger == ADC_TRIGGER_PWM3 && g_pwmAdcTrigger && g_pwmRunning[0] &&
+           g_pwmPeriod[0] > 0;
+}
+
+/*
+ * Starts a sequence 3 conversion of the signal, unless one is under way
+ */
+static void
+AdcStart(void)
+{
+    uint32_t start = HostCycles();
+    uint32_t sum = 0;
+    uint32_t i;
+
+    if (g_adcBusy) {
+        return;
+    }
+    for (i = 0; i < g_adcOversample; i++) {
+        sum += g_adcSignal(start + i * HOST_ADC_CONVERSION_CYCLES);
+    }
+    g_adcValue = (sum + g_adcOversample / 2) / g_adcOversample;
+    g_adcBusy = true;
+    g_adcDone = start + g_adcOversample * HOST_ADC_CONVERSION_CYCLES;
+    if (g_hostAdcConversions < HOST_ADC_CAPTURE) {
+        g_hostAdcStarts[g_hostAdcConversions] = start;
+    }
+    g_hostAdcConversions++;
+}
+
+/*
+ * Handles whatever falls due at the current cycle count
+ */
+static void
+HostEvents(void)
+{
+    if (SysTickRunning() && Until(g_stZero) == 0) {
+        g_stZero += HWREG(NVIC_ST_RELOAD) + 1;
+        g_stCounted = true;
+        if (*RawRegister(NVIC_ST_CTRL) & NVIC_ST_CTRL_INTEN) {
+            HostRaise(HOST_IRQ_SYSTICK);
+        }
+    }
+
+    if (g_uartEnabled && g_uartLevel > 0 && Until(g_uartCharDone) == 0) {
+        if (g_hostUartWireCount < HOST_UART_CAPTURE) {
+            g_hostUartWire[g_hostUartWireCount++] = g_uartFifo[g_uartHead];
+        }
+        g_uartHead = (g_uartHead + 1) % UART_FIFO_SIZE;
+        g_uartLevel--;
+        if (g_uartLevel > 0) {
+            g_uartCharDone += g_uartCharCycles;
+        }
+        if (g_uartLevel == UART_TX_TRIGGER) {
+            g_uartRaw |= UART_INT_TX;
+            if (g_uartMask & UART_INT_TX) {
+                HostRaise(HOST_IRQ_UART);
+            }
+        }
+    }
+
+    if (g_playCount > 0 && Until(g_playAt) == 0) {
+        g_playCount--;
+        g_playAt += g_playPeriod;
+        HostGpioSet(g_playPort, *g_playLevels++);
+    }
+
+    if (g_wakeArmed && Until(g_wakeAt) == 0) {
+        g_wakeArmed = false;
+        HostRaise(HOST_IRQ_WAKE);
+    }
+
+    if (PwmAdcTriggering() && Until(g_pwmNextZero) == 0) {
+        g_pwmNextZero += g_pwmPeriod[0];
+        AdcStart();
+    }
+
+    if (g_adcBusy && Until(g_adcDone) == 0) {
+        g_adcBusy = false;
+        HostRaise(HOST_IRQ_ADC);
+    }
+}
+
+/*
+ * Cycles to the next event, limit if none is nearer
+ */
+static uint32_t
+NextEvent(uint32_t limit)
+{
+    uint32_t next = limit;
+
+    if (SysTickRunning() && Until(g_stZero) < next) {
+        next = Until(g_stZero);
+    }
+    if (g_uartEnabled && g_uartLevel > 0 && Until(g_uartCharDone) < next) {
+        next = Until(g_uartCharDone);
+    }
+    if (g_playCount > 0 && Until(g_playAt) < next) {
+        next = Until(g_playAt);
+    }
+    if (g_wakeArmed && Until(g_wakeAt) < next) {
+        next = Until(g_wakeAt);
+    }
+    if (PwmAdcTriggering() && Until(g_pwmNextZero) < next) {
+        next = Until(g_pwmNextZero);
+    }
+    if (g_adcBusy && Until(g_adcDone) < next) {
+        next = Until(g_adcDone);
+    }
+    return next;
+}
+
+/*
+ * Lets cycles pass, taking the events on the way in time order.
+ * Handlers may themselves advance time.
+ */
+void
+HostAdvance(uint32_t cycles)
+{
+    uint32_t end = HostCycles() + cycles;
+
+    while ((int32_t)(end - HostCycles()) > 0) {
+        uint32_t step = NextEvent(end - HostCycles());
+
+        *RawRegister(DWT_CYCCNT_ADDRESS) += step;
+        HostEvents();
+    }
+}
+
+/*
+ * Raises HOST_IRQ_WAKE, running handler, cycles from now, as any other
+ * interrupt would: it ends a CPUwfi()
+ */
+void
+HostWakeAfter(uint32_t cycles, void (*handler)(void))
+{
+    g_handlers[HOST_IRQ_WAKE] = handler;
+    g_wakeAt = HostCycles() + (cycles ? cycles : 1);
+    g_wakeArmed = true;
+}
+
+// ---------------------------------------------------------------------
+void
+SysCtlClockSet(uint32_t config)
+{
+    (void)config;
+}
+
+uint32_t
+SysCtlClockGet(void)
+{
+    return HOST_CLOCK_HZ;
+}
+
+void
+SysCtlPeripheralEnable(uint32_t peripheral)
+{
+    (void)peripheral;
+}
+
+void
+SysCtlReset(void)
+{
+    fprintf(stderr, "host: SysCtlReset\n");
+    exit(1);
+}
+
+// ---------------------------------------------------------------------
+bool
+IntMasterDisable(void)
+{
+    bool was = g_masked;
+
+    g_masked = true;
+    return was;
+}
+
+bool
+IntMasterEnable(void)
+{
+    bool was = g_masked;
+
+    g_masked = false;
+    HostDeliver();
+    return was;
+}
+
+void
+IntPendSet(uint32_t interrupt)
+{
+    if (interrupt == FAULT_PENDSV) {
+        HostRaise(HOST_IRQ_PENDSV);
+    }
+}
+
+void
+IntPrioritySet(uint32_t interrupt, uint8_t priority)
+{
+    (void)interrupt;
+    (void)priority;
+}
+
+void
+IntRegister(uint32_t interrupt, void (*handler)(void))
+{
+    if (interrupt == FAULT_PENDSV) {
+        g_handlers[HOST_IRQ_PENDSV] = handler;
+    } else if (interrupt == FAULT_SYSTICK) {
+        g_handlers[HOST_IRQ_SYSTICK] = handler;
+    }
+}
+
+/*
+ * Sleeps until an interrupt is raised, taken or left pending by the
+ * mask as on the core. One already pending doesn't let it sleep.
+ */
+void
+CPUwfi(void)
+{
+    uint32_t raised = g_raised;
+    uint32_t start = HostCycles();
+
+    g_hostWfiCount++;
+    while (g_raised == raised && !g_pending) {
+        uint32_t step = NextEvent(UINT32_MAX);
+
+        if (step == UINT32_MAX) {
+            fprintf(stderr, "host: CPUwfi with nothing to wake it\n");
+            abort();
+        }
+        *RawRegister(DWT_CYCCNT_ADDRESS) += step;
+        HostEvents();
+    }
+    g_hostWfiCycles += HostCycles() - start;
+}
+
+// ---------------------------------------------------------------------
+// SysTick counts RELOAD down to 0 and reloads, RELOAD + 1 cycles a
+// period, interrupting as it reaches 0. CURRENT holds the count while stopped and the firmware
+// writes it 0 before enabling, which starts a fresh period. Enabling
+// and disabling read NVIC_ST_CTRL, clearing COUNT as TivaWare's do.
+void
+SysTickPeriodSet(uint32_t period)
+{
+    HWREG(NVIC_ST_RELOAD) = period - 1;
+}
+
+uint32_t
+SysTickValueGet(void)
+{
+    if (!SysTickRunning()) {
+        return HWREG(NVIC_ST_CURRENT);
+    }
+    return Until(g_stZero) % (HWREG(NVIC_ST_RELOAD) + 1);
+}
+
+void
+SysTickEnable(void)
+{
+    uint32_t current = HWREG(NVIC_ST_CURRENT);
+
+    if (HWREG(NVIC_ST_CTRL) & NVIC_ST_CTRL_ENABLE) {
+        return;
+    }
+    if (current == 0) {
+        current = HWREG(NVIC_ST_RELOAD) + 1;
+    }
+    g_stZero = HostCycles() + current;
+    *RawRegister(NVIC_ST_CTRL) |= NVIC_ST_CTRL_ENABLE;
+}
+
+void
+SysTickDisable(void)
+{
+    if (HWREG(NVIC_ST_CTRL) & NVIC_ST_CTRL_ENABLE) {
+        HWREG(NVIC_ST_CURRENT) = SysTickValueGet();
+    }
+    *RawRegister(NVIC_ST_CTRL) &= ~NVIC_ST_CTRL_ENABLE;
+}
+
+void
+SysTickIntEnable(void)
+{
+    *RawRegister(NVIC_ST_CTRL) |= NVIC_ST_CTRL_INTEN;
+}
+
+void
+SysTickIntRegister(void (*handler)(void))
+{
+    g_handlers[HOST_IRQ_SYSTICK] = handler;
+}
+
+// ---------------------------------------------------------------------
+static uint32_t
+PortIndex(uint32_t port)
+{
+    switch (port) {
+    case GPIO_PORTA_BASE: return 0;
+    case GPIO_PORTB_BASE: return 1;
+    case GPIO_PORTC_BASE: return 2;
+    case GPIO_PORTD_BASE: return 3;
+    case GPIO_PORTE_BASE: return 4;
+    default:              return 5;
+    }
+}
+
+void
+HostGpioSet(uint32_t port, uint8_t value)
+{
+    uint32_t index = PortIndex(port);
+    uint8_t changed = g_gpio[index] ^ value;
+
+    g_gpio[index] = value;
+    if (changed & g_gpioIntMask[index]) {
+        if (port == GPIO_PORTB_BASE) {
+            HostRaise(HOST_IRQ_GPIOB);
+        } else if (port == GPIO_PORTC_BASE) {
+            HostRaise(HOST_IRQ_GPIOC);
+        }
+    }
+}
+
+void
+HostGpioPlay(uint32_t port, const uint8_t* levels, uint32_t count, uint32_t period)
+{
+    g_playPort = port;
+    g_playLevels = levels;
+    g_playCount = count;
+    g_playPeriod = period;
+    g_playAt = HostCycles() + period;
+}
+
+int32_t
+GPIOPinRead(uint32_t port, uint8_t pins)
+{
+    return g_gpio[PortIndex(port)] & pins;
+}
+
+void GPIOPinTypeGPIOInput(uint32_t port, uint8_t pins) { (void)port; (void)pins; }
+void GPIOPinTypePWM(uint32_t port, uint8_t pins) { (void)port; (void)pins; }
+void GPIOPinTypeQEI(uint32_t port, uint8_t pins) { (void)port; (void)pins; }
+void GPIOPinTypeUART(uint32_t port, uint8_t pins) { (void)port; (void)pins; }
+void GPIOPinConfigure(uint32_t config) { (void)config; }
+void GPIOPadConfigSet(uint32_t port, uint8_t pins, uint32_t strength, uint32_t type) { (void)port; (void)pins; (void)strength; (void)type; }
+void GPIOIntDisable(uint32_t port, uint32_t flags) { g_gpioIntMask[PortIndex(port)] &= ~flags; }
+void GPIOIntEnable(uint32_t port, uint32_t flags) { g_gpioIntMask[PortIndex(port)] |= flags; }
+void GPIOIntClear(uint32_t port, uint32_t flags) { (void)port; (void)flags; }
+void GPIOIntTypeSet(uint32_t port, uint8_t pins, uint32_t type) { (void)port; (void)pins; (void)type; }
+
+void
+GPIOIntRegister(uint32_t port, void (*handler)(void))
+{
+    if (port == GPIO_PORTB_BASE) {
+        g_handlers[HOST_IRQ_GPIOB] = handler;
+    } else if (port == GPIO_PORTC_BASE) {
+        g_handlers[HOST_IRQ_GPIOC] = handler;
+    }
+}
+
+// ---------------------------------------------------------------------
+void
+HostQeiSet(uint32_t position, uint32_t velocity, int32_t direction)
+{
+    g_qeiPosition = position;
+    g_qeiVelocity = velocity;
+    g_qeiDirection = direction;
+}
+
+void
+HostQeiIndex(void)
+{
+    g_qeiPosition = 0;
+    if (g_qeiIntEnabled & QEI_INTINDEX) {
+        HostRaise(HOST_IRQ_QEI);
+    }
+}
+
+void
+QEIIntRegister(uint32_t base, void (*handler)(void))
+{
+    (void)base;
+    g_handlers[HOST_IRQ_QEI] = handler;
+}
+
+void
+QEIIntEnable(uint32_t base, uint32_t flags)
+{
+    (void)base;
+    g_qeiIntEnabled |= flags;
+}
+
+void
+QEIIntDisable(uint32_t base, uint32_t flags)
+{
+    (void)base;
+    g_qeiIntEnabled &= ~flags;
+}
+
+uint32_t QEIPositionGet(uint32_t base) { (void)base; return g_qeiPosition; }
+uint32_t QEIVelocityGet(uint32_t base) { (void)base; return g_qeiVelocity; }
+int32_t QEIDirectionGet(uint32_t base) { (void)base; return g_qeiDirection; }
+void QEIPositionSet(uint32_t base, uint32_t position) { (void)base; g_qeiPosition = position; }
+void QEIConfigure(uint32_t base, uint32_t config, uint32_t maxPosition) { (void)base; (void)config; (void)maxPosition; }
+void QEIVelocityConfigure(uint32_t base, uint32_t preDiv, uint32_t period) { (void)base; (void)preDiv; (void)period; }
+void QEIIntClear(uint32_t base, uint32_t flags) { (void)base; (void)flags; }
+void QEIVelocityEnable(uint32_t base) { (void)base; }
+void QEIEnable(uint32_t base) { (void)base; }
+
+// ---------------------------------------------------------------------
+HostPwm_t*
+HostPwm(uint32_t base, uint32_t out)
+{
+    (void)out;
+    return &g_pwm[base == PWM0_BASE ? 0 : 1];
+}
+
+uint32_t
+HostPwmPeriodWrites(void)
+{
+    return g_pwmPeriodWrites;
+}
+
+void
+PWMPulseWidthSet(uint32_t base, uint32_t out, uint32_t width)
+{
+    HostPwm_t* pwm = HostPwm(base, out);
+
+    pwm->Width = width;
+    pwm->Writes++;
+    if (!g_masked) {
+        pwm->UnmaskedWrites++;
+    }
+}
+
+void
+PWMSyncUpdate(uint32_t base, uint32_t genBits)
+{
+    (void)genBits;
+    HostPwm(base, 0)->SyncUpdates++;
+}
+
+void
+PWMGenPeriodSet(uint32_t base, uint32_t gen, uint32_t period)
+{
+    (void)gen;
+    g_pwmPeriod[base == PWM0_BASE ? 0 : 1] = period;
+    g_pwmPeriodWrites++;
+}
+
+void
+PWMGenEnable(uint32_t base, uint32_t gen)
+{
+    uint32_t module = (base == PWM0_BASE) ? 0 : 1;
+
+    (void)gen;
+    g_pwmStart[module] = HostCycles();
+    g_pwmRunning[module] = true;
+    if (module == 0) {
+        g_pwmNextZero = HostCycles() + g_pwmPeriod[0];
+    }
+}
+
+void
+PWMGenIntTrigEnable(uint32_t base, uint32_t gen, uint32_t triggers)
+{
+    if (base == PWM0_BASE && gen == PWM_GEN_3 && (triggers & PWM_TR_CNT_ZERO)) {
+        g_pwmAdcTrigger = true;
+    }
+}
+
+bool
+HostPwmHigh(uint32_t base, uint32_t cycles)
+{
+    uint32_t module = (base == PWM0_BASE) ? 0 : 1;
+    uint32_t period = g_pwmPeriod[module];
+    uint32_t into;
+
+    if (!g_pwmRunning[module] || period == 0) {
+        return false;
+    }
+    into = (cycles - g_pwmStart[module]) % period;
+    return 2 * (into > period / 2 ? into - period / 2 : period / 2 - into) < g_pwm[module].Width;
+}
+
+void PWMGenConfigure(uint32_t base, uint32_t gen, uint32_t config) { (void)base; (void)gen; (void)config; }
+void PWMOutputState(uint32_t base, uint32_t outBits, bool enable) { (void)base; (void)outBits; (void)enable; }
+
+// ---------------------------------------------------------------------
+void
+UARTConfigSetExpClk(uint32_t base, uint32_t clock, uint32_t baud, uint32_t config)
+{
+    (void)base;
+    (void)config;
+    g_uartCharCycles = clock / (baud / UART_BITS_PER_CHAR);
+}
+
+void
+UARTEnable(uint32_t base)
+{
+    (void)base;
+    g_uartEnabled = true;
+}
+
+bool
+UARTSpaceAvail(uint32_t base)
+{
+    (void)base;
+    return g_uartLevel < UART_FIFO_SIZE;
+}
+
+bool
+UARTCharPutNonBlocking(uint32_t base, unsigned char data)
+{
+    (void)base;
+    if (g_uartLevel == UART_FIFO_SIZE) {
+        return false;
+    }
+    if (g_uartLevel == 0) {
+        g_uartCharDone = HostCycles() + g_uartCharCycles;
+    }
+    g_uartFifo[(g_uartHead + g_uartLevel) % UART_FIFO_SIZE] = data;
+    g_uartLevel++;
+    return true;
+}
+
+uint32_t
+HostUartFifoLevel(void)
+{
+    return g_uartLevel;
+}
+
+void
+UARTIntRegister(uint32_t base, void (*handler)(void))
+{
+    (void)base;
+    g_handlers[HOST_IRQ_UART] = handler;
+}
+
+void
+UARTIntEnable(uint32_t base, uint32_t flags)
+{
+    (void)base;
+    g_uartMask |= flags;
+    if (g_uartRaw & g_uartMask) {
+        HostRaise(HOST_IRQ_UART);
+    }
+}
+
+void
+UARTIntDisable(uint32_t base, uint32_t flags)
+{
+    (void)base;
+    g_uartMask &= ~flags;
+}
+
+uint32_t
+UARTIntStatus(uint32_t base, bool masked)
+{
+    (void)base;
+    return masked ? (g_uartRaw & g_uartMask) : g_uartRaw;
+}
+
+void
+UARTIntClear(uint32_t base, uint32_t flags)
+{
+    (void)base;
+    g_uartRaw &= ~flags;
+}
+
+void UARTFIFOEnable(uint32_t base) { (void)base; }
+void UARTFIFOLevelSet(uint32_t base, uint32_t txLevel, uint32_t rxLevel) { (void)base; (void)txLevel; (void)rxLevel; }
+void UARTTxIntModeSet(uint32_t base, uint32_t mode) { (void)base; (void)mode; }
+
+// ---------------------------------------------------------------------
+void
+HostAdcSet(uint32_t value)
+{
+    g_adcValue = value;
+}
+
+int32_t
+ADCSequenceDataGet(uint32_t base, uint32_t seq, uint32_t* buffer)
+{
+    (void)base;
+    (void)seq;
+    *buffer = g_adcValue;
+    return 1;
+}
+
+static uint32_t
+DmaHalf(uint32_t channelSelect)
+{
+    return (channelSelect & UDMA_ALT_SELECT) ? 1 : 0;
+}
+
+void
+uDMAChannelTransferSet(uint32_t channelSelect, uint32_t mode, void* src, void* dst, uint32_t count)
+{
+    uint32_t half = DmaHalf(channelSelect);
+
+    (void)src;
+    g_dmaDest[half] = dst;
+    g_dmaCount[half] = count;
+    g_dmaMode[half] = mode;
+    g_dmaArms[half]++;
+}
+
+uint32_t
+uDMAChannelModeGet(uint32_t channelSelect)
+{
+    return g_dmaMode[DmaHalf(channelSelect)];
+}
+
+bool
+HostDmaComplete(uint32_t select, const uint16_t* samples, uint32_t count)
+{
+    uint32_t half = DmaHalf(select);
+
+    if (g_dmaMode[half] != UDMA_MODE_PINGPONG || g_dmaCount[half] != count) {
+        return false;
+    }
+    memcpy(g_dmaDest[half], samples, count * sizeof(uint16_t));
+    g_dmaMode[half] = UDMA_MODE_STOP;
+    return true;
+}
+
+uint32_t
+HostDmaArms(uint32_t select)
+{
+    return g_dmaArms[DmaHalf(select)];
+}
+
+void
+HostAdcSignal(uint32_t (*signal)(uint32_t cycles))
+{
+    g_adcSignal = signal;
+}
+
+void
+ADCSequenceConfigure(uint32_t base, uint32_t seq, uint32_t trigger, uint32_t priority)
+{
+    (void)base;
+    (void)priority;
+    if (seq == 3) {
+        g_adcTrigger = trigger;
+    }
+}
+
+void
+ADCIntRegister(uint32_t base, uint32_t seq, void (*handler)(void))
+{
+    (void)base;
+    if (seq == 3) {
+        g_handlers[HOST_IRQ_ADC] = handler;
+    }
+}
+
+void
+ADCProcessorTrigger(uint32_t base, uint32_t seq)
+{
+    (void)base;
+    if (g_adcSignal && seq == 3 && g_adcTrigger == ADC_TRIGGER_PROCESSOR) {
+        AdcStart();
+    }
+}
+
+void
+ADCHardwareOversampleConfigure(uint32_t base, uint32_t factor)
+{
+    (void)base;
+    g_adcOversample = factor ? factor : 1;
+}
+
+void ADCSequenceStepConfigure(uint32_t base, uint32_t seq, uint32_t step, uint32_t config) { (void)base; (void)seq; (void)step; (void)config; }
+void ADCSequenceEnable(uint32_t base, uint32_t seq) { (void)base; (void)seq; }
+void ADCSequenceDMAEnable(uint32_t base, uint32_t seq) { (void)base; (void)seq; }
+void ADCIntEnable(uint32_t base, uint32_t seq) { (void)base; (void)seq; }
+void ADCIntClear(uint32_t base, uint32_t seq) { (void)base; (void)seq; }
+
+void uDMAEnable(void) { }
+void uDMAControlBaseSet(void* table) { (void)table; }
+void uDMAChannelAttributeDisable(uint32_t channel, uint32_t attr) { (void)channel; (void)attr; }
+void uDMAChannelControlSet(uint32_t channelSelect, uint32_t control) { (void)channelSelect; (void)control; }
+void uDMAChannelEnable(uint32_t channel) { (void)channel; }
+
+void TimerConfigure(uint32_t base, uint32_t config) { (void)base; (void)config; }
+void TimerLoadSet(uint32_t base, uint32_t timer, uint32_t value) { (void)base; (void)timer; (void)value; }
+void TimerControlTrigger(uint32_t base, uint32_t timer, bool enable) { (void)base; (void)timer; (void)enable; }
+void TimerEnable(uint32_t base, uint32_t timer) { (void)base; (void)timer; }
@@ -0,0 +1,384 @@
+#ifndef HOST_H
+#define HOST_H
+
+/**
+ * @filename: host.h
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Linux stand-in for the few TivaWare calls and registers the
+ * firmware modules use, so they build and run under test/. Every stub
+ * header in driverlib/, inc/ and utils/ includes this one. Time is a
+ * simulated cycle counter (the DWT CYCCNT register) that only moves in
+ * HostAdvance(); SysTick, the UART and the interrupt masking follow it,
+ * and handlers run as interrupts would, when time passes unmasked.
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Simulated core clock, what SysCtlClockGet() returns
+#define HOST_CLOCK_HZ 20000000
+
+// Cycles from an interrupt to its handler's first line, as on the M4
+#define HOST_IRQ_ENTRY_CYCLES 12
+
+// ---------------------------------------------------------------------
+// Registers: HWREG() reaches a table of words keyed by address. Each
+// use is one access, which for NVIC_ST_CTRL reads and clears the COUNT
+// flag and for NVIC_INT_CTRL refreshes the SysTick pending bit.
+volatile uint32_t*
+HostRegister(uint32_t address);
+
+#define HWREG(x) (*HostRegister((uint32_t)(x)))
+
+// ---------------------------------------------------------------------
+// Time and interrupts
+typedef enum {
+    HOST_IRQ_SYSTICK = 0,
+    HOST_IRQ_PENDSV,
+    HOST_IRQ_UART,
+    HOST_IRQ_GPIOB,
+    HOST_IRQ_GPIOC,
+    HOST_IRQ_WAKE,
+    HOST_IRQ_ADC,
+    HOST_IRQ_QEI,
+    HOST_NUM_IRQS
+} HostIrq_t;
+
+uint32_t
+HostCycles(void);
+
+void
+HostAdvance(uint32_t cycles);
+
+void
+HostWakeAfter(uint32_t cycles, void (*handler)(void));
+
+void
+HostRaise(HostIrq_t irq);
+
+bool
+HostMasked(void);
+
+// Cycles a handler takes after its entry, charged when it returns, so
+// what happens meanwhile waits for it
+void
+HostHandlerCycles(HostIrq_t irq, uint32_t cycles);
+
+// Sleeps taken by CPUwfi() and the cycles spent asleep
+extern uint32_t g_hostWfiCount;
+extern uint64_t g_hostWfiCycles;
+
+// SysTick interrupts taken
+extern uint32_t g_hostSysTicks;
+
+// ---------------------------------------------------------------------
+// Memory map
+#define GPIO_PORTA_BASE 0x40004000
+#define GPIO_PORTB_BASE 0x40005000
+#define GPIO_PORTC_BASE 0x40006000
+#define GPIO_PORTD_BASE 0x40007000
+#define GPIO_PORTE_BASE 0x40024000
+#define GPIO_PORTF_BASE 0x40025000
+#define UART0_BASE      0x4000C000
+#define PWM0_BASE       0x40028000
+#define PWM1_BASE       0x40029000
+#define QEI0_BASE       0x4002C000
+#define TIMER0_BASE     0x40030000
+#define ADC0_BASE       0x40038000
+
+// ---------------------------------------------------------------------
+// System control
+#define SYSCTL_SYSDIV_10     0x04C00000
+#define SYSCTL_USE_PLL       0x00000000
+#define SYSCTL_OSC_MAIN      0x00000000
+#define SYSCTL_XTAL_16MHZ    0x00000540
+
+#define SYSCTL_PERIPH_ADC0   0xf0003800
+#define SYSCTL_PERIPH_GPIOA  0xf0000800
+#define SYSCTL_PERIPH_GPIOB  0xf0000801
+#define SYSCTL_PERIPH_GPIOC  0xf0000802
+#define SYSCTL_PERIPH_GPIOD  0xf0000803
+#define SYSCTL_PERIPH_GPIOE  0xf0000804
+#define SYSCTL_PERIPH_GPIOF  0xf0000805
+#define SYSCTL_PERIPH_PWM0   0xf0004000
+#define SYSCTL_PERIPH_PWM1   0xf0004001
+#define SYSCTL_PERIPH_QEI0   0xf0004400
+#define SYSCTL_PERIPH_TIMER0 0xf0000400
+#define SYSCTL_PERIPH_UART0  0xf0001800
+#define SYSCTL_PERIPH_UDMA   0xf0000c00
+
+void SysCtlClockSet(uint32_t config);
+uint32_t SysCtlClockGet(void);
+void SysCtlPeripheralEnable(uint32_t peripheral);
+void SysCtlReset(void);
+
+// ---------------------------------------------------------------------
+// NVIC, SysTick and the core
+#define FAULT_PENDSV  14
+#define FAULT_SYSTICK 15
+
+#define NVIC_ST_CTRL          0xE000E010
+#define NVIC_ST_RELOAD        0xE000E014
+#define NVIC_ST_CURRENT       0xE000E018
+#define NVIC_ST_CTRL_COUNT    0x00010000
+#define NVIC_ST_CTRL_INTEN    0x00000002
+#define NVIC_ST_CTRL_ENABLE   0x00000001
+#define NVIC_INT_CTRL         0xE000ED04
+#define NVIC_INT_CTRL_PEND_SYST 0x04000000
+
+bool IntMasterDisable(void);
+bool IntMasterEnable(void);
+void IntPendSet(uint32_t interrupt);
+void IntPrioritySet(uint32_t interrupt, uint8_t priority);
+void IntRegister(uint32_t interrupt, void (*handler)(void));
+
+void CPUwfi(void);
+
+void SysTickPeriodSet(uint32_t period);
+uint32_t SysTickValueGet(void);
+void SysTickEnable(void);
+void SysTickDisable(void);
+void SysTickIntEnable(void);
+void SysTickIntRegister(void (*handler)(void));
+
+// ---------------------------------------------------------------------
+// GPIO
+#define GPIO_PIN_0 0x01
+#define GPIO_PIN_1 0x02
+#define GPIO_PIN_2 0x04
+#define GPIO_PIN_3 0x08
+#define GPIO_PIN_4 0x10
+#define GPIO_PIN_5 0x20
+#define GPIO_PIN_6 0x40
+#define GPIO_PIN_7 0x80
+
+#define GPIO_BOTH_EDGES 0x00000001
+#define GPIO_O_LOCK     0x00000520
+#define GPIO_O_CR       0x00000524
+#define GPIO_LOCK_KEY   0x4C4F434B
+#define GPIO_STRENGTH_2MA     0x00000001
+#define GPIO_PIN_TYPE_STD_WPU 0x0000000A
+#define GPIO_PIN_TYPE_STD_WPD 0x0000000C
+
+#define GPIO_PA0_U0RX   0x00000001
+#define GPIO_PA1_U0TX   0x00000401
+#define GPIO_PC5_M0PWM7 0x00021404
+#define GPIO_PF1_M1PWM5 0x00050405
+#define GPIO_PD3_IDX0   0x00030C06
+#define GPIO_PD6_PHA0   0x00031806
+#define GPIO_PD7_PHB0   0x00031C06
+
+void GPIOPinTypeGPIOInput(uint32_t port, uint8_t pins);
+void GPIOPinTypePWM(uint32_t port, uint8_t pins);
+void GPIOPinTypeQEI(uint32_t port, uint8_t pins);
+void GPIOPinTypeUART(uint32_t port, uint8_t pins);
+void GPIOPinConfigure(uint32_t config);
+void GPIOPadConfigSet(uint32_t port, uint8_t pins, uint32_t strength, uint32_t type);
+int32_t GPIOPinRead(uint32_t port, uint8_t pins);
+void GPIOIntDisable(uint32_t port, uint32_t flags);
+void GPIOIntEnable(uint32_t port, uint32_t flags);
+void GPIOIntClear(uint32_t port, uint32_t flags);
+void GPIOIntTypeSet(uint32_t port, uint8_t pins, uint32_t type);
+void GPIOIntRegister(uint32_t port, void (*handler)(void));
+
+// Sets the level of every pin of a port. A change on a pin with its
+// interrupt enabled raises the port's, for ports B and C.
+void
+HostGpioSet(uint32_t port, uint8_t value);
+
+// Sets the port to each of count levels in turn, period cycles apart
+// from a period from now, as the time passes
+void
+HostGpioPlay(uint32_t port, const uint8_t* levels, uint32_t count, uint32_t period);
+
+// ---------------------------------------------------------------------
+// QEI
+#define QEI_CONFIG_CAPTURE_A_B 0x00000008
+#define QEI_CONFIG_RESET_IDX   0x00000010
+#define QEI_CONFIG_QUADRATURE  0x00000000
+#define QEI_CONFIG_NO_SWAP     0x00000000
+#define QEI_VELDIV_1           0x00000000
+#define QEI_INTINDEX           0x00000001
+
+void QEIConfigure(uint32_t base, uint32_t config, uint32_t maxPosition);
+void QEIVelocityConfigure(uint32_t base, uint32_t preDiv, uint32_t period);
+void QEIPositionSet(uint32_t base, uint32_t position);
+uint32_t QEIPositionGet(uint32_t base);
+uint32_t QEIVelocityGet(uint32_t base);
+int32_t QEIDirectionGet(uint32_t base);
+void QEIIntRegister(uint32_t base, void (*handler)(void));
+void QEIIntEnable(uint32_t base, uint32_t flags);
+void QEIIntDisable(uint32_t base, uint32_t flags);
+void QEIIntClear(uint32_t base, uint32_t flags);
+void QEIVelocityEnable(uint32_t base);
+void QEIEnable(uint32_t base);
+
+// Position, edges per velocity window and direction (1 or -1)
+void
+HostQeiSet(uint32_t position, uint32_t velocity, int32_t direction);
+
+// The index pulse: zeroes the position and raises HOST_IRQ_QEI if the
+// index interrupt is enabled
+void
+HostQeiIndex(void);
+
+// ---------------------------------------------------------------------
+// PWM
+#define PWM_GEN_2      0x000000C0
+#define PWM_GEN_3      0x00000100
+#define PWM_GEN_2_BIT  0x00000004
+#define PWM_GEN_3_BIT  0x00000008
+#define PWM_OUT_5      0x000000C5
+#define PWM_OUT_7      0x00000107
+#define PWM_OUT_5_BIT  0x00000020
+#define PWM_OUT_7_BIT  0x00000080
+#define PWM_GEN_MODE_UP_DOWN 0x00000002
+#define PWM_GEN_MODE_SYNC    0x00000038
+#define PWM_GEN_MODE_NO_SYNC 0x00000000
+#define PWM_TR_CNT_ZERO      0x00000100
+
+void PWMGenConfigure(uint32_t base, uint32_t gen, uint32_t config);
+void PWMGenPeriodSet(uint32_t base, uint32_t gen, uint32_t period);
+void PWMGenEnable(uint32_t base, uint32_t gen);
+void PWMGenIntTrigEnable(uint32_t base, uint32_t gen, uint32_t triggers);
+void PWMPulseWidthSet(uint32_t base, uint32_t out, uint32_t width);
+void PWMOutputState(uint32_t base, uint32_t outBits, bool enable);
+void PWMSyncUpdate(uint32_t base, uint32_t genBits);
+
+/*
+ * What the PWM stand-in saw of one output: the compare value (its
+ * pulse width), the writes to it, the writes made with interrupts
+ * unmasked, and the sync updates on its module
+ */
+typedef struct {
+    uint32_t Width;
+    uint32_t Writes;
+    uint32_t UnmaskedWrites;
+    uint32_t SyncUpdates;
+} HostPwm_t;
+
+HostPwm_t*
+HostPwm(uint32_t base, uint32_t out);
+
+uint32_t
+HostPwmPeriodWrites(void);
+
+// Level of a module's output at a cycle count. The generator counts
+// up/down from PWMGenEnable(), one PWM clock a cycle, so each period
+// starts at counter zero and the pulse is centred on its middle.
+bool
+HostPwmHigh(uint32_t base, uint32_t cycles);
+
+// ---------------------------------------------------------------------
+// UART, a 16 byte TX FIFO drained onto a capture buffer at the baud rate
+#define UART_CONFIG_WLEN_8    0x00000060
+#define UART_CONFIG_STOP_ONE  0x00000000
+#define UART_CONFIG_PAR_NONE  0x00000000
+#define UART_FIFO_TX1_8       0x00000000
+#define UART_FIFO_RX4_8       0x00000010
+#define UART_TXINT_MODE_FIFO  0x00000000
+#define UART_INT_TX           0x00000020
+
+void UARTConfigSetExpClk(uint32_t base, uint32_t clock, uint32_t baud, uint32_t config);
+void UARTFIFOEnable(uint32_t base);
+void UARTFIFOLevelSet(uint32_t base, uint32_t txLevel, uint32_t rxLevel);
+void UARTTxIntModeSet(uint32_t base, uint32_t mode);
+void UARTIntRegister(uint32_t base, void (*handler)(void));
+void UARTIntEnable(uint32_t base, uint32_t flags);
+void UARTIntDisable(uint32_t base, uint32_t flags);
+uint32_t UARTIntStatus(uint32_t base, bool masked);
+void UARTIntClear(uint32_t base, uint32_t flags);
+void UARTEnable(uint32_t base);
+bool UARTSpaceAvail(uint32_t base);
+bool UARTCharPutNonBlocking(uint32_t base, unsigned char data);
+
+// Bytes that have left the TX pin, in order
+#define HOST_UART_CAPTURE 65536
+extern uint8_t g_hostUartWire[HOST_UART_CAPTURE];
+extern uint32_t g_hostUartWireCount;
+
+uint32_t
+HostUartFifoLevel(void);
+
+// ---------------------------------------------------------------------
+// ADC, uDMA and timers
+#define ADC_CTL_CH9            0x00000009
+#define ADC_CTL_IE             0x00000040
+#define ADC_CTL_END            0x00000020
+#define ADC_TRIGGER_PROCESSOR  0x00000000
+#define ADC_TRIGGER_TIMER      0x00000005
+#define ADC_TRIGGER_PWM3       0x00000009
+#define ADC_O_SSFIFO0          0x00000048
+
+#define UDMA_CHANNEL_ADC0      14
+#define UDMA_PRI_SELECT        0x00000000
+#define UDMA_ALT_SELECT        0x00000020
+#define UDMA_MODE_STOP         0x00000000
+#define UDMA_MODE_PINGPONG     0x00000003
+#define UDMA_ATTR_ALTSELECT    0x00000001
+#define UDMA_ATTR_USEBURST     0x00000002
+#define UDMA_ATTR_HIGH_PRIORITY 0x00000004
+#define UDMA_ATTR_REQMASK      0x00000008
+#define UDMA_SIZE_16           0x11000000
+#define UDMA_SRC_INC_NONE      0x0c000000
+#define UDMA_DST_INC_16        0x40000000
+#define UDMA_ARB_1             0x00000000
+
+#define TIMER_CFG_PERIODIC     0x00000022
+#define TIMER_A                0x000000ff
+
+void ADCSequenceConfigure(uint32_t base, uint32_t seq, uint32_t trigger, uint32_t priority);
+void ADCSequenceStepConfigure(uint32_t base, uint32_t seq, uint32_t step, uint32_t config);
+void ADCSequenceEnable(uint32_t base, uint32_t seq);
+void ADCSequenceDMAEnable(uint32_t base, uint32_t seq);
+void ADCIntRegister(uint32_t base, uint32_t seq, void (*handler)(void));
+void ADCIntEnable(uint32_t base, uint32_t seq);
+void ADCIntClear(uint32_t base, uint32_t seq);
+void ADCProcessorTrigger(uint32_t base, uint32_t seq);
+int32_t ADCSequenceDataGet(uint32_t base, uint32_t seq, uint32_t* buffer);
+void ADCHardwareOversampleConfigure(uint32_t base, uint32_t factor);
+
+void uDMAEnable(void);
+void uDMAControlBaseSet(void* table);
+void uDMAChannelAttributeDisable(uint32_t channel, uint32_t attr);
+void uDMAChannelControlSet(uint32_t channelSelect, uint32_t control);
+void uDMAChannelTransferSet(uint32_t channelSelect, uint32_t mode, void* src, void* dst, uint32_t count);
+void uDMAChannelEnable(uint32_t channel);
+uint32_t uDMAChannelModeGet(uint32_t channelSelect);
+
+void TimerConfigure(uint32_t base, uint32_t config);
+void TimerLoadSet(uint32_t base, uint32_t timer, uint32_t value);
+void TimerControlTrigger(uint32_t base, uint32_t timer, bool enable);
+void TimerEnable(uint32_t base, uint32_t timer);
+
+// The next ADCSequenceDataGet() result
+void
+HostAdcSet(uint32_t value);
+
+// Cycles a conversion takes, at 1 Msps
+#define HOST_ADC_CONVERSION_CYCLES (HOST_CLOCK_HZ / 1000000)
+
+// The analog input in counts at a cycle count. While set, sequence 3
+// converts it on its trigger (ADCProcessorTrigger(), or counter zero of
+// PWM0 generator 3 for ADC_TRIGGER_PWM3), averaging the oversampling
+// factor's conversions back to back, and raises HOST_IRQ_ADC when done.
+void
+HostAdcSignal(uint32_t (*signal)(uint32_t cycles));
+
+// Cycle counts sequence 3's conversions started at, in order
+#define HOST_ADC_CAPTURE 4096
+extern uint32_t g_hostAdcStarts[HOST_ADC_CAPTURE];
+extern uint32_t g_hostAdcConversions;
+
+// Plays the uDMA finishing one half (UDMA_PRI_SELECT or
+// UDMA_ALT_SELECT) of the ping-pong transfer with count samples.
+// Returns false if that half wasn't armed for them.
+bool
+HostDmaComplete(uint32_t select, const uint16_t* samples, uint32_t count);
+
+// Times a half has been armed
+uint32_t
+HostDmaArms(uint32_t select);
+
+#endif
@@ -0,0 +1,2 @@
+/* TivaWare stand-in, see test/stub/host.h */
+#include "host.h"
@@ -0,0 +1,6 @@
+/* TivaWare stand-in, see test/stub/host.h */
+#include "host.h"
+
+#define GPIO_PORTF_LOCK_R HWREG(GPIO_PORTF_BASE + GPIO_O_LOCK)
+#define GPIO_PORTF_CR_R   HWREG(GPIO_PORTF_BASE + GPIO_O_CR)
+#define GPIO_LOCK_M       0xFFFFFFFF
@@ -0,0 +1,2 @@
+/* The firmware includes "motors.h", the header is Motors.h */
+#include "../../Motors.h"
@@ -0,0 +1,6 @@
+/* TivaWare stand-in, see test/stub/host.h */
+#include <stdio.h>
+#include "host.h"
+
+#define usnprintf snprintf
+#define usprintf sprintf
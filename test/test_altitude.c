@@ -0,0 +1,342 @@
+/**
+ * @filename: test_altitude.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Host tests for the altitude capture in altitude.c, the
+ * uDMA ping-pong blocks fed with a synthetic signal by the stand-in,
+ * and software against PWM triggered sampling of a rippled signal
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+
+#include "host.h"
+#include "check.h"
+#include "altitude.h"
+#include "kernel.h"
+#include "motors.h"
+#include "tasks.h"
+
+// As in altitude.c
+#define ALT_DMA_BLOCK 40
+#define SAMPLE_RING_SIZE 16
+
+// Synthetic signal at the 8 kHz the sequencer delivers
+#define SIGNAL_HZ 8000
+
+// Rippled signal: a steady level, RIPPLE counts higher while the main
+// rotor's PWM output is high, and up to NOISE counts either way
+#define LEVEL 2048
+#define RIPPLE 60
+#define NOISE 4
+
+// Runs of each source, the PWM started at as many points through an
+// ADCTask period, each sampling for RIPPLE_SECONDS
+#define RIPPLE_PHASES 8
+#define RIPPLE_SECONDS 2
+
+// Another interrupt (the yaw edges, the UART) every 50 to 1000 us,
+// taking 20 us
+#define OTHER_IRQ_CYCLES (HOST_CLOCK_HZ / 50000)
+
+/*
+ * What one run saw: the RMS of the readings about LEVEL and the
+ * standard deviation of the intervals between conversions
+ */
+typedef struct {
+    double Noise;
+    double JitterUs;
+    uint32_t Samples;
+} Sampling_t;
+
+static uint32_t g_signalIndex;
+static uint32_t g_callbacks;
+
+static const AltSource_t* g_rippleSource;
+static uint32_t g_ripplePhase;
+static Sampling_t* g_sampling;
+static uint32_t g_random;
+static double g_noiseSum;
+static uint32_t g_readings;
+
+/*
+ * Altitude voltage swinging 400 counts at 1 Hz around mid scale, with
+ * a +-8 count sawtooth for noise
+ */
+static uint16_t
+Signal(uint32_t index)
+{
+    double t = (double)index / SIGNAL_HZ;
+
+    return 2048 + (int32_t)lround(400 * sin(2 * M_PI * t)) + (int32_t)(index * 7 % 17) - 8;
+}
+
+/*
+ * Plays the uDMA filling one half with the next block of the signal.
+ * Returns the block's rounded mean, what the handler must queue.
+ */
+static uint32_t
+FillBlock(uint32_t select)
+{
+    uint16_t block[ALT_DMA_BLOCK];
+    uint32_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < ALT_DMA_BLOCK; i++) {
+        block[i] = Signal(g_signalIndex++);
+        sum += block[i];
+    }
+    CHECK(HostDmaComplete(select, block, ALT_DMA_BLOCK));
+    return (sum + ALT_DMA_BLOCK / 2) / ALT_DMA_BLOCK;
+}
+
+static void
+CountCallback(void)
+{
+    g_callbacks++;
+}
+
+/*
+ * A second of the signal through the ping-pong halves in turn: each
+ * block must come out as its mean, stamped with the interrupt's cycle
+ * count, and each half must be armed again for the next
+ */
+static void
+TestDmaBlocks(void)
+{
+    uint32_t mismatches = 0;
+    uint32_t stampErrors = 0;
+    uint32_t block;
+
+    InitADC(&g_adcDmaSource);
+    CHECK(SetAltFilter(FILTER_NONE, 0, 0));
+    CHECK_EQ(HostDmaArms(UDMA_PRI_SELECT), 1);
+    CHECK_EQ(HostDmaArms(UDMA_ALT_SELECT), 1);
+    SetAltBlockCallback(CountCallback, 4);
+
+    for (block = 0; block < SIGNAL_HZ / ALT_DMA_BLOCK; block++) {
+        uint32_t expected = FillBlock((block % 2) ? UDMA_ALT_SELECT : UDMA_PRI_SELECT);
+
+        // Not armed again until the interrupt has taken the block
+        CHECK(!HostDmaComplete((block % 2) ? UDMA_ALT_SELECT : UDMA_PRI_SELECT, NULL, ALT_DMA_BLOCK));
+
+        HostAdvance(HOST_CLOCK_HZ / (SIGNAL_HZ / ALT_DMA_BLOCK));
+        ADCBlockIntHandler();
+        if (GetAltMean() != (int32_t)expected) {
+            mismatches++;
+        }
+        GetAltPercent();
+        if (GetAltSampleCycles() != HostCycles()) {
+            stampErrors++;
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(stampErrors, 0);
+    CHECK_EQ(HostDmaArms(UDMA_PRI_SELECT), 1 + SIGNAL_HZ / ALT_DMA_BLOCK / 2);
+    CHECK_EQ(HostDmaArms(UDMA_ALT_SELECT), 1 + SIGNAL_HZ / ALT_DMA_BLOCK / 2);
+    CHECK_EQ(g_callbacks, SIGNAL_HZ / ALT_DMA_BLOCK / 4);
+    CHECK_EQ(GetAltSampleOverflows(), 0);
+
+    // A late interrupt finds both halves full and takes both
+    uint32_t first = FillBlock(UDMA_PRI_SELECT);
+    uint32_t second = FillBlock(UDMA_ALT_SELECT);
+    CHECK(SetAltFilter(FILTER_BOXCAR, 2, 0));
+    ADCBlockIntHandler();
+    CHECK_EQ(GetAltMean(), (first + second + 1) / 2);
+
+    // Blocks nobody reads fill the sample ring, then are dropped
+    for (block = 0; block < SAMPLE_RING_SIZE + 3; block++) {
+        FillBlock((block % 2) ? UDMA_ALT_SELECT : UDMA_PRI_SELECT);
+        ADCBlockIntHandler();
+    }
+    CHECK_EQ(GetAltSampleOverflows(), 3);
+}
+
+/*
+ * The single conversion source queues what the sequencer read
+ */
+static void
+TestSingleSamples(void)
+{
+    InitADC(&g_adcSingleSource);
+    CHECK(SetAltFilter(FILTER_NONE, 0, 0));
+
+    HostAdcSet(1234);
+    ADCProcessTrigger();
+    ADCIntHandler();
+    CHECK_EQ(GetAltMean(), 1234);
+    HostAdcSet(4000);
+    ADCIntHandler();
+    CHECK_EQ(GetAltMean(), 4000);
+}
+
+static uint32_t
+Random(uint32_t range)
+{
+    g_random = g_random * 1103515245 + 12345;
+    return (g_random >> 16) % range;
+}
+
+static uint32_t
+RippledSignal(uint32_t cycles)
+{
+    int32_t noise = (int32_t)((cycles * 2654435761u) >> 24) % (2 * NOISE + 1) - NOISE;
+
+    return LEVEL + (HostPwmHigh(PWM0_BASE, cycles) ? RIPPLE : 0) + noise;
+}
+
+/*
+ * Every reading the filter passes on, taken as it comes in
+ */
+static void
+RecordReading(void)
+{
+    double error = GetAltMean() - LEVEL;
+
+    g_noiseSum += error * error;
+    g_readings++;
+}
+
+static void
+RippleADCTask(void)
+{
+    ADCProcessTrigger();
+}
+
+/*
+ * Stands in for the controller: a run of up to its budget, ending on
+ * a new main duty anywhere from 5% to 95%
+ */
+static void
+RippleControlTask(void)
+{
+    HostAdvance(Random(CONTROL_WCET_US * (HOST_CLOCK_HZ / 1000000)));
+    SetMotorDuty(MOTOR_MAIN, 50 + Random(901));
+}
+
+static void
+OtherInterrupt(void)
+{
+    HostWakeAfter(OTHER_IRQ_CYCLES / 2 * (5 + Random(96)), OtherInterrupt);
+}
+
+/*
+ * Samples the rippled signal through g_rippleSource for RIPPLE_SECONDS
+ * under the controller and the other interrupt, scheduled as main.c
+ * does, with the PWM started g_ripplePhase eighths of an ADCTask
+ * period after the kernel
+ */
+static void
+SampleRipple(void)
+{
+    Sampling_t* result = &g_sampling[(g_rippleSource == &g_adcPwmSource) * RIPPLE_PHASES + g_ripplePhase];
+    double sum = 0;
+    double sumSquares = 0;
+    uint32_t intervals;
+    uint32_t i;
+
+    g_random = g_ripplePhase + 1;
+    HostAdcSignal(RippledSignal);
+    HostHandlerCycles(HOST_IRQ_WAKE, OTHER_IRQ_CYCLES);
+
+    InitKernel(KERNEL_RATE_HZ);
+    SetSchedPolicy(SCHED_RATE_MONOTONIC);
+    HostAdvance(g_ripplePhase * (HOST_CLOCK_HZ / KERNEL_RATE_HZ) * ADC_TICKS / RIPPLE_PHASES);
+    InitMotors();
+    InitADC(g_rippleSource);
+    CHECK(SetAltFilter(FILTER_NONE, 0, 0));
+    SetAltBlockCallback(RecordReading, 1);
+    IntMasterEnable();
+
+    if (g_rippleSource->Trigger) {
+        AddTask(RippleADCTask, ADC_TICKS, ADC_PRIORITY, 1, ADC_WCET_US, OVERRUN_REALIGN, TIER_FOREGROUND,
+                ACTIVATE_PERIODIC);
+    }
+    AddTask(RippleControlTask, CONTROL_TICKS, CONTROL_PRIORITY, 1, CONTROL_WCET_US, OVERRUN_REALIGN,
+            TIER_FOREGROUND, ACTIVATE_PERIODIC);
+    HostWakeAfter(OTHER_IRQ_CYCLES, OtherInterrupt);
+
+    HostAdvance(RIPPLE_SECONDS * HOST_CLOCK_HZ);
+
+    CHECK(g_hostAdcConversions < HOST_ADC_CAPTURE);
+    intervals = g_hostAdcConversions - 1;
+    for (i = 1; i < g_hostAdcConversions; i++) {
+        double interval = (double)(g_hostAdcStarts[i] - g_hostAdcStarts[i - 1]);
+
+        sum += interval;
+        sumSquares += interval * interval;
+    }
+    result->JitterUs = sqrt(fmax(sumSquares / intervals - (sum / intervals) * (sum / intervals), 0)) /
+                       (HOST_CLOCK_HZ / 1000000);
+    result->Noise = sqrt(g_noiseSum / g_readings);
+    result->Samples = g_readings;
+}
+
+/*
+ * The main rotor's PWM ripples the altitude signal. Started by the
+ * PWM generator each conversion lands mid way through the off time,
+ * the same point every period whatever the duty, so the ripple never
+ * reaches the readings and the conversions are evenly spaced. Started
+ * from ADCTask they land at a point of the period set only by when the
+ * PWM started, on the pulse as often as the controller's duty puts it
+ * there, and late whenever another interrupt holds off the tick.
+ */
+static void
+TestPwmTriggerRipple(void)
+{
+    const Sampling_t* software = &g_sampling[0];
+    const Sampling_t* pwm = &g_sampling[RIPPLE_PHASES];
+    double softwareNoise = 0;
+    double softwareJitter = 0;
+    double pwmNoise = 0;
+    double pwmJitter = 0;
+    uint32_t phase;
+
+    for (phase = 0; phase < RIPPLE_PHASES; phase++) {
+        g_ripplePhase = phase;
+        g_rippleSource = &g_adcSingleSource;
+        CheckIsolated(SampleRipple);
+        g_rippleSource = &g_adcPwmSource;
+        CheckIsolated(SampleRipple);
+
+        // One reading a PWM period or ADCTask period either way
+        CHECK_NEAR(software[phase].Samples, RIPPLE_SECONDS * KERNEL_RATE_HZ / ADC_TICKS, 2);
+        CHECK_NEAR(pwm[phase].Samples, RIPPLE_SECONDS * KERNEL_RATE_HZ / ADC_TICKS, 2);
+
+        softwareNoise += software[phase].Noise / RIPPLE_PHASES;
+        softwareJitter += software[phase].JitterUs / RIPPLE_PHASES;
+        pwmNoise = fmax(pwmNoise, pwm[phase].Noise);
+        pwmJitter = fmax(pwmJitter, pwm[phase].JitterUs);
+    }
+
+    printf("altitude: %u count ripple, noise RMS and interval jitter\n", RIPPLE);
+    printf("  software trigger  mean %5.2f counts %6.2f us\n", softwareNoise, softwareJitter);
+    printf("  PWM trigger       worst %5.2f counts %6.2f us\n", pwmNoise, pwmJitter);
+
+    CHECK(pwmNoise < NOISE);
+    CHECK(pwmNoise * 4 < softwareNoise);
+    CHECK_EQ(pwmJitter, 0);
+    CHECK(softwareJitter > 1);
+    CHECK(softwareNoise > RIPPLE / 4);
+}
+
+int
+main(void)
+{
+    g_sampling = mmap(NULL, 2 * RIPPLE_PHASES * sizeof(Sampling_t), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_sampling == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(g_sampling, 0, 2 * RIPPLE_PHASES * sizeof(Sampling_t));
+
+    CheckIsolated(TestDmaBlocks);
+    CheckIsolated(TestSingleSamples);
+    TestPwmTriggerRipple();
+    return CheckDone("altitude");
+}
@@ -0,0 +1,139 @@
+/**
+ * @filename: test_circbuf.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Host tests for the running sums in circBufT.c, against
+ * re-summing the buffer as it used to on every read
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "circBufT.h"
+
+#define MAX_WINDOW 1024
+#define ADC_MAX 4095
+
+static uint32_t g_data[MAX_WINDOW];
+
+// Keeps the benchmarked reads
+static volatile uint32_t g_sink;
+
+/*
+ * The mean as circBufT.c had it, summing every entry
+ */
+static uint32_t
+ResumMean(const circBuf_t* buffer)
+{
+    uint32_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < buffer->size; i++) {
+        sum += buffer->data[i];
+    }
+    return (2 * sum + buffer->size) / 2 / buffer->size;
+}
+
+static uint32_t
+ResumVariance(const circBuf_t* buffer)
+{
+    uint64_t sum = 0;
+    uint64_t sumSq = 0;
+    uint64_t n = buffer->size;
+    uint32_t i;
+
+    for (i = 0; i < buffer->size; i++) {
+        sum += buffer->data[i];
+        sumSq += (uint64_t)buffer->data[i] * buffer->data[i];
+    }
+    return (n * sumSq - sum * sum) / (n * n);
+}
+
+/*
+ * Random 12 bit samples, then full scale ones: the running figures
+ * must match re-summing after every write, through many wraps
+ */
+static void
+TestRunningSums(uint32_t size)
+{
+    circBuf_t buffer;
+    uint32_t mismatches = 0;
+    uint32_t i;
+
+    initCircBuf(&buffer, g_data, size);
+    CHECK_EQ(sumCircBuf(&buffer), 0);
+    CHECK_EQ(meanCircBuf(&buffer), 0);
+
+    srand(size);
+    for (i = 0; i < 20 * size; i++) {
+        uint32_t sample = (i < 10 * size) ? (uint32_t)rand() % (ADC_MAX + 1) : ADC_MAX;
+        writeCircBuf(&buffer, sample);
+        if (meanCircBuf(&buffer) != ResumMean(&buffer) ||
+            varianceCircBuf(&buffer) != ResumVariance(&buffer)) {
+            mismatches++;
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(sumCircBuf(&buffer), size * ADC_MAX);
+    CHECK_EQ(meanCircBuf(&buffer), ADC_MAX);
+    CHECK_EQ(varianceCircBuf(&buffer), 0);
+
+    // Reading doesn't disturb the sums
+    for (i = 0; i < size + 3; i++) {
+        CHECK_EQ(readCircBuf(&buffer), ADC_MAX);
+    }
+    CHECK_EQ(sumCircBuf(&buffer), size * ADC_MAX);
+}
+
+/*
+ * A write and a mean per sample, as the altitude filter does, running
+ * sum against re-summing
+ */
+static void
+BenchMean(uint32_t size)
+{
+    const uint32_t samples = 200000;
+    circBuf_t buffer;
+    uint64_t start;
+    uint64_t runningNs, resumNs;
+    uint32_t i;
+
+    initCircBuf(&buffer, g_data, size);
+    start = BenchNs();
+    for (i = 0; i < samples; i++) {
+        writeCircBuf(&buffer, i & ADC_MAX);
+        g_sink = meanCircBuf(&buffer);
+    }
+    runningNs = BenchNs() - start;
+
+    initCircBuf(&buffer, g_data, size);
+    start = BenchNs();
+    for (i = 0; i < samples; i++) {
+        writeCircBuf(&buffer, i & ADC_MAX);
+        g_sink = ResumMean(&buffer);
+    }
+    resumNs = BenchNs() - start;
+
+    printf("circbuf %4u entries: running sum %5.1f ns, re-sum %7.1f ns per sample\n",
+           size, (double)runningNs / samples, (double)resumNs / samples);
+}
+
+int
+main(int argc, char** argv)
+{
+    static const uint32_t sizes[] = {1, 24, 64, 256, MAX_WINDOW};
+    uint32_t i;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        TestRunningSums(sizes[i]);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        for (i = 1; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            BenchMean(sizes[i]);
+        }
+    }
+    return CheckDone("circbuf");
+}
@@ -0,0 +1,281 @@
+/**
+ * @filename: test_control.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Closed loop host simulation of disturbance rejection on the
+ * rig (rig.h) with the controller at tasks.h's 500 Hz and at the ~44 Hz
+ * it ran at before: a gust on the tail and a load on the rig while
+ * hovering at 50%. Also the sensor to actuator delay of the controller
+ * released by the ADC interrupt against the periodic one.
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+
+#include "host.h"
+#include "check.h"
+#include "altitude.h"
+#include "kernel.h"
+#include "motors.h"
+#include "tasks.h"
+#include "rig.h"
+
+// The old controller period, about 44 Hz
+#define OLD_CONTROL_TICKS 45
+
+// Flight: switch up at 1 s, UP five times from 12 s to 50%, then a
+// gust on the tail and later a load on the rig, each held for a while
+#define SWITCH_UP_S 1.0
+#define STEPS_FROM_S 12.0
+#define STEP_EVERY_S 2.0
+#define STEPS_UP 5
+#define PUSH_S 0.2
+#define GUST_S 30.0
+#define LOAD_S 40.0
+#define HOLD_S 3.0
+#define FLIGHT_S 50.0
+
+// Gust in degrees/s^2, load in percent/s^2
+#define GUST 40.0
+#define LOAD 2.0
+
+/*
+ * How one flight rode out the disturbances, kept where the parent
+ * process reads it
+ */
+typedef struct {
+    double WorstYaw;    // degrees off the setpoint from the gust on
+    double MeanYaw;     // mean absolute degrees off over the same
+    double WorstHeight; // percent off 50% from the load on
+    double MeanHeight;
+} Rejection_t;
+
+/*
+ * Age of the altitude sample behind each controlled write, from the
+ * controller's own stamps and from Motors.c's histogram
+ */
+typedef struct {
+    double MeanUs;
+    uint32_t MaxUs;
+    uint32_t HistMaxUs;
+    uint32_t Runs;
+} Delay_t;
+
+// Delays are measured for DELAY_SECONDS after DELAY_SETTLE_S
+#define DELAY_SECONDS 2
+#define DELAY_SETTLE_S 0.1
+
+static uint16_t g_controlTicks;
+static Rejection_t* g_results;
+static Delay_t* g_delays;
+static Activation_t g_activation;
+static TaskHandle_t g_delayTask;
+static uint64_t g_delaySum;
+static bool g_measuring;
+
+/*
+ * Flies the rig to 50% with the controller every g_controlTicks, then
+ * applies the gust and the load in turn
+ */
+static void
+Fly(void)
+{
+    Rejection_t* result = &g_results[(g_controlTicks == CONTROL_TICKS) ? 0 : 1];
+    uint32_t ticks = (uint32_t)(FLIGHT_S * KERNEL_RATE_HZ);
+    uint32_t gustTicks = 0;
+    uint32_t loadTicks = 0;
+    uint32_t tick;
+
+    RigStart(g_controlTicks);
+
+    for (tick = 0; tick < ticks; tick++) {
+        double t = (double)tick / KERNEL_RATE_HZ;
+        double since = t - STEPS_FROM_S;
+        bool up = since >= 0 && since < STEPS_UP * STEP_EVERY_S && fmod(since, STEP_EVERY_S) < PUSH_S;
+
+        RigInputs(t >= SWITCH_UP_S, up, false);
+        g_rig.YawGust = (t >= GUST_S && t < GUST_S + HOLD_S) ? GUST : 0;
+        g_rig.Load = (t >= LOAD_S && t < LOAD_S + HOLD_S) ? LOAD : 0;
+        RigTick();
+
+        if (t >= GUST_S && t < LOAD_S) {
+            double yaw = fabs(remainder(g_rig.Yaw, 360.0));
+
+            result->WorstYaw = fmax(result->WorstYaw, yaw);
+            result->MeanYaw += yaw;
+            gustTicks++;
+        } else if (t >= LOAD_S) {
+            double height = fabs(g_rig.Height - STEPS_UP * 10);
+
+            result->WorstHeight = fmax(result->WorstHeight, height);
+            result->MeanHeight += height;
+            loadTicks++;
+        }
+    }
+    CHECK(RigFlying());
+    result->MeanYaw /= gustTicks;
+    result->MeanHeight /= loadTicks;
+}
+
+static void
+FlyFast(void)
+{
+    g_controlTicks = CONTROL_TICKS;
+    Fly();
+}
+
+static void
+FlySlow(void)
+{
+    g_controlTicks = OLD_CONTROL_TICKS;
+    Fly();
+}
+
+/*
+ * At 500 Hz the gust must push the heli at least 5% less far, and less
+ * far on average, than at 44 Hz: the encoder is read every 2 ms rather
+ * than every 22.5 ms. The altitude loop sees 200 Hz samples behind the
+ * 35 ms filter either way, so the load only has to do no worse.
+ */
+static void
+TestRejection(void)
+{
+    const Rejection_t* fast = &g_results[0];
+    const Rejection_t* slow = &g_results[1];
+
+    CheckIsolated(FlyFast);
+    CheckIsolated(FlySlow);
+
+    printf("control: disturbance rejection, worst and mean off the setpoint\n");
+    printf("  %3u Hz  gust %5.2f %5.2f degrees  load %5.3f %5.3f%%\n", KERNEL_RATE_HZ / CONTROL_TICKS,
+           fast->WorstYaw, fast->MeanYaw, fast->WorstHeight, fast->MeanHeight);
+    printf("  %3u Hz  gust %5.2f %5.2f degrees  load %5.3f %5.3f%%\n", KERNEL_RATE_HZ / OLD_CONTROL_TICKS,
+           slow->WorstYaw, slow->MeanYaw, slow->WorstHeight, slow->MeanHeight);
+
+    CHECK(fast->WorstYaw < slow->WorstYaw * 0.95);
+    CHECK(fast->MeanYaw < slow->MeanYaw);
+    CHECK(fast->WorstHeight <= slow->WorstHeight);
+    CHECK(fast->MeanHeight <= slow->MeanHeight);
+}
+
+static uint32_t
+SteadySignal(uint32_t cycles)
+{
+    (void)cycles;
+    return RIG_GROUND_ADC;
+}
+
+/*
+ * The controller's sampling and writes, as main.c's ControlTask
+ */
+static void
+DelayControlTask(void)
+{
+    Delay_t* delay = &g_delays[g_activation == ACTIVATE_EVENT];
+    uint32_t age;
+
+    GetAltPercent();
+    SetMotorDutiesSampled(500, 500, GetAltSampleCycles(), GetAltSampleCycles());
+    if (!g_measuring) {
+        return;
+    }
+    age = (HostCycles() - GetAltSampleCycles()) / (HOST_CLOCK_HZ / 1000000);
+    g_delaySum += age;
+    delay->MaxUs = (age > delay->MaxUs) ? age : delay->MaxUs;
+    delay->Runs++;
+}
+
+static void
+SignalDelayControl(void)
+{
+    TaskSignal(g_delayTask);
+}
+
+/*
+ * main.c's altitude path: PWM triggered samples, and the controller
+ * every CONTROL_TICKS or signalled every CONTROL_SAMPLES samples, its
+ * ticks a third of a tick off the PWM's periods
+ */
+static void
+MeasureDelay(void)
+{
+    Delay_t* delay = &g_delays[g_activation == ACTIVATE_EVENT];
+    LatencyHist_t hist;
+
+    HostAdcSignal(SteadySignal);
+    InitKernel(KERNEL_RATE_HZ);
+    HostAdvance(RIG_TICK_CYCLES / 3);
+    InitMotors();
+    InitADC(&g_adcPwmSource);
+    IntMasterEnable();
+    g_delayTask = AddTask(DelayControlTask, CONTROL_TICKS, CONTROL_PRIORITY, 1, CONTROL_WCET_US,
+                          OVERRUN_REALIGN, TIER_FOREGROUND, g_activation);
+    if (g_activation == ACTIVATE_EVENT) {
+        SetAltBlockCallback(SignalDelayControl, CONTROL_SAMPLES);
+    }
+
+    HostAdvance(DELAY_SETTLE_S * HOST_CLOCK_HZ);
+    ResetLatencyHistograms();
+    g_measuring = true;
+    HostAdvance(DELAY_SECONDS * HOST_CLOCK_HZ);
+    g_measuring = false;
+    RequestLatencyHistograms();
+    HostAdvance(DELAY_SETTLE_S * HOST_CLOCK_HZ);
+
+    CHECK(GetLatencyHistogram(MOTOR_MAIN, &hist));
+    delay->HistMaxUs = hist.MaxUs;
+    delay->MeanUs = (double)g_delaySum / delay->Runs;
+}
+
+/*
+ * Signalled by the ADC interrupt, the controller acts on each block of
+ * samples within microseconds of the last; on its own timer it finds
+ * them, on average, half a sample period old. Both measures must agree.
+ */
+static void
+TestActivationDelay(void)
+{
+    const Delay_t* periodic = &g_delays[0];
+    const Delay_t* event = &g_delays[1];
+
+    g_activation = ACTIVATE_PERIODIC;
+    CheckIsolated(MeasureDelay);
+    g_activation = ACTIVATE_EVENT;
+    CheckIsolated(MeasureDelay);
+
+    printf("control: sample to PWM write delay, mean and worst\n");
+    printf("  periodic  %7.1f %5u us  %4u runs\n", periodic->MeanUs, periodic->MaxUs, periodic->Runs);
+    printf("  event     %7.1f %5u us  %4u runs\n", event->MeanUs, event->MaxUs, event->Runs);
+
+    CHECK_NEAR(periodic->HistMaxUs, periodic->MaxUs, 1);
+    CHECK_NEAR(event->HistMaxUs, event->MaxUs, 1);
+    CHECK(event->MaxUs < 10);
+    CHECK(event->MaxUs * 100 < periodic->MeanUs);
+    CHECK_NEAR(event->Runs, DELAY_SECONDS * KERNEL_RATE_HZ / ADC_TICKS / CONTROL_SAMPLES, 2);
+}
+
+int
+main(void)
+{
+    g_results = mmap(NULL, 2 * sizeof(Rejection_t), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_results == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(g_results, 0, 2 * sizeof(Rejection_t));
+    g_delays = mmap(NULL, 2 * sizeof(Delay_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_delays == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(g_delays, 0, 2 * sizeof(Delay_t));
+
+    TestRejection();
+    TestActivationDelay();
+    return CheckDone("control");
+}
@@ -0,0 +1,179 @@
+/**
+ * @filename: test_feedforward.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Closed loop host simulation of the heli on its rig (rig.h),
+ * flown by the firmware under the kernel through altitude steps, with
+ * the main to tail feedforward in yaw.c and with the firmware's
+ * default, the fixed 40% tail of before it. With --log the telemetry
+ * frames of that flight are written out as a flight log for
+ * tools/fit_feedforward.py (see `make feedforward`).
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+
+#include "host.h"
+#include "check.h"
+#include "tasks.h"
+#include "yaw.h"
+#include "rig.h"
+
+// The feedforward for this rig, set with SetYawFeedforward(): the fit
+// `make feedforward` gives on the flight with yaw.c's defaults (182,
+// 0.506), refitted once on a flight flown with that. Only a model's
+// numbers, yaw.c keeps its defaults until a real rig log is fitted.
+#define RIG_FF_BIAS 121
+#define RIG_FF_GAIN 0.646f
+
+// Flight: switch up at 1 s, UP at each of the first times and DOWN at
+// each of the rest, 10% of height a push
+#define SWITCH_UP_S 1.0
+#define STEPS_FROM_S 12.0
+#define STEP_EVERY_S 6.0
+#define STEPS_UP 5
+#define STEPS_DOWN 4
+#define FLIGHT_S (STEPS_FROM_S + (STEPS_UP + STEPS_DOWN) * STEP_EVERY_S)
+#define PUSH_S 0.2
+
+/*
+ * What one flight saw, kept where the parent process reads it
+ */
+typedef struct {
+    double WorstYaw;    // degrees off the setpoint during the steps
+    double RmsYaw;
+    double FinalHeight;
+    uint32_t LogBytes;
+} Flight_t;
+
+static bool g_feedforward;
+static const char* g_logPath;
+static Flight_t* g_flights;
+
+/*
+ * The switch and buttons at t seconds into the flight
+ */
+static void
+FlightInputs(double t)
+{
+    double since = t - STEPS_FROM_S;
+    bool up = false;
+    bool down = false;
+
+    if (since >= 0 && fmod(since, STEP_EVERY_S) < PUSH_S) {
+        up = since < STEPS_UP * STEP_EVERY_S;
+        down = !up && since < (STEPS_UP + STEPS_DOWN) * STEP_EVERY_S;
+    }
+    RigInputs(t >= SWITCH_UP_S, up, down);
+}
+
+/*
+ * Flies the rig from the ground through the altitude steps. With
+ * g_feedforward the yaw controller has the rig's fitted feedforward,
+ * without it yaw.c's defaults.
+ */
+static void
+Fly(void)
+{
+    Flight_t* flight = &g_flights[g_feedforward ? 1 : 0];
+    uint32_t ticks = (uint32_t)(FLIGHT_S * KERNEL_RATE_HZ);
+    uint32_t steps = 0;
+    double squares = 0;
+    uint32_t tick;
+
+    RigStart(0);
+    if (g_feedforward) {
+        SetYawFeedforward(RIG_FF_BIAS, RIG_FF_GAIN);
+    }
+
+    for (tick = 0; tick < ticks; tick++) {
+        double t = (double)tick / KERNEL_RATE_HZ;
+
+        FlightInputs(t);
+        RigTick();
+
+        if (t >= STEPS_FROM_S) {
+            double yaw = remainder(g_rig.Yaw, 360.0);
+
+            flight->WorstYaw = fmax(flight->WorstYaw, fabs(yaw));
+            squares += yaw * yaw;
+            steps++;
+        }
+    }
+    CHECK(RigFlying());
+
+    flight->RmsYaw = sqrt(squares / steps);
+    flight->FinalHeight = g_rig.Height;
+    flight->LogBytes = g_hostUartWireCount;
+
+    if (g_logPath != NULL && !g_feedforward) {
+        FILE* log = fopen(g_logPath, "wb");
+
+        CHECK(log != NULL);
+        if (log != NULL) {
+            CHECK_EQ(fwrite(g_hostUartWire, 1, g_hostUartWireCount, log), g_hostUartWireCount);
+            fclose(log);
+        }
+    }
+}
+
+static void
+FlyFixedOffset(void)
+{
+    g_feedforward = false;
+    Fly();
+}
+
+static void
+FlyFeedforward(void)
+{
+    g_feedforward = true;
+    Fly();
+}
+
+/*
+ * Both flights must end at the last height, 10%, and the feedforward
+ * must keep the heli at least twice as close to its yaw setpoint
+ * through the steps
+ */
+static void
+TestFeedforward(void)
+{
+    const Flight_t* fixed = &g_flights[0];
+    const Flight_t* forward = &g_flights[1];
+
+    CheckIsolated(FlyFixedOffset);
+    CheckIsolated(FlyFeedforward);
+
+    printf("feedforward: yaw off its setpoint through the altitude steps, worst and rms\n");
+    printf("  fixed offset %5.1f %5.2f degrees\n", fixed->WorstYaw, fixed->RmsYaw);
+    printf("  feedforward  %5.1f %5.2f degrees\n", forward->WorstYaw, forward->RmsYaw);
+
+    CHECK_NEAR(fixed->FinalHeight, (STEPS_UP - STEPS_DOWN) * 10, 2);
+    CHECK_NEAR(forward->FinalHeight, (STEPS_UP - STEPS_DOWN) * 10, 2);
+    CHECK(forward->WorstYaw < fixed->WorstYaw / 2);
+    CHECK(forward->RmsYaw < fixed->RmsYaw / 2);
+    CHECK(forward->LogBytes > 0 && forward->LogBytes < HOST_UART_CAPTURE);
+}
+
+int
+main(int argc, char** argv)
+{
+    g_flights = mmap(NULL, 2 * sizeof(Flight_t), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_flights == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(g_flights, 0, 2 * sizeof(Flight_t));
+
+    if (argc > 2 && strcmp(argv[1], "--log") == 0) {
+        g_logPath = argv[2];
+    }
+    TestFeedforward();
+    return CheckDone("feedforward");
+}
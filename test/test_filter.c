@@ -0,0 +1,216 @@
+/**
+ * @filename: test_filter.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Host tests for filter.c: the delay and noise figures each
+ * filter reports against a ramp and white noise through it, and a
+ * benchmark of the cost per sample and the step response
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "filter.h"
+
+#define SAMPLE_HZ 200
+#define RAMP_SLOPE 256
+#define NOISE_SAMPLES 200000
+
+typedef struct {
+    const char* Name;
+    FilterType_t Type;
+    uint8_t Param;
+    uint8_t MedianTaps;
+} FilterCase_t;
+
+static const FilterCase_t g_cases[] = {
+    {"none",       FILTER_NONE,   0,  0},
+    {"boxcar 24",  FILTER_BOXCAR, 24, 0},
+    {"boxcar 8",   FILTER_BOXCAR, 8,  0},
+    {"iir1 k=2",   FILTER_IIR1,   2,  0},
+    {"iir1 k=3",   FILTER_IIR1,   3,  0},
+    {"iir2 k=2",   FILTER_IIR2,   2,  0},
+    {"cic2 R=4",   FILTER_CIC2,   2,  0},
+    {"cic2 R=8",   FILTER_CIC2,   3,  0},
+    {"median 3",   FILTER_NONE,   0,  3},
+    {"m3+iir1 k=2", FILTER_IIR1,  2,  3},
+    {"m5+boxcar 8", FILTER_BOXCAR, 8, 5},
+};
+
+#define NUM_CASES (sizeof(g_cases) / sizeof(g_cases[0]))
+
+static bool g_bench;
+
+static void
+TestInit(void)
+{
+    Filter_t filter;
+
+    CHECK(!FilterInit(&filter, FILTER_BOXCAR, 0, 0));
+    CHECK(!FilterInit(&filter, FILTER_BOXCAR, FILTER_BOXCAR_MAX + 1, 0));
+    CHECK(!FilterInit(&filter, FILTER_IIR1, 9, 0));
+    CHECK(!FilterInit(&filter, FILTER_CIC2, 0, 0));
+    CHECK(!FilterInit(&filter, FILTER_NONE, 0, 4));
+    CHECK(!FilterInit(&filter, FILTER_NONE, 0, 7));
+    CHECK(FilterInit(&filter, FILTER_BOXCAR, FILTER_BOXCAR_MAX, 5));
+}
+
+/*
+ * Steady state lag behind a ramp, in half samples, measured on the
+ * samples that give an output
+ */
+static uint32_t
+MeasureRampDelay(Filter_t* filter)
+{
+    int32_t lag = 0;
+    int32_t n;
+
+    for (n = 0; n < 2000; n++) {
+        if (FilterPush(filter, n * RAMP_SLOPE) && n >= 1000) {
+            lag = (2 * (n * RAMP_SLOPE - FilterOutput(filter)) + RAMP_SLOPE / 2) / RAMP_SLOPE;
+        }
+    }
+    return lag;
+}
+
+/*
+ * Output noise power over input, Q16, for uniform white noise
+ */
+static uint32_t
+MeasureNoiseGain(Filter_t* filter)
+{
+    double inPower = 0;
+    double outPower = 0;
+    uint32_t outputs = 0;
+    uint32_t n;
+
+    srand(1);
+    for (n = 0; n < NOISE_SAMPLES; n++) {
+        int32_t sample = 10000 + rand() % 2001 - 1000;
+        inPower += (double)(sample - 10000) * (sample - 10000);
+        if (FilterPush(filter, sample) && n >= 1000) {
+            outPower += (double)(FilterOutput(filter) - 10000) * (FilterOutput(filter) - 10000);
+            outputs++;
+        }
+    }
+    return 65536 * (outPower / outputs) / (inPower / NOISE_SAMPLES);
+}
+
+/*
+ * Samples after a step until the output is half way, from the sample
+ * that carries the step
+ */
+static uint32_t
+MeasureStepDelay(Filter_t* filter)
+{
+    uint32_t n;
+
+    for (n = 0; n < 100; n++) {
+        FilterPush(filter, 0);
+    }
+    for (n = 0; n < 1000; n++) {
+        FilterPush(filter, 10000);
+        if (FilterOutput(filter) >= 5000) {
+            break;
+        }
+    }
+    return n;
+}
+
+/*
+ * The delay each linear filter reports must be the lag it gives a
+ * ramp, and its noise figure what it does to white noise. A median
+ * adds (taps - 1) / 2 samples of delay to a ramp.
+ */
+static void
+TestFigures(const FilterCase_t* c)
+{
+    Filter_t filter;
+    uint32_t halfSampleUs = 500000 / SAMPLE_HZ;
+    uint32_t reported, measured;
+
+    CHECK(FilterInit(&filter, c->Type, c->Param, c->MedianTaps));
+    reported = FilterDelayUs(&filter, SAMPLE_HZ);
+    measured = MeasureRampDelay(&filter);
+    CHECK_NEAR(measured * halfSampleUs, reported, halfSampleUs);
+
+    if (c->MedianTaps == 0) {
+        uint32_t gain = FilterNoiseGain(&filter);
+        CHECK(FilterInit(&filter, c->Type, c->Param, 0));
+        CHECK_NEAR(MeasureNoiseGain(&filter), gain, gain / 20 + 64);
+    }
+}
+
+/*
+ * A single sample spike doesn't get past a 3 tap median at all
+ */
+static void
+TestMedianSpike(void)
+{
+    Filter_t filter;
+    uint32_t n;
+    bool moved = false;
+
+    CHECK(FilterInit(&filter, FILTER_NONE, 0, 3));
+    for (n = 0; n < 20; n++) {
+        FilterPush(&filter, (n == 10) ? 4000 : 1000);
+        moved |= FilterOutput(&filter) != 1000;
+    }
+    CHECK(!moved);
+}
+
+/*
+ * ns per sample, the reported and measured delays and the step
+ * response's half way point for each filter
+ */
+static void
+BenchFilters(void)
+{
+    const uint32_t samples = 2000000;
+    uint32_t i, n;
+
+    printf("%-12s %8s %10s %10s %10s %9s\n", "filter", "ns/smp", "delay us", "ramp us", "step 50%", "noise");
+    for (i = 0; i < NUM_CASES; i++) {
+        const FilterCase_t* c = &g_cases[i];
+        Filter_t filter;
+        uint64_t start;
+        uint32_t delay, ramp, step, noise;
+
+        FilterInit(&filter, c->Type, c->Param, c->MedianTaps);
+        start = BenchNs();
+        for (n = 0; n < samples; n++) {
+            FilterPush(&filter, 2000 + (n & 63));
+        }
+        double ns = (double)(BenchNs() - start) / samples;
+
+        delay = FilterDelayUs(&filter, SAMPLE_HZ);
+        FilterInit(&filter, c->Type, c->Param, c->MedianTaps);
+        ramp = MeasureRampDelay(&filter) * 500000 / SAMPLE_HZ;
+        FilterInit(&filter, c->Type, c->Param, c->MedianTaps);
+        step = MeasureStepDelay(&filter) * 1000000 / SAMPLE_HZ;
+        FilterInit(&filter, c->Type, c->Param, c->MedianTaps);
+        noise = MeasureNoiseGain(&filter);
+        printf("%-12s %8.1f %10u %10u %10u %9.3f\n", c->Name, ns, delay, ramp, step, noise / 65536.0);
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    uint32_t i;
+
+    g_bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    TestInit();
+    for (i = 0; i < NUM_CASES; i++) {
+        TestFigures(&g_cases[i]);
+    }
+    TestMedianSpike();
+    if (g_bench) {
+        BenchFilters();
+    }
+    return CheckDone("filter");
+}
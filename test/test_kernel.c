@@ -0,0 +1,794 @@
+/**
+ * @filename: test_kernel.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Host tests for kernel.c on the stand-in clock, ticks every
+ * CYCLES_PER_TICK cycles from cycle 0
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "host.h"
+#include "check.h"
+#include "kernel.h"
+#include "tasks.h"
+#include "schedule.h"
+
+#define RATE_HZ 2000
+#define CYCLES_PER_TICK (HOST_CLOCK_HZ / RATE_HZ)
+#define CYCLES_PER_US (HOST_CLOCK_HZ / 1000000)
+
+#define DUMP_LINES 8
+#define DUMP_LINE_SIZE 80
+
+static uint32_t g_backgroundRuns;
+static uint32_t g_backgroundLong;
+static char g_dump[DUMP_LINES][DUMP_LINE_SIZE];
+static uint32_t g_dumpLines;
+
+// Dispatch run, set before each TestDispatch
+static bool g_bench;
+static uint32_t g_dispatchTasks;
+static uint32_t g_dispatchPeriod;
+static uint32_t g_dispatchTicks;
+static SchedPolicy_t g_dispatchPolicy;
+static uint32_t g_dispatchRuns;
+
+/*
+ * Runs the background loop at cycle, if that is still to come
+ */
+static void
+PollAt(uint32_t cycle)
+{
+    int32_t wait = (int32_t)(cycle - HostCycles());
+
+    if (wait > 0) {
+        HostAdvance(wait);
+    }
+    RunKernel();
+}
+
+/*
+ * 1000 then 2000 cycles, or g_backgroundLong once when set
+ */
+static void
+BackgroundTask(void)
+{
+    if (g_backgroundLong) {
+        HostAdvance(g_backgroundLong);
+        g_backgroundLong = 0;
+    } else {
+        HostAdvance(1000 * (1 + g_backgroundRuns % 2));
+    }
+    g_backgroundRuns++;
+}
+
+static void
+ForegroundTask(void)
+{
+    HostAdvance(500);
+}
+
+static void
+DumpLine(const char* line)
+{
+    if (g_dumpLines < DUMP_LINES) {
+        strncpy(g_dump[g_dumpLines++], line, DUMP_LINE_SIZE - 1);
+    }
+}
+
+/*
+ * A 4 tick background task polled 1000, 2000 or 3000 cycles after its
+ * release tick (latency runs from the tick interrupt's entry), behind a 2 tick foreground task that runs in the tick
+ * interrupt, then one background run over two ticks long
+ */
+static void
+TestTaskStats(void)
+{
+    TaskHandle_t background;
+    TaskHandle_t foreground;
+    TaskStats_t stats;
+    uint32_t tick;
+
+    InitKernel(RATE_HZ);
+    foreground = AddTask(ForegroundTask, 2, 0, 1, 50, OVERRUN_REALIGN, TIER_FOREGROUND, ACTIVATE_PERIODIC);
+    background = AddTask(BackgroundTask, 4, 1, 1, 200, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_PERIODIC);
+    CHECK(foreground != NULL);
+    CHECK(background != NULL);
+
+    for (tick = 1; tick <= 48; tick++) {
+        PollAt(tick * CYCLES_PER_TICK + 1000 * (1 + (tick / 4) % 3));
+    }
+
+    CHECK(GetTaskStats(background, &stats));
+    CHECK_EQ(stats.Runs, 12);
+    CHECK_EQ(stats.MinCycles, 1000);
+    CHECK_EQ(stats.MaxCycles, 2000);
+    CHECK_EQ(stats.TotalCycles, 12 * 1500);
+    CHECK_EQ(stats.MinLatency, 1000 - HOST_IRQ_ENTRY_CYCLES);
+    CHECK_EQ(stats.MaxLatency, 3000 - HOST_IRQ_ENTRY_CYCLES);
+    CHECK_EQ(stats.TotalLatency, 12 * (2000 - HOST_IRQ_ENTRY_CYCLES));
+    CHECK_EQ(stats.Overruns, 0);
+
+    CHECK(GetTaskStats(foreground, &stats));
+    CHECK_EQ(stats.Runs, 24);
+    CHECK_EQ(stats.MinCycles, 500);
+    CHECK_EQ(stats.MaxCycles, 500);
+    CHECK_EQ(stats.MinLatency, 0);
+    CHECK_EQ(stats.MaxLatency, 0);
+
+    DumpTaskStats(DumpLine);
+    CHECK_EQ(g_dumpLines, 4);
+    CHECK(strcmp(g_dump[1], "0\t2\t24\t25/25/25\t0/0/0\t0\t0\t0\t0\r\n") == 0);
+    CHECK(strcmp(g_dump[2], "1\t4\t12\t50/75/100\t49/99/149\t100\t0\t0\t0\r\n") == 0);
+    CHECK(strcmp(g_dump[3], "missed ticks: 0\r\n") == 0);
+
+    // Tick 52's run takes 25000 cycles, past ticks 53 and 54, so the
+    // loop sees tick 54 right after it and misses 53
+    ResetTaskStats();
+    g_backgroundLong = 25000;
+    for (tick = 49; tick <= 60; tick++) {
+        PollAt(tick * CYCLES_PER_TICK + 1000);
+    }
+
+    CHECK(GetTaskStats(background, &stats));
+    CHECK_EQ(stats.Runs, 3);
+    CHECK_EQ(stats.MaxCycles, 25000);
+    CHECK_EQ(stats.Overruns, 1);
+    CHECK_EQ(GetMissedTicks(), 1);
+
+    CHECK(GetTaskStats(foreground, &stats));
+    CHECK_EQ(stats.Runs, 6);
+    CHECK_EQ(stats.MaxLatency, 0);
+}
+
+static TaskHandle_t g_eventTask;
+static uint32_t g_eventRuns;
+static uint32_t g_tickErrors;
+static uint32_t g_sleepRuns;
+
+/*
+ * The kernel's tick count against the time since the first tick
+ */
+static void
+CheckTickTime(void)
+{
+    if (GetTickCount() != HostCycles() / CYCLES_PER_TICK) {
+        g_tickErrors++;
+    }
+}
+
+static void
+SleepyTask(void)
+{
+    CheckTickTime();
+    g_sleepRuns++;
+    HostAdvance(300);
+}
+
+static void
+EventTask(void)
+{
+    CheckTickTime();
+    g_eventRuns++;
+}
+
+static void
+WakeHandler(void)
+{
+    TaskSignal(g_eventTask);
+}
+
+/*
+ * Tickless idle with one 20 tick background task, a 50 tick foreground
+ * task and an event task signalled by another interrupt between ticks.
+ * The loop must sleep from release to release, SysTick must only fire
+ * to end a sleep, and the tick count must match the time on every run.
+ */
+static void
+TestTicklessIdle(void)
+{
+    TaskHandle_t background;
+    TaskHandle_t foreground;
+    TaskStats_t stats;
+    uint32_t ticks = 2000;
+    uint32_t wakes = 0;
+
+    InitKernel(RATE_HZ);
+    SetTicklessIdle(true);
+    background = AddTask(SleepyTask, 20, 0, 1, 200, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_PERIODIC);
+    foreground = AddTask(ForegroundTask, 50, 0, 1, 50, OVERRUN_REALIGN, TIER_FOREGROUND, ACTIVATE_PERIODIC);
+    g_eventTask = AddTask(EventTask, 20, 1, 1, 20, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_EVENT);
+    CHECK(background != NULL && foreground != NULL && g_eventTask != NULL);
+    // Off the tick edge, as the loop always is on the board
+    HostAdvance(100);
+
+    // To half a tick past the last, so its runs are in
+    while (HostCycles() < ticks * CYCLES_PER_TICK + CYCLES_PER_TICK / 2) {
+        // Another interrupt every 137.3 ticks, landing anywhere in a tick
+        if (wakes * 1373 * CYCLES_PER_TICK / 10 <= HostCycles()) {
+            HostWakeAfter((wakes + 1) * 1373 * CYCLES_PER_TICK / 10 - HostCycles(), WakeHandler);
+            wakes++;
+        }
+        RunKernel();
+    }
+
+    CHECK_EQ(g_tickErrors, 0);
+    CHECK_EQ(GetMissedTicks(), 0);
+    CHECK_EQ(g_sleepRuns, ticks / 20);
+    CHECK_EQ(g_eventRuns, wakes - 1);
+
+    // Each run starts on the first pass after its wake up
+    CHECK(GetTaskStats(background, &stats));
+    CHECK(stats.MaxLatency < CYCLES_PER_TICK / 10);
+    CHECK(GetTaskStats(foreground, &stats));
+    CHECK_EQ(stats.Runs, ticks / 50);
+    CHECK_EQ(stats.MaxLatency, 0);
+    CHECK(GetTaskStats(g_eventTask, &stats));
+    CHECK(stats.MaxLatency < CYCLES_PER_TICK / 10);
+
+    // One SysTick per release tick (both periodic tasks share every
+    // 100th), not one per tick, and the CPU asleep nearly all the time
+    CHECK(g_hostSysTicks <= ticks / 20 + ticks / 50 - ticks / 100 + 1);
+    CHECK(g_hostWfiCycles > (uint64_t)HostCycles() * 9 / 10);
+
+    if (g_bench) {
+        printf("tickless: %u SysTick interrupts and %u sleeps in %u ticks, asleep %.1f%%\n",
+               g_hostSysTicks, g_hostWfiCount, ticks,
+               100.0 * g_hostWfiCycles / HostCycles());
+    }
+}
+
+static TaskHandle_t g_pendTask;
+static uint32_t g_pendSignals;
+static uint32_t g_pendRuns;
+static uint32_t g_pendStarts[4];
+static uint32_t g_pendWakes[4];
+
+static void
+PendTask(void)
+{
+    if (g_pendRuns < 4) {
+        g_pendStarts[g_pendRuns] = HostCycles();
+    }
+    g_pendRuns++;
+}
+
+/*
+ * Another interrupt signalling the task g_pendSignals times
+ */
+static void
+PendWake(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < g_pendSignals; i++) {
+        TaskSignal(g_pendTask);
+    }
+}
+
+/*
+ * A foreground event task runs from PendSV as soon as the interrupt
+ * that signalled it returns, between ticks and with no background loop
+ * running. Signals before it runs merge into one run and count as
+ * missed; a disabled task ignores them.
+ */
+static void
+TestForegroundEvent(void)
+{
+    TaskHandle_t foreground;
+    TaskStats_t stats;
+    uint32_t i;
+
+    InitKernel(RATE_HZ);
+    foreground = AddTask(ForegroundTask, 2, 0, 1, 50, OVERRUN_REALIGN, TIER_FOREGROUND, ACTIVATE_PERIODIC);
+    g_pendTask = AddTask(PendTask, 20, 1, 1, 20, OVERRUN_REALIGN, TIER_FOREGROUND, ACTIVATE_EVENT);
+    CHECK(foreground != NULL && g_pendTask != NULL);
+
+    // Signalled a third of the way into ticks 3, 10, 11 and 20
+    g_pendSignals = 1;
+    for (i = 0; i < 4; i++) {
+        static const uint32_t ticks[4] = {3, 10, 11, 20};
+
+        g_pendWakes[i] = ticks[i] * CYCLES_PER_TICK + CYCLES_PER_TICK / 3;
+        HostWakeAfter(g_pendWakes[i] - HostCycles(), PendWake);
+        HostAdvance(g_pendWakes[i] - HostCycles() + CYCLES_PER_TICK / 3);
+        CHECK_EQ(g_pendRuns, i + 1);
+        CHECK_EQ(g_pendStarts[i], g_pendWakes[i] + 2 * HOST_IRQ_ENTRY_CYCLES);
+    }
+    CHECK(GetTaskStats(g_pendTask, &stats));
+    CHECK_EQ(stats.Runs, 4);
+    CHECK_EQ(stats.MaxLatency, HOST_IRQ_ENTRY_CYCLES);
+    CHECK_EQ(stats.Missed, 0);
+
+    // Three signals in one interrupt, one run
+    g_pendSignals = 3;
+    HostWakeAfter(CYCLES_PER_TICK / 2, PendWake);
+    HostAdvance(CYCLES_PER_TICK);
+    CHECK_EQ(g_pendRuns, 5);
+    CHECK(GetTaskStats(g_pendTask, &stats));
+    CHECK_EQ(stats.Missed, 2);
+
+    TaskDisable(g_pendTask);
+    g_pendSignals = 1;
+    HostWakeAfter(CYCLES_PER_TICK / 2, PendWake);
+    HostAdvance(CYCLES_PER_TICK);
+    CHECK_EQ(g_pendRuns, 5);
+
+    // The periodic foreground task kept every release meanwhile
+    CHECK(GetTaskStats(foreground, &stats));
+    CHECK_EQ(stats.Runs, GetTickCount() / 2);
+}
+
+static void
+CountingTask(void)
+{
+    g_dispatchRuns++;
+}
+
+/*
+ * g_dispatchTasks best effort tasks of g_dispatchPeriod ticks, phases
+ * spread, for g_dispatchTicks ticks. Every release on the grid from
+ * one period on must run once. Prints RunKernel's cost per tick when
+ * benchmarking.
+ */
+static void
+TestDispatch(void)
+{
+    uint64_t dispatchNs = 0;
+    uint32_t expected = 0;
+    uint32_t statsRuns = 0;
+    uint32_t tick;
+    uint8_t i;
+
+    InitKernel(RATE_HZ);
+    CHECK(SetSchedPolicy(g_dispatchPolicy));
+    for (i = 0; i < g_dispatchTasks; i++) {
+        CHECK(AddTask(CountingTask, g_dispatchPeriod, i, 1, 0, OVERRUN_REALIGN,
+                      TIER_BACKGROUND, ACTIVATE_PERIODIC) != NULL);
+    }
+    AssignPhases();
+
+    for (tick = 1; tick <= g_dispatchTicks; tick++) {
+        HostAdvance(CYCLES_PER_TICK);
+        uint64_t start = BenchNs();
+        RunKernel();
+        dispatchNs += BenchNs() - start;
+    }
+
+    for (i = 0; i < g_dispatchTasks; i++) {
+        TaskHandle_t task = GetTask(i);
+        TaskStats_t stats;
+        uint32_t first = g_dispatchPeriod + task->Phase;
+
+        expected += (g_dispatchTicks >= first) ? (g_dispatchTicks - first) / g_dispatchPeriod + 1 : 0;
+        GetTaskStats(task, &stats);
+        statsRuns += stats.Runs;
+    }
+    CHECK_EQ(g_dispatchRuns, expected);
+    CHECK_EQ(statsRuns, expected);
+    CHECK_EQ(GetMissedTicks(), 0);
+
+    if (g_bench) {
+        printf("%-8s %2u tasks every %2u ticks: %6.1f ns per tick, %5.2f runs per tick\n",
+               g_dispatchPolicy == SCHED_EDF ? "edf" : "priority", g_dispatchTasks, g_dispatchPeriod,
+               (double)dispatchNs / g_dispatchTicks, (double)expected / g_dispatchTicks);
+    }
+}
+
+// Overrun run: the task under test, its release at each run and the
+// tick it ran on
+#define STALL_PERIOD 10
+#define STALL_TICKS 35
+#define STALL_RUNS 8
+static TaskHandle_t g_stallTask;
+static uint32_t g_stallRuns;
+static uint32_t g_stallReleases[STALL_RUNS];
+static uint32_t g_stallTicks[STALL_RUNS];
+
+/*
+ * Records its release and tick, and its second run stalls for
+ * STALL_TICKS ticks, past three more releases
+ */
+static void
+StallingTask(void)
+{
+    if (g_stallRuns < STALL_RUNS) {
+        g_stallReleases[g_stallRuns] = g_stallTask->Release;
+        g_stallTicks[g_stallRuns] = GetTickCount();
+    }
+    if (++g_stallRuns == 2) {
+        HostAdvance(STALL_TICKS * CYCLES_PER_TICK);
+    }
+}
+
+/*
+ * Runs a STALL_PERIOD tick background task under overrun to tick 80
+ * and returns its stats
+ */
+static TaskStats_t
+RunStalled(OverrunPolicy_t overrun)
+{
+    TaskStats_t stats;
+
+    InitKernel(RATE_HZ);
+    g_stallTask = AddTask(StallingTask, STALL_PERIOD, 0, 1, 0, overrun, TIER_BACKGROUND, ACTIVATE_PERIODIC);
+    CHECK(g_stallTask != NULL);
+    while (GetTickCount() < 80) {
+        HostAdvance(CYCLES_PER_TICK);
+        RunKernel();
+    }
+    CHECK(GetTaskStats(g_stallTask, &stats));
+    return stats;
+}
+
+/*
+ * Checks the releases and ticks of the first runs runs of RunStalled
+ */
+static void
+CheckStallRuns(const uint32_t* releases, const uint32_t* ticks, uint32_t runs)
+{
+    uint32_t i;
+
+    CHECK_EQ(g_stallRuns, runs);
+    for (i = 0; i < runs; i++) {
+        CHECK_EQ(g_stallReleases[i], releases[i]);
+        CHECK_EQ(g_stallTicks[i], ticks[i]);
+    }
+}
+
+/*
+ * The run released at 20 stalls to tick 55, and the loop next sees
+ * tick 56 with the release of 30 waiting. REALIGN runs it late once,
+ * counts 40 and 50 as missed and goes on from 60.
+ */
+static void
+TestOverrunRealign(void)
+{
+    static const uint32_t releases[] = {10, 20, 30, 60, 70, 80};
+    static const uint32_t ticks[] = {10, 20, 56, 60, 70, 80};
+    TaskStats_t stats = RunStalled(OVERRUN_REALIGN);
+
+    CheckStallRuns(releases, ticks, 6);
+    CHECK_EQ(stats.Runs, 6);
+    CHECK_EQ(stats.Missed, 2);
+    CHECK_EQ(stats.Dropped, 0);
+}
+
+/*
+ * CATCH_UP runs 30, 40 and 50 on successive ticks, missing nothing,
+ * and is back on the grid at 60
+ */
+static void
+TestOverrunCatchUp(void)
+{
+    static const uint32_t releases[] = {10, 20, 30, 40, 50, 60, 70, 80};
+    static const uint32_t ticks[] = {10, 20, 56, 57, 58, 60, 70, 80};
+    TaskStats_t stats = RunStalled(OVERRUN_CATCH_UP);
+
+    CheckStallRuns(releases, ticks, 8);
+    CHECK_EQ(stats.Runs, 8);
+    CHECK_EQ(stats.Missed, 0);
+    CHECK_EQ(stats.Dropped, 0);
+}
+
+/*
+ * DROP skips the release of 30, a whole period late, counts 40 and 50
+ * as missed and runs next at 60
+ */
+static void
+TestOverrunDrop(void)
+{
+    static const uint32_t releases[] = {10, 20, 60, 70, 80};
+    static const uint32_t ticks[] = {10, 20, 60, 70, 80};
+    TaskStats_t stats = RunStalled(OVERRUN_DROP);
+
+    CheckStallRuns(releases, ticks, 5);
+    CHECK_EQ(stats.Runs, 5);
+    CHECK_EQ(stats.Missed, 2);
+    CHECK_EQ(stats.Dropped, 1);
+}
+
+// Ticks main.c's tasks ran on over two major frames from the second,
+// under the timing wheel and under the cyclic executive
+#define RELEASE_FROM CYCLIC_MAJOR_TICKS
+#define RELEASE_TO (3 * CYCLIC_MAJOR_TICKS)
+#define RELEASE_MAX ((RELEASE_TO - RELEASE_FROM) / CONTROL_TICKS)
+
+typedef struct {
+    uint16_t Ticks[NUM_TASKS][RELEASE_MAX];
+    uint16_t Runs[NUM_TASKS];
+} Releases_t;
+
+static Releases_t* g_releases;
+static Releases_t* g_recording;
+
+static void
+RecordRun(uint8_t id)
+{
+    uint32_t tick = GetTickCount();
+
+    if (g_recording && tick >= RELEASE_FROM && tick < RELEASE_TO && g_recording->Runs[id] < RELEASE_MAX) {
+        g_recording->Ticks[id][g_recording->Runs[id]++] = tick;
+    }
+}
+
+// main.c's task set from tasks.h, on functions that only record when
+// they run
+#define TASK_FUNCTION(function, ticks, priority, state, wcet, overrun, tier, activation) \
+    static void Main##function(void) { RecordRun(function##_ID); }
+TASK_TABLE(TASK_FUNCTION)
+
+#define TASK_CONFIG(function, ticks, priority, state, wcet, overrun, tier, activation) \
+    {Main##function, ticks, priority, state, wcet, overrun, tier, activation},
+static const TaskConfig_t g_mainTable[NUM_TASKS] = {
+    TASK_TABLE(TASK_CONFIG)
+};
+
+/*
+ * main.c's task set, phased by AssignPhases(), loads its worst tick
+ * with 500 us and the mean tick with 37 us, as tools/gen_schedule.py
+ * works out for tasks.h. Moving the display task, best effort and so
+ * counted as a whole tick, onto the UART task's phase by hand adds the
+ * UART task's 500 us to that tick.
+ */
+static void
+TestTickLoad(void)
+{
+    TaskHandle_t display;
+    TaskHandle_t uart;
+    uint32_t peak, mean;
+
+    InitKernel(KERNEL_RATE_HZ);
+    CHECK(SetSchedPolicy(SCHED_RATE_MONOTONIC));
+    CHECK(AddTaskTable(g_mainTable, NUM_TASKS));
+    AssignPhases();
+    GetTickLoad(&peak, &mean);
+    CHECK_EQ(peak, 500);
+    CHECK_EQ(mean, 37);
+
+    display = GetTask(DisplayTask_ID);
+    uart = GetTask(UARTTask_ID);
+    CHECK(display->Phase != uart->Phase);
+    SetTaskPhase(display, uart->Phase + DISPLAY_TICKS);
+    CHECK_EQ(display->Phase, uart->Phase);
+    GetTickLoad(&peak, &mean);
+    CHECK_EQ(peak, 1000000 / KERNEL_RATE_HZ + UART_WCET_US);
+    CHECK_EQ(mean, 37);
+}
+
+/*
+ * Runs main.c's task set, every task enabled, to RELEASE_TO under the
+ * timing wheel or under schedule.h's cyclic executive
+ */
+static void
+RunMainTable(bool cyclic)
+{
+    uint8_t i;
+
+    g_recording = &g_releases[cyclic];
+    InitKernel(KERNEL_RATE_HZ);
+    CHECK(SetSchedPolicy(SCHED_RATE_MONOTONIC));
+    CHECK(AddTaskTable(g_mainTable, NUM_TASKS));
+    AssignPhases();
+    for (i = 0; i < NUM_TASKS; i++) {
+        TaskEnable(GetTask(i));
+    }
+    if (cyclic) {
+        CHECK(UseCyclicSchedule(g_cyclicSchedule, CYCLIC_NUM_FRAMES, CYCLIC_MAJOR_TICKS));
+    }
+
+    while (GetTickCount() < RELEASE_TO) {
+        HostAdvance(CYCLES_PER_TICK);
+        RunKernel();
+    }
+}
+
+static void
+RunWheel(void)
+{
+    RunMainTable(false);
+}
+
+static void
+RunCyclic(void)
+{
+    RunMainTable(true);
+}
+
+/*
+ * schedule.h, generated by tools/gen_schedule.py, must release every
+ * task on the ticks the timing wheel does with AssignPhases()'s phases,
+ * once the first releases are past. A 7 tick background task doesn't
+ * divide the 3000 tick major frame, and the kernel refuses the schedule
+ * and stays on the wheel.
+ */
+static void
+TestCyclicSchedule(void)
+{
+    uint32_t mismatches = 0;
+    uint8_t id;
+    uint16_t n;
+
+    CheckIsolated(RunWheel);
+    CheckIsolated(RunCyclic);
+
+    for (id = 0; id < NUM_TASKS; id++) {
+        CHECK_EQ(g_releases[1].Runs[id], g_releases[0].Runs[id]);
+        for (n = 0; n < g_releases[0].Runs[id]; n++) {
+            if (g_releases[1].Ticks[id][n] != g_releases[0].Ticks[id][n]) {
+                mismatches++;
+            }
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(g_releases[0].Runs[ControlTask_ID], RELEASE_MAX);
+    CHECK_EQ(g_releases[0].Runs[SetPointTask_ID], (RELEASE_TO - RELEASE_FROM) / SETPOINT_TICKS);
+    CHECK_EQ(g_releases[0].Runs[GroundRefTask_ID], (RELEASE_TO - RELEASE_FROM) / GND_TICKS);
+}
+
+static void
+TestCyclicRefused(void)
+{
+    TaskHandle_t task;
+    TaskStats_t stats;
+
+    InitKernel(RATE_HZ);
+    task = AddTask(CountingTask, 7, 0, 1, 0, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_PERIODIC);
+    CHECK(task != NULL);
+    CHECK(!UseCyclicSchedule(g_cyclicSchedule, CYCLIC_NUM_FRAMES, CYCLIC_MAJOR_TICKS));
+    CHECK(!UseCyclicSchedule(g_cyclicSchedule, 0, CYCLIC_MAJOR_TICKS));
+    CHECK(!UseCyclicSchedule(g_cyclicSchedule, CYCLIC_NUM_FRAMES, 0));
+
+    while (GetTickCount() < 70) {
+        HostAdvance(CYCLES_PER_TICK);
+        RunKernel();
+    }
+    CHECK(GetTaskStats(task, &stats));
+    CHECK_EQ(stats.Runs, 10);
+}
+
+// At 2000 Hz (500 us ticks): a 1 ms foreground task of 100 us and
+// background tasks of 5, 20 and 50 ms taking 400, 1000 and 2000 us
+static const TaskConfig_t g_admitTable[] = {
+    {CountingTask, 2, 0, 1, 100, OVERRUN_REALIGN, TIER_FOREGROUND, ACTIVATE_PERIODIC},
+    {CountingTask, 10, 3, 1, 400, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_PERIODIC},
+    {CountingTask, 40, 2, 1, 1000, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_PERIODIC},
+    {CountingTask, 100, 1, 1, 2000, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_PERIODIC},
+};
+
+/*
+ * Admission under rate monotonic, response times worked by hand from
+ * R = tick + w + C (see FixedPrioritySchedulable), then a 10 ms task of
+ * 4000 us that the set can't take:
+ *   5 ms:  B = 2000, w = 2000 + 3 * 100 = 2300, R = 500 + 2300 + 400 = 3200
+ *   20 ms: B = 2000, w = 2000 + 4 * 100 + 400 = 2800, R = 4300
+ *   50 ms: B = 0, w = 4 * 100 + 400 + 1000 = 1800, R = 4300
+ *   with the 10 ms task the 5 ms one blocks for 4000:
+ *          w = 4000 + 5 * 100 = 4500, R = 5400 > 5000
+ * A foreground task's response is the whole tick interrupt, 100 us.
+ */
+static void
+TestAdmissionRM(void)
+{
+    TaskHandle_t added;
+
+    InitKernel(RATE_HZ);
+    CHECK(SetSchedPolicy(SCHED_RATE_MONOTONIC));
+    CHECK(AddTaskTable(g_admitTable, 4));
+    CHECK_EQ(GetTaskResponseTime(GetTask(0)), 100);
+    CHECK_EQ(GetTaskResponseTime(GetTask(1)), 3200);
+    CHECK_EQ(GetTaskResponseTime(GetTask(2)), 4300);
+    CHECK_EQ(GetTaskResponseTime(GetTask(3)), 4300);
+
+    // Refused, and the set is as it was
+    CHECK(AddTask(CountingTask, 20, 0, 1, 4000, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_PERIODIC) == NULL);
+    CHECK_EQ(GetTaskResponseTime(GetTask(1)), 3200);
+    CHECK_EQ(GetTaskResponseTime(GetTask(3)), 4300);
+
+    // Foreground tasks past a tick between them, 100 + 450 us
+    CHECK(AddTask(CountingTask, 4, 0, 1, 450, OVERRUN_REALIGN, TIER_FOREGROUND, ACTIVATE_PERIODIC) == NULL);
+
+    // Nothing refused is kept: the next task added is GetTask(4)
+    added = AddTask(CountingTask, 200, 0, 1, 100, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_PERIODIC);
+    CHECK(added != NULL);
+    CHECK(added == GetTask(4));
+}
+
+/*
+ * The same set under EDF: U = 0.1 + 0.08 + 0.05 + 0.04 = 0.27 and
+ * Cmax / Tmin = 2000 / 5000, 0.67 in all, each background response
+ * bounded by its period. The 10 ms task of 4000 us makes it
+ * 0.67 + 0.8 = 1.47 and is refused. So is the set from empty, with a
+ * whole table of it added at once.
+ */
+static void
+TestAdmissionEDF(void)
+{
+    TaskConfig_t table[5];
+
+    InitKernel(RATE_HZ);
+    CHECK(SetSchedPolicy(SCHED_EDF));
+    CHECK(AddTaskTable(g_admitTable, 4));
+    CHECK_EQ(GetTaskResponseTime(GetTask(0)), 100);
+    CHECK_EQ(GetTaskResponseTime(GetTask(1)), 5000);
+    CHECK_EQ(GetTaskResponseTime(GetTask(2)), 20000);
+    CHECK_EQ(GetTaskResponseTime(GetTask(3)), 50000);
+
+    CHECK(AddTask(CountingTask, 20, 0, 1, 4000, OVERRUN_REALIGN, TIER_BACKGROUND, ACTIVATE_PERIODIC) == NULL);
+    CHECK_EQ(GetTaskResponseTime(GetTask(1)), 5000);
+
+    InitKernel(RATE_HZ);
+    CHECK(SetSchedPolicy(SCHED_EDF));
+    memcpy(table, g_admitTable, sizeof(g_admitTable));
+    table[4] = table[1];
+    table[4].NumTicks = 20;
+    table[4].WcetUs = 4000;
+    CHECK(!AddTaskTable(table, 5));
+    CHECK(AddTaskTable(g_admitTable, 4));
+    CHECK_EQ(GetTaskResponseTime(GetTask(3)), 50000);
+}
+
+static void
+RunDispatch(SchedPolicy_t policy, uint32_t tasks, uint32_t period, uint32_t ticks)
+{
+    g_dispatchPolicy = policy;
+    g_dispatchTasks = tasks;
+    g_dispatchPeriod = period;
+    g_dispatchTicks = ticks;
+    CheckIsolated(TestDispatch);
+}
+
+/*
+ * Dispatch cost per tick against the task count, for tasks due every
+ * tick and for tasks spread over 16 ticks
+ */
+static void
+BenchDispatch(void)
+{
+    static const uint32_t counts[] = {1, 2, 4, 8, 16, 24, MAXTASKS};
+    static const uint32_t periods[] = {1, 16};
+    uint32_t p, c;
+
+    for (p = 0; p < sizeof(periods) / sizeof(periods[0]); p++) {
+        for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            RunDispatch(SCHED_PRIORITY, counts[c], periods[p], 200000);
+            RunDispatch(SCHED_EDF, counts[c], periods[p], 200000);
+        }
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    g_bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+    g_releases = mmap(NULL, 2 * sizeof(Releases_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_releases == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(g_releases, 0, 2 * sizeof(Releases_t));
+
+    CheckIsolated(TestTaskStats);
+    CheckIsolated(TestTicklessIdle);
+    CheckIsolated(TestForegroundEvent);
+    CheckIsolated(TestAdmissionRM);
+    CheckIsolated(TestAdmissionEDF);
+    CheckIsolated(TestTickLoad);
+    TestCyclicSchedule();
+    CheckIsolated(TestCyclicRefused);
+    CheckIsolated(TestOverrunRealign);
+    CheckIsolated(TestOverrunCatchUp);
+    CheckIsolated(TestOverrunDrop);
+    RunDispatch(SCHED_PRIORITY, 1, 1, 1000);
+    RunDispatch(SCHED_PRIORITY, MAXTASKS, 5, 1000);
+    RunDispatch(SCHED_EDF, MAXTASKS, 16, 1000);
+    if (g_bench) {
+        BenchDispatch();
+    }
+    return CheckDone("kernel");
+}
@@ -0,0 +1,228 @@
+/**
+ * @filename: test_motors.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Host tests for Motors.c, what reaches the PWM stand-in:
+ * repeats skipped, widths, synchronised updates, masking, the period
+ * written once, and the latency histograms
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "host.h"
+#include "check.h"
+#include "motors.h"
+
+// As in Motors.c, 200 Hz from the system clock
+#define PWM_PERIOD (HOST_CLOCK_HZ / 200)
+#define PWM_MAIN_OUTNUM PWM_OUT_7
+#define PWM_TAIL_OUTNUM PWM_OUT_5
+
+#define CYCLES_PER_US (HOST_CLOCK_HZ / 1000000)
+
+static HostPwm_t*
+MainPwm(void)
+{
+    return HostPwm(PWM0_BASE, PWM_MAIN_OUTNUM);
+}
+
+static HostPwm_t*
+TailPwm(void)
+{
+    return HostPwm(PWM1_BASE, PWM_TAIL_OUTNUM);
+}
+
+/*
+ * Both outputs written once at 0, the period once per generator
+ */
+static void
+TestInit(void)
+{
+    InitMotors();
+
+    CHECK_EQ(HostPwmPeriodWrites(), 2);
+    CHECK_EQ(MainPwm()->Width, 0);
+    CHECK_EQ(MainPwm()->Writes, 1);
+    CHECK_EQ(MainPwm()->SyncUpdates, 1);
+    CHECK_EQ(TailPwm()->Width, 0);
+    CHECK_EQ(TailPwm()->Writes, 1);
+    CHECK_EQ(TailPwm()->SyncUpdates, 1);
+    CHECK_EQ(GetMotorDuty(MOTOR_MAIN), 0);
+}
+
+/*
+ * A write reaches the register only when its width changes, each with
+ * a sync update, and never with interrupts enabled
+ */
+static void
+TestWrites(void)
+{
+    uint32_t n;
+
+    InitMotors();
+
+    SetMotorDuties(500, 300);
+    CHECK_EQ(MainPwm()->Width, PWM_PERIOD / 2);
+    CHECK_EQ(TailPwm()->Width, PWM_PERIOD * 3 / 10);
+    CHECK_EQ(MainPwm()->Writes, 2);
+    CHECK_EQ(TailPwm()->Writes, 2);
+    CHECK_EQ(MainPwm()->SyncUpdates, 2);
+    CHECK_EQ(TailPwm()->SyncUpdates, 2);
+
+    // The controller at steady state writes the same duties every run
+    for (n = 0; n < 1000; n++) {
+        SetMotorDuties(500, 300);
+    }
+    CHECK_EQ(MainPwm()->Writes, 2);
+    CHECK_EQ(TailPwm()->Writes, 2);
+    CHECK_EQ(MainPwm()->SyncUpdates, 2);
+
+    // Only the one that changed is written
+    SetMotorDuties(500, 310);
+    CHECK_EQ(MainPwm()->Writes, 2);
+    CHECK_EQ(TailPwm()->Writes, 3);
+    CHECK_EQ(TailPwm()->SyncUpdates, 3);
+    CHECK_EQ(MainPwm()->SyncUpdates, 2);
+
+    // Over full scale clamps
+    SetMotorDuty(MOTOR_MAIN, 1500);
+    CHECK_EQ(MainPwm()->Width, PWM_PERIOD);
+    CHECK_EQ(GetMotorDuty(MOTOR_MAIN), DUTY_PERMILLE);
+
+    // Percent from the ramps, the same cache
+    SetMainPWM(40);
+    CHECK_EQ(MainPwm()->Width, PWM_PERIOD * 4 / 10);
+    CHECK_EQ(GetMainDuty(), 40);
+    SetMotorDuties(400, 310);
+    CHECK_EQ(MainPwm()->Writes, 4);
+    CHECK_EQ(TailPwm()->Writes, 3);
+
+    CHECK_EQ(MainPwm()->UnmaskedWrites, 0);
+    CHECK_EQ(TailPwm()->UnmaskedWrites, 0);
+    CHECK_EQ(HostPwmPeriodWrites(), 2);
+}
+
+static void
+ControlWrite(void)
+{
+    SetMotorDutiesSampled(600, 250, HostCycles(), HostCycles());
+}
+
+/*
+ * Called masked, as from the controller's interrupt, the write leaves
+ * interrupts masked; called unmasked, it enables them again
+ */
+static void
+TestMasking(void)
+{
+    InitMotors();
+
+    IntMasterEnable();
+    SetTailPWM(10);
+    CHECK(!HostMasked());
+
+    IntMasterDisable();
+    SetTailPWM(20);
+    CHECK(HostMasked());
+    IntMasterEnable();
+
+    HostWakeAfter(1000, ControlWrite);
+    HostAdvance(2000);
+    CHECK_EQ(MainPwm()->Width, PWM_PERIOD * 6 / 10);
+    CHECK_EQ(TailPwm()->Width, PWM_PERIOD / 4);
+    CHECK(!HostMasked());
+    CHECK_EQ(MainPwm()->UnmaskedWrites, 0);
+    CHECK_EQ(TailPwm()->UnmaskedWrites, 0);
+}
+
+/*
+ * A controlled write from samples mainUs and tailUs old
+ */
+static void
+SampledWrite(uint32_t mainUs, uint32_t tailUs)
+{
+    HostAdvance(100 * CYCLES_PER_US);
+    SetMotorDutiesSampled(500, 500, HostCycles() - mainUs * CYCLES_PER_US,
+                          HostCycles() - tailUs * CYCLES_PER_US);
+}
+
+/*
+ * Ages fall in power of two bins, the oldest in the last; nothing is
+ * published until asked for, and then by the next controlled write,
+ * which a reset then clears the histograms ahead of
+ */
+static void
+TestLatency(void)
+{
+    LatencyHist_t main;
+    LatencyHist_t tail;
+    uint8_t bin;
+
+    InitMotors();
+    HostAdvance(HOST_CLOCK_HZ);
+    CHECK(!GetLatencyHistogram(MOTOR_MAIN, &main));
+    CHECK(!GetLatencyHistogram(MOTOR_TAIL, &tail));
+
+    SampledWrite(0, 3);
+    SampledWrite(1, 3);
+    SampledWrite(2, 3);
+    SampledWrite(3, 3);
+    SampledWrite(5, 3);
+    SampledWrite(100, 3);
+    SampledWrite(70000, 3);
+    CHECK(!GetLatencyHistogram(MOTOR_MAIN, &main));
+
+    RequestLatencyHistograms();
+    CHECK(!GetLatencyHistogram(MOTOR_MAIN, &main));
+    SampledWrite(10, 3);
+    CHECK(GetLatencyHistogram(MOTOR_MAIN, &main));
+    CHECK(GetLatencyHistogram(MOTOR_TAIL, &tail));
+
+    // Under 2 us, 2-3 us, 4-7, 8-15, 64-127, and 32768 up
+    CHECK_EQ(main.Bins[0], 2);
+    CHECK_EQ(main.Bins[1], 2);
+    CHECK_EQ(main.Bins[2], 1);
+    CHECK_EQ(main.Bins[3], 1);
+    CHECK_EQ(main.Bins[6], 1);
+    CHECK_EQ(main.Bins[LATENCY_BINS - 1], 1);
+    CHECK_EQ(main.Count, 8);
+    CHECK_EQ(main.MaxUs, 70000);
+    CHECK_EQ(tail.Bins[1], 8);
+    CHECK_EQ(tail.Count, 8);
+    CHECK_EQ(tail.MaxUs, 3);
+    for (bin = 0; bin < LATENCY_BINS; bin++) {
+        if (bin != 1) {
+            CHECK_EQ(tail.Bins[bin], 0);
+        }
+    }
+
+    // Later writes go unpublished until asked for again
+    SampledWrite(4, 4);
+    CHECK(GetLatencyHistogram(MOTOR_MAIN, &main));
+    CHECK_EQ(main.Count, 8);
+
+    // A reset takes effect on the next write, which starts afresh
+    ResetLatencyHistograms();
+    RequestLatencyHistograms();
+    SampledWrite(6, 40);
+    CHECK(GetLatencyHistogram(MOTOR_MAIN, &main));
+    CHECK(GetLatencyHistogram(MOTOR_TAIL, &tail));
+    CHECK_EQ(main.Count, 1);
+    CHECK_EQ(main.Bins[2], 1);
+    CHECK_EQ(main.Bins[LATENCY_BINS - 1], 0);
+    CHECK_EQ(main.MaxUs, 6);
+    CHECK_EQ(tail.Count, 1);
+    CHECK_EQ(tail.Bins[5], 1);
+    CHECK_EQ(tail.MaxUs, 40);
+}
+
+int
+main(void)
+{
+    CheckIsolated(TestInit);
+    CheckIsolated(TestWrites);
+    CheckIsolated(TestMasking);
+    CheckIsolated(TestLatency);
+    return CheckDone("motors");
+}
@@ -0,0 +1,365 @@
+/**
+ * @filename: test_pid.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Host tests for pid.c: the Q16.16 update against the float
+ * one in closed loop, saturation and anti-windup, large errors, dt 0,
+ * the batch update against the scalar one, and benchmarks
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "check.h"
+#include "pid.h"
+
+#define DT_US 2000
+
+/*
+ * Gains like the yaw loop's with every term in use
+ */
+static void
+MakePid(PID_t* pid)
+{
+    PID_t init = {.Kp = 2.5f, .Ki = 1.2f, .Kd = 0.35f, .DFilter = 0.25f, .Kt = 3.0f,
+                  .Offset = 300, .OutMin = 20, .OutMax = 700};
+
+    *pid = init;
+    PidInit(pid);
+}
+
+/*
+ * A first order plant driven by duty in permille, rate of change
+ * proportional to the duty above 300
+ */
+static float
+Plant(float value, int32_t duty, float dt)
+{
+    return value + 0.5f * (duty - 300) * dt;
+}
+
+/*
+ * Float and Q16.16 controllers side by side on the float one's plant,
+ * through setpoint steps, both saturation limits and measurement
+ * noise. Their outputs must stay within a count of each other.
+ */
+static void
+TestAgreement(void)
+{
+    PID_t fpid, qpid;
+    float fvalue = 0;
+    uint32_t worst = 0;
+    uint32_t saturated = 0;
+    uint32_t n;
+
+    MakePid(&fpid);
+    MakePid(&qpid);
+
+    for (n = 0; n < 20000; n++) {
+        int32_t setpoint = (n < 5000) ? 100 : ((n < 10000) ? -200 : 40);
+        int32_t noise = (int32_t)(n * 7 % 5) - 2;
+        int32_t fout, qout, diff;
+
+        // Both see the float loop's measurement, so one rounding
+        // difference doesn't grow into two trajectories
+        fpid.read_value = (int32_t)fvalue + noise;
+        qpid.read_value = fpid.read_value;
+        fout = PidUpdate(&fpid, setpoint - fpid.read_value, DT_US * 1e-6f);
+        qout = PidUpdateQ16(&qpid, setpoint - qpid.read_value, (q16_t)((DT_US * 65536ull) / 1000000));
+
+        diff = (fout > qout) ? fout - qout : qout - fout;
+        if ((uint32_t)diff > worst) {
+            worst = diff;
+        }
+        if (fout == fpid.OutMin || fout == fpid.OutMax) {
+            saturated++;
+        }
+        fvalue = Plant(fvalue, fout, DT_US * 1e-6f);
+    }
+    CHECK(worst <= 1);
+    CHECK(saturated > 0);
+    CHECK_NEAR(fvalue, 40, 3);
+}
+
+/*
+ * A setpoint out of reach for a long time must not wind the integral
+ * up: once it is reachable the output leaves the limit at once
+ */
+static void
+TestAntiWindup(void)
+{
+    PID_t pid;
+    int32_t out = 0;
+    uint32_t outside = 0;
+    uint32_t n;
+
+    MakePid(&pid);
+    pid.read_value = 0;
+    for (n = 0; n < 5000; n++) {
+        out = PidStep(&pid, 1000 - pid.read_value, DT_US);
+        if (out < pid.OutMin || out > pid.OutMax) {
+            outside++;
+        }
+    }
+    CHECK_EQ(outside, 0);
+    CHECK_EQ(out, pid.OutMax);
+    CHECK((pid.IntegralQ >> 32) <= pid.OutMax - pid.Offset);
+
+    // Now just above the setpoint: the output drops below the limit
+    // on the first update and heads under the offset
+    pid.read_value = 5;
+    out = PidStep(&pid, 0 - pid.read_value, DT_US);
+    CHECK(out < pid.OutMax);
+    for (n = 0; n < 50; n++) {
+        out = PidStep(&pid, 0 - pid.read_value, DT_US);
+    }
+    CHECK(out < pid.OutMax - 100);
+}
+
+/*
+ * Back-calculation with the yaw loop's small Kt at 2 ms, where Kt * dt
+ * is under one Q16 count: held in saturation by the proportional term
+ * alone, the Q16 integral must bleed off as the float one does
+ */
+static void
+TestBackCalculation(void)
+{
+    PID_t fpid, qpid;
+    PID_t init = {.Kp = 2.5f, .Kt = 0.0006f, .Offset = 300, .OutMin = 20, .OutMax = 700};
+    uint32_t n;
+
+    fpid = init;
+    qpid = init;
+    PidInit(&fpid);
+    PidInit(&qpid);
+    fpid.Integral = 200;
+    qpid.IntegralQ = (int64_t)200 << 32;
+
+    // 10 s at 1200 past the upper limit, with no Ki to refill it
+    for (n = 0; n < 5000; n++) {
+        PidUpdate(&fpid, 560, DT_US * 1e-6f);
+        PidUpdateQ16(&qpid, 560, (q16_t)((DT_US * 65536ull) / 1000000));
+    }
+    // KtQ rounds 39.3 counts to 39, under 1% of the 7 bled off
+    CHECK(fpid.Integral < 200 - 3);
+    CHECK_NEAR((double)qpid.IntegralQ / 4294967296.0, fpid.Integral, 0.1);
+}
+
+/*
+ * Errors past what Q16.16 holds saturate rather than wrap
+ */
+static void
+TestLargeError(void)
+{
+    PID_t pid;
+
+    MakePid(&pid);
+    pid.read_value = 0;
+    CHECK_EQ(PidUpdateQ16(&pid, 100000, (q16_t)((DT_US * 65536ull) / 1000000)), pid.OutMax);
+    CHECK_EQ(PidUpdateQ16(&pid, -100000, (q16_t)((DT_US * 65536ull) / 1000000)), pid.OutMin);
+    pid.read_value = 100000;
+    CHECK(PidUpdateQ16(&pid, 0, (q16_t)((DT_US * 65536ull) / 1000000)) >= pid.OutMin);
+}
+
+/*
+ * dt 0, as on the first run after enable, divides by nothing: the
+ * derivative holds and the rest is as for any update
+ */
+static void
+TestZeroDt(void)
+{
+    PID_t pid;
+    int32_t before, after;
+
+    MakePid(&pid);
+    pid.read_value = 10;
+    before = PidUpdateQ16(&pid, -10, (q16_t)((DT_US * 65536ull) / 1000000));
+    pid.read_value = 50;
+    after = PidUpdateQ16(&pid, -10, 0);
+    CHECK_NEAR(after, before, 1);
+    after = PidUpdate(&pid, -10, 0.0f);
+    CHECK_NEAR(after, before, 1);
+
+    pid.Kd = 0;
+    PidInit(&pid);
+    CHECK_EQ(PidUpdateQ16(&pid, 4, 0), 300 + 10);
+    CHECK_EQ(PidStep(&pid, 4, 0), 300 + 10);
+}
+
+/*
+ * With RateInput the derivative comes from read_rate, not differences
+ */
+static void
+TestRateInput(void)
+{
+    PID_t pid;
+    PID_t init = {.Kd = 0.5f, .DFilter = 1, .RateInput = true, .OutMin = -1000, .OutMax = 1000};
+
+    pid = init;
+    PidInit(&pid);
+    pid.read_rate = 100;
+    CHECK_EQ(PidUpdateQ16(&pid, 0, (q16_t)((DT_US * 65536ull) / 1000000)), -50);
+    CHECK_EQ(PidUpdate(&pid, 0, DT_US * 1e-6f), -50);
+}
+
+/*
+ * A drifting, noisy measurement for controller i of the batch test
+ */
+static int32_t
+BatchMeasurement(uint32_t n, uint32_t i)
+{
+    return (int32_t)((n * (7 + i)) % 41) - 20 + (int32_t)(n / 100);
+}
+
+/*
+ * Three controllers with different gains through one batch and through
+ * PidUpdateQ16() each, on the same noisy measurements, including a dt 0
+ * update and runs in saturation. The rounded outputs must be equal.
+ */
+static void
+TestBatch(void)
+{
+    PID_t init[3] = {
+        {.Kp = 2.5f, .Ki = 1.2f, .Kd = 0.35f, .DFilter = 0.25f, .Kt = 3.0f, .Offset = 300, .OutMin = 20, .OutMax = 700},
+        {.Kp = -8.9f, .Ki = -0.005f, .Kd = -0.45f, .DFilter = 0.5f, .Kt = 0.0006f, .Offset = 400, .OutMin = 20, .OutMax = 700},
+        {.Kp = 0.8f, .Ki = 4.0f, .OutMin = -100, .OutMax = 100},
+    };
+    PID_t pid[3];
+    PidBatch_t batch = {0};
+    q16_t error[3], measurement[3], output[3];
+    int32_t scalar[3];
+    uint32_t mismatches = 0;
+    uint32_t saturated = 0;
+    uint32_t n, i;
+
+    for (i = 0; i < 3; i++) {
+        pid[i] = init[i];
+        PidInit(&pid[i]);
+        // Primed on the first measurement, as the scalar one will be
+        pid[i].read_value = BatchMeasurement(0, i);
+        CHECK(PidBatchAdd(&batch, &pid[i]));
+    }
+    CHECK_EQ(batch.Count, 3);
+
+    for (n = 0; n < 10000; n++) {
+        q16_t dt = (n == 5000) ? 0 : (q16_t)((DT_US * 65536ull) / 1000000);
+
+        for (i = 0; i < 3; i++) {
+            int32_t setpoint = (n < 3000) ? 80 : -150;
+
+            pid[i].read_value = BatchMeasurement(n, i);
+            measurement[i] = pid[i].read_value * Q16_ONE;
+            error[i] = (setpoint - pid[i].read_value) * Q16_ONE;
+            scalar[i] = PidUpdateQ16(&pid[i], setpoint - pid[i].read_value, dt);
+            if (scalar[i] == pid[i].OutMin || scalar[i] == pid[i].OutMax) {
+                saturated++;
+            }
+        }
+        PidUpdateBatch(&batch, error, measurement, dt, output);
+        for (i = 0; i < 3; i++) {
+            if ((output[i] + Q16_ONE / 2) >> 16 != scalar[i]) {
+                mismatches++;
+            }
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK(saturated > 0);
+
+    // Full
+    CHECK(PidBatchAdd(&batch, &pid[0]));
+    CHECK(!PidBatchAdd(&batch, &pid[0]));
+}
+
+/*
+ * ns per update on the host, float against Q16.16. On the M4F the
+ * float one runs on the FPU; the fixed point one also suits an M4
+ * without it.
+ */
+static void
+BenchPid(void)
+{
+    const uint32_t updates = 10000000;
+    PID_t pid;
+    uint64_t start;
+    uint32_t n;
+    volatile int32_t sink = 0;
+
+    MakePid(&pid);
+    start = BenchNs();
+    for (n = 0; n < updates; n++) {
+        pid.read_value = n & 255;
+        sink += PidUpdate(&pid, 128 - pid.read_value, DT_US * 1e-6f);
+    }
+    printf("pid float: %.1f ns per update\n", (double)(BenchNs() - start) / updates);
+
+    MakePid(&pid);
+    start = BenchNs();
+    for (n = 0; n < updates; n++) {
+        pid.read_value = n & 255;
+        sink += PidUpdateQ16(&pid, 128 - pid.read_value, (q16_t)((DT_US * 65536ull) / 1000000));
+    }
+    printf("pid q16:   %.1f ns per update\n", (double)(BenchNs() - start) / updates);
+    (void)sink;
+}
+
+/*
+ * ns per controller, PID_BATCH_MAX of them through PidUpdateQ16() one
+ * at a time against one PidUpdateBatch()
+ */
+static void
+BenchPidBatch(void)
+{
+    const uint32_t updates = 10000000 / PID_BATCH_MAX;
+    PID_t pid[PID_BATCH_MAX];
+    PidBatch_t batch = {0};
+    q16_t error[PID_BATCH_MAX], measurement[PID_BATCH_MAX], output[PID_BATCH_MAX];
+    uint64_t start;
+    uint32_t n, i;
+    volatile int32_t sink = 0;
+
+    for (i = 0; i < PID_BATCH_MAX; i++) {
+        MakePid(&pid[i]);
+        PidBatchAdd(&batch, &pid[i]);
+    }
+
+    start = BenchNs();
+    for (n = 0; n < updates; n++) {
+        for (i = 0; i < PID_BATCH_MAX; i++) {
+            pid[i].read_value = (n + i) & 255;
+            sink += PidUpdateQ16(&pid[i], 128 - pid[i].read_value, (q16_t)((DT_US * 65536ull) / 1000000));
+        }
+    }
+    printf("pid q16 x%d:   %.1f ns per controller\n", PID_BATCH_MAX,
+           (double)(BenchNs() - start) / (updates * PID_BATCH_MAX));
+
+    start = BenchNs();
+    for (n = 0; n < updates; n++) {
+        for (i = 0; i < PID_BATCH_MAX; i++) {
+            measurement[i] = ((n + i) & 255) * Q16_ONE;
+            error[i] = 128 * Q16_ONE - measurement[i];
+        }
+        PidUpdateBatch(&batch, error, measurement, (q16_t)((DT_US * 65536ull) / 1000000), output);
+        sink += output[n % PID_BATCH_MAX];
+    }
+    printf("pid batch x%d: %.1f ns per controller\n", PID_BATCH_MAX,
+           (double)(BenchNs() - start) / (updates * PID_BATCH_MAX));
+    (void)sink;
+}
+
+int
+main(int argc, char** argv)
+{
+    TestAgreement();
+    TestAntiWindup();
+    TestBackCalculation();
+    TestLargeError();
+    TestZeroDt();
+    TestRateInput();
+    TestBatch();
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        BenchPid();
+        BenchPidBatch();
+    }
+    return CheckDone("pid");
+}
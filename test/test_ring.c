@@ -0,0 +1,284 @@
+/**
+ * @filename: test_ring.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Host tests for ring.c, with a stress test where a second
+ * thread plays the interrupt producing into the ring
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "check.h"
+#include "ring.h"
+
+#define STRESS_CAPACITY 64
+#define STRESS_ELEMENTS 2000000
+
+/*
+ * Shaped like the yaw edge stamps, 8 bytes with padding
+ */
+typedef struct {
+    uint32_t Cycles;
+    int16_t Step;
+} Edge_t;
+
+/*
+ * Stress element, Check the complement of Seq so a torn copy shows
+ */
+typedef struct {
+    uint32_t Seq;
+    uint32_t Check;
+    uint32_t Pad[2];
+} Sample_t;
+
+static Ring_t g_stressRing;
+static Sample_t g_stressData[STRESS_CAPACITY];
+static volatile bool g_producerDone;
+
+static void
+TestInit(void)
+{
+    Ring_t ring;
+    uint32_t data[8];
+
+    CHECK(!RingInit(&ring, data, 0, sizeof(uint32_t)));
+    CHECK(!RingInit(&ring, data, 6, sizeof(uint32_t)));
+    CHECK(RingInit(&ring, data, 8, sizeof(uint32_t)));
+    CHECK_EQ(RingCount(&ring), 0);
+    CHECK_EQ(RingSpace(&ring), 8);
+}
+
+/*
+ * Fills past capacity and drains past empty, with Head and Tail
+ * started just short of wrapping
+ */
+static void
+TestFillDrain(void)
+{
+    Ring_t ring;
+    Edge_t data[4];
+    Edge_t edge;
+    uint32_t i;
+
+    CHECK(RingInit(&ring, data, 4, sizeof(Edge_t)));
+    ring.Head = UINT32_MAX - 1;
+    ring.Tail = UINT32_MAX - 1;
+
+    for (i = 0; i < 6; i++) {
+        edge.Cycles = 1000 * i;
+        edge.Step = (i % 2) ? -1 : 1;
+        CHECK_EQ(RingWrite(&ring, &edge), i < 4);
+    }
+    CHECK_EQ(RingCount(&ring), 4);
+    CHECK_EQ(RingSpace(&ring), 0);
+    CHECK_EQ(ring.Overflows, 2);
+
+    CHECK(RingPeek(&ring, 3, &edge));
+    CHECK_EQ(edge.Cycles, 3000);
+    CHECK(!RingPeek(&ring, 4, &edge));
+
+    for (i = 0; i < 4; i++) {
+        CHECK(RingRead(&ring, &edge));
+        CHECK_EQ(edge.Cycles, 1000 * i);
+        CHECK_EQ(edge.Step, (i % 2) ? -1 : 1);
+    }
+    CHECK(!RingRead(&ring, &edge));
+    CHECK_EQ(ring.Underruns, 1);
+    CHECK_EQ(RingCount(&ring), 0);
+    CHECK_EQ(ring.Head, 2);
+}
+
+/*
+ * Spans stop at the end of the storage, the rest follows from the start.
+ * A full write span counts an overflow and an empty read span an
+ * underrun, as RingWrite() and RingRead() do.
+ */
+static void
+TestSpans(void)
+{
+    Ring_t ring;
+    uint16_t data[8];
+    uint16_t value;
+    void* write;
+    const void* read;
+    uint32_t n, i;
+
+    CHECK(RingInit(&ring, data, 8, sizeof(uint16_t)));
+    for (i = 0; i < 6; i++) {
+        value = i;
+        RingWrite(&ring, &value);
+    }
+    for (i = 0; i < 5; i++) {
+        RingRead(&ring, &value);
+    }
+
+    // Head at 6, Tail at 5: two free to the end, then five from the start
+    n = RingWriteSpan(&ring, &write);
+    CHECK_EQ(n, 2);
+    CHECK(write == &data[6]);
+    ((uint16_t*)write)[0] = 6;
+    ((uint16_t*)write)[1] = 7;
+    RingCommit(&ring, 2);
+    n = RingWriteSpan(&ring, &write);
+    CHECK_EQ(n, 5);
+    CHECK(write == &data[0]);
+    for (i = 0; i < n; i++) {
+        ((uint16_t*)write)[i] = 8 + i;
+    }
+    RingCommit(&ring, n);
+    CHECK_EQ(RingSpace(&ring), 0);
+    n = RingWriteSpan(&ring, &write);
+    CHECK_EQ(n, 0);
+    CHECK_EQ(ring.Overflows, 1);
+
+    n = RingReadSpan(&ring, &read);
+    CHECK_EQ(n, 3);
+    CHECK_EQ(((const uint16_t*)read)[0], 5);
+    RingConsume(&ring, n);
+    n = RingReadSpan(&ring, &read);
+    CHECK_EQ(n, 5);
+    CHECK_EQ(((const uint16_t*)read)[4], 12);
+    RingConsume(&ring, n);
+    CHECK_EQ(RingCount(&ring), 0);
+    CHECK_EQ(ring.Underruns, 0);
+
+    // Empty, as a full ring counts an overflow
+    n = RingReadSpan(&ring, &read);
+    CHECK_EQ(n, 0);
+    CHECK_EQ(ring.Underruns, 1);
+    CHECK_EQ(ring.Overflows, 1);
+}
+
+/*
+ * The interrupt: writes a numbered sample whenever it likes, dropping
+ * it when the ring is full. Yields after 37 and 97 samples in turn,
+ * under and over the capacity, so the two threads interleave and the
+ * ring fills on a single core too.
+ */
+static void*
+StressProducer(void* arg)
+{
+    uint32_t seq;
+
+    (void)arg;
+    for (seq = 0; seq < STRESS_ELEMENTS; seq++) {
+        Sample_t sample = {seq, ~seq, {seq, seq}};
+        RingWrite(&g_stressRing, &sample);
+        if (seq % 134 == 0 || seq % 134 == 37) {
+            sched_yield();
+        }
+    }
+    RING_BARRIER();
+    g_producerDone = true;
+    return NULL;
+}
+
+/*
+ * The task, reading one at a time and by spans until the producer is
+ * done and the ring empty. Samples must come whole and in order, and every one
+ * missing must be an overflow.
+ */
+static void
+TestStress(bool bench)
+{
+    pthread_t producer;
+    uint32_t received = 0;
+    uint32_t gaps = 0;
+    uint32_t torn = 0;
+    uint32_t disorder = 0;
+    uint32_t next = 0;
+    uint64_t start;
+
+    CHECK(RingInit(&g_stressRing, g_stressData, STRESS_CAPACITY, sizeof(Sample_t)));
+    start = BenchNs();
+    CHECK_EQ(pthread_create(&producer, NULL, StressProducer, NULL), 0);
+
+    for (;;) {
+        bool done = g_producerDone;
+        Sample_t sample;
+        const void* span;
+        uint32_t n, i;
+
+        if (received % 2) {
+            n = RingReadSpan(&g_stressRing, &span);
+        } else {
+            n = RingRead(&g_stressRing, &sample) ? 1 : 0;
+            span = &sample;
+        }
+        for (i = 0; i < n; i++) {
+            const Sample_t* s = &((const Sample_t*)span)[i];
+            if (s->Check != ~s->Seq || s->Pad[0] != s->Seq || s->Pad[1] != s->Seq) {
+                torn++;
+            }
+            if (s->Seq < next) {
+                disorder++;
+            }
+            gaps += s->Seq - next;
+            next = s->Seq + 1;
+            received++;
+        }
+        if (span != &sample) {
+            RingConsume(&g_stressRing, n);
+        }
+        if (n == 0) {
+            if (done) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    pthread_join(producer, NULL);
+
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(disorder, 0);
+    CHECK_EQ(RingCount(&g_stressRing), 0);
+    CHECK_EQ(received + g_stressRing.Overflows, STRESS_ELEMENTS);
+    CHECK_EQ(gaps + (STRESS_ELEMENTS - next), g_stressRing.Overflows);
+    if (bench) {
+        printf("ring stress: %u samples in %.0f ms, %u received, %u overflows, %u underruns\n",
+               STRESS_ELEMENTS, (BenchNs() - start) / 1e6, received,
+               g_stressRing.Overflows, g_stressRing.Underruns);
+    }
+}
+
+/*
+ * One write and one read of an edge stamp, single threaded
+ */
+static void
+BenchRing(void)
+{
+    const uint32_t pairs = 10000000;
+    Ring_t ring;
+    Edge_t data[32];
+    Edge_t edge = {0, 1};
+    uint64_t start;
+    uint32_t i;
+
+    RingInit(&ring, data, 32, sizeof(Edge_t));
+    start = BenchNs();
+    for (i = 0; i < pairs; i++) {
+        edge.Cycles = i;
+        RingWrite(&ring, &edge);
+        RingRead(&ring, &edge);
+    }
+    printf("ring: %.1f ns per write and read\n", (double)(BenchNs() - start) / pairs);
+}
+
+int
+main(int argc, char** argv)
+{
+    bool bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    TestInit();
+    TestFillDrain();
+    TestSpans();
+    TestStress(bench);
+    if (bench) {
+        BenchRing();
+    }
+    return CheckDone("ring");
+}
@@ -0,0 +1,324 @@
+/**
+ * @filename: test_serial.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Host tests for the UART transmit ring in serial.c: writes
+ * return at once, drop whole when the ring is full, and drain onto the
+ * stand-in's wire at the baud rate. Also the binary telemetry frames
+ * taken off the wire and decoded as tools/decode_telemetry.py does.
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "host.h"
+#include "check.h"
+#include "serial.h"
+#include "altitude.h"
+#include "motors.h"
+#include "switch.h"
+#include "yaw.h"
+
+// As in serial.c and the stand-in
+#define BAUD_RATE 9600
+#define UART_TX_RING_SIZE 512
+#define UART_FIFO_SIZE 16
+#define CHAR_CYCLES (HOST_CLOCK_HZ / (BAUD_RATE / 10))
+
+// Telemetry frame, as in serial.c: id, sequence, tick, then the flight
+// fields, flags and the CRC
+#define FRAME_ID 1
+#define FRAME_SIZE 24
+#define PAYLOAD_SIZE (FRAME_SIZE - 2)
+#define FRAME_SEQ 1
+#define FRAME_YAW 11
+#define FRAME_MAIN 15
+#define FRAME_TAIL 17
+#define FRAME_FLAGS 21
+#define ENCODED_MAX (FRAME_SIZE + 2)
+
+static uint8_t g_sent[2048];
+static uint32_t g_sentCount;
+
+/*
+ * Writes length bytes of a counting pattern, keeping what should
+ * reach the wire
+ */
+static uint32_t
+Write(uint32_t length)
+{
+    uint8_t data[1024];
+    uint32_t dropped;
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        data[i] = (uint8_t)(g_sentCount + i * 7 + 1);
+    }
+    dropped = UartWrite(data, length);
+    if (dropped == 0) {
+        memcpy(&g_sent[g_sentCount], data, length);
+        g_sentCount += length;
+    }
+    return dropped;
+}
+
+/*
+ * A line goes out without the caller waiting: no time passes in the
+ * write, the FIFO takes what it can and the rest follows one character
+ * time apart
+ */
+static void
+TestNonBlocking(void)
+{
+    uint32_t start;
+    uint32_t late = 0;
+    uint32_t n;
+
+    InitUart();
+    IntMasterEnable();
+
+    start = HostCycles();
+    CHECK_EQ(Write(100), 0);
+    CHECK_EQ(HostCycles(), start);
+    CHECK_EQ(HostUartFifoLevel(), UART_FIFO_SIZE);
+    CHECK_EQ(g_hostUartWireCount, 0);
+
+    // The ring keeps the FIFO topped up, so the wire never idles
+    for (n = 1; n <= 100; n++) {
+        HostAdvance(CHAR_CYCLES);
+        if (g_hostUartWireCount != n) {
+            late++;
+        }
+    }
+    CHECK_EQ(late, 0);
+    CHECK_EQ(HostUartFifoLevel(), 0);
+    CHECK_EQ(memcmp(g_hostUartWire, g_sent, 100), 0);
+    CHECK_EQ(GetUartDropped(), 0);
+}
+
+/*
+ * A write that doesn't fit is dropped whole and counted; what was
+ * queued before and after goes out intact and in order
+ */
+static void
+TestDropWhenFull(void)
+{
+    uint32_t queued;
+
+    InitUart();
+    IntMasterEnable();
+
+    CHECK_EQ(Write(400), 0);
+    queued = UART_TX_RING_SIZE - (400 - UART_FIFO_SIZE);
+    CHECK_EQ(Write(queued + 1), queued + 1);
+    CHECK_EQ(GetUartDropped(), queued + 1);
+    CHECK_EQ(Write(queued), 0);
+    CHECK_EQ(Write(1), 1);
+    CHECK_EQ(GetUartDropped(), queued + 2);
+
+    // Space comes back as the interrupt tops the FIFO up from its
+    // trigger level of 2
+    HostAdvance((UART_FIFO_SIZE - 3) * CHAR_CYCLES);
+    CHECK_EQ(Write(1), 1);
+    HostAdvance(CHAR_CYCLES);
+    CHECK_EQ(Write(UART_FIFO_SIZE - 2), 0);
+    CHECK_EQ(Write(1), 1);
+
+    HostAdvance((g_sentCount - (UART_FIFO_SIZE - 2)) * CHAR_CYCLES);
+    CHECK_EQ(g_hostUartWireCount, g_sentCount);
+    CHECK_EQ(GetUartDropped(), queued + 4);
+    CHECK_EQ(memcmp(g_hostUartWire, g_sent, g_sentCount), 0);
+    HostAdvance(10 * CHAR_CYCLES);
+    CHECK_EQ(g_hostUartWireCount, g_sentCount);
+}
+
+/*
+ * Telemetry lines a few at a time, as the UART task sends them, keep
+ * up with the wire and lose nothing
+ */
+static void
+TestSteadyStream(void)
+{
+    uint32_t n;
+
+    InitUart();
+    IntMasterEnable();
+
+    for (n = 0; n < 50; n++) {
+        CHECK_EQ(Write(26), 0);
+        HostAdvance(30 * CHAR_CYCLES);
+    }
+    CHECK_EQ(g_hostUartWireCount, g_sentCount);
+    CHECK_EQ(memcmp(g_hostUartWire, g_sent, g_sentCount), 0);
+    CHECK_EQ(GetUartDropped(), 0);
+}
+
+/*
+ * CRC-16/CCITT-FALSE worked bit by bit, as the decoder does
+ */
+static uint16_t
+ReferenceCrc(const uint8_t* data, uint32_t length)
+{
+    uint16_t crc = 0xFFFF;
+    uint32_t i;
+    uint8_t bit;
+
+    for (i = 0; i < length; i++) {
+        for (bit = 0; bit < 8; bit++) {
+            bool msb = ((crc >> 15) ^ (data[i] >> (7 - bit))) & 1;
+            crc = msb ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/*
+ * Undoes COBS on length bytes, the terminating zero not among them.
+ * Returns the decoded length, 0 if the block is malformed.
+ */
+static uint32_t
+CobsDecode(const uint8_t* in, uint32_t length, uint8_t* out)
+{
+    uint32_t in_index = 0;
+    uint32_t out_index = 0;
+
+    while (in_index < length) {
+        uint8_t code = in[in_index];
+        uint8_t i;
+
+        if (code == 0 || in_index + code > length) {
+            return 0;
+        }
+        for (i = 1; i < code; i++) {
+            out[out_index++] = in[in_index + i];
+        }
+        in_index += code;
+        if (code < 0xFF && in_index < length) {
+            out[out_index++] = 0;
+        }
+    }
+    return out_index;
+}
+
+static uint16_t
+Get16(const uint8_t* in)
+{
+    return in[0] | (uint16_t)in[1] << 8;
+}
+
+/*
+ * A decoded frame is whole: the right size and id, and its CRC
+ * matches
+ */
+static bool
+FrameValid(const uint8_t* frame, uint32_t length)
+{
+    return length == FRAME_SIZE && frame[0] == FRAME_ID &&
+           ReferenceCrc(frame, PAYLOAD_SIZE) == Get16(&frame[PAYLOAD_SIZE]);
+}
+
+/*
+ * Sends one frame and lets it all onto the wire, then takes it off:
+ * one zero, at the end, and decoding to a valid frame. Returns the
+ * encoded length.
+ */
+static uint32_t
+SendFrame(uint8_t* encoded, uint8_t* frame)
+{
+    uint32_t length;
+
+    g_hostUartWireCount = 0;
+    SendValues();
+    HostAdvance((ENCODED_MAX + 1) * CHAR_CYCLES);
+    length = g_hostUartWireCount;
+    memcpy(encoded, g_hostUartWire, length);
+
+    if (length < 2 || length > ENCODED_MAX || encoded[length - 1] != 0 ||
+        memchr(encoded, 0, length - 1) != NULL) {
+        return 0;
+    }
+    if (!FrameValid(frame, CobsDecode(encoded, length - 1, frame))) {
+        return 0;
+    }
+    return length;
+}
+
+/*
+ * Frames from SendValues() decode to what the getters say, zero fields
+ * and all. The CRC is the standard one (check value 0x29B1), any single
+ * bit flipped anywhere in the frame or on the wire is caught, and the
+ * sequence number counts every frame and wraps from 65535 to 0.
+ */
+static void
+TestTelemetryFrames(void)
+{
+    static const uint8_t check[] = "123456789";
+    uint8_t encoded[ENCODED_MAX];
+    uint8_t frame[ENCODED_MAX];
+    uint8_t corrupt[ENCODED_MAX];
+    uint32_t undetected = 0;
+    uint32_t bad = 0;
+    uint32_t length;
+    uint32_t n, i;
+    uint8_t bit;
+
+    CHECK_EQ(ReferenceCrc(check, 9), 0x29B1);
+
+    InitUart();
+    InitMotors();
+    InitADC(&g_adcSingleSource);
+    InitQuad(&g_yawGpioSource);
+    InitSwitch();
+    IntMasterEnable();
+
+    // Yaw and the setpoints are zero; 256 permille is 00 01
+    SetMotorDuty(MOTOR_MAIN, 256);
+    SetMotorDuty(MOTOR_TAIL, 513);
+    length = SendFrame(encoded, frame);
+    CHECK(length > 0);
+    CHECK_EQ(Get16(&frame[FRAME_SEQ]), 0);
+    CHECK_EQ(Get16(&frame[FRAME_YAW]), (uint16_t)GetYaw());
+    CHECK_EQ(Get16(&frame[FRAME_MAIN]), 256);
+    CHECK_EQ(Get16(&frame[FRAME_TAIL]), 513);
+    CHECK_EQ(frame[FRAME_FLAGS], SwitchUp() ? 1 : 0);
+    CHECK(memchr(frame, 0, FRAME_SIZE) != NULL);
+
+    for (i = 0; i < FRAME_SIZE; i++) {
+        for (bit = 0; bit < 8; bit++) {
+            memcpy(corrupt, frame, FRAME_SIZE);
+            corrupt[i] ^= 1 << bit;
+            undetected += FrameValid(corrupt, FRAME_SIZE);
+        }
+    }
+    CHECK_EQ(undetected, 0);
+    for (i = 0; i < length - 1; i++) {
+        for (bit = 0; bit < 8; bit++) {
+            memcpy(corrupt, encoded, length);
+            corrupt[i] ^= 1 << bit;
+            if (corrupt[i] != 0) {
+                undetected += FrameValid(frame, CobsDecode(corrupt, length - 1, frame));
+            }
+        }
+    }
+    CHECK_EQ(undetected, 0);
+
+    for (n = 1; n <= 65536 + 2; n++) {
+        if (SendFrame(encoded, frame) == 0 || Get16(&frame[FRAME_SEQ]) != (n & 0xFFFF)) {
+            bad++;
+        }
+    }
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(Get16(&frame[FRAME_SEQ]), 2);
+    CHECK_EQ(GetUartDropped(), 0);
+}
+
+int
+main(void)
+{
+    CheckIsolated(TestNonBlocking);
+    CheckIsolated(TestDropWhenFull);
+    CheckIsolated(TestSteadyStream);
+    CheckIsolated(TestTelemetryFrames);
+    return CheckDone("serial");
+}
@@ -0,0 +1,561 @@
+/**
+ * @filename: test_yaw.c
+ * @authors: Mark Day, Noah Walle
+ * @date: 24.05.2024
+ * @purpose: Host tests for yaw.c: the quadrature decoder driven by edge
+ * streams on port B through the stand-in, the rate estimator on streams
+ * of known rate, the QEI backend through the stand-in's QEI, and the
+ * binary angle error over every setpoint and encoder count
+**/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "host.h"
+#include "check.h"
+#include "buttons4.h"
+#include "yaw.h"
+
+// As in yaw.c
+#define YAW_SETPOINT_STEPS 24
+#define YAW_KP -8.9
+#define MIN_YAW_OUTPUT 20
+#define MAX_YAW_OUTPUT 700
+
+// Port F levels with LEFT (PF4) and RIGHT (PF0) released, and RIGHT pushed
+#define BUTTONS_RELEASED (GPIO_PIN_4 | GPIO_PIN_0)
+#define RIGHT_PUSHED GPIO_PIN_4
+
+// QuadHandler after its entry on the M4, a rough count of its
+// instructions with the two driverlib calls and the ring write
+#define QUAD_HANDLER_CYCLES 60
+
+#define MAX_EDGES 4096
+
+// The controller runs at about 500 Hz
+#define CONTROL_CYCLES (HOST_CLOCK_HZ / 500)
+
+// Channel levels forward, B the high bit
+static const uint8_t g_phases[4] = {0x0, 0x1, 0x3, 0x2};
+
+static uint8_t g_levels[MAX_EDGES];
+static uint32_t g_phase;
+
+/*
+ * Fills g_levels with edges edges from the current phase, forward for
+ * direction 1 and back for -1, and moves the phase on
+ */
+static uint32_t
+Edges(uint32_t edges, int32_t direction)
+{
+    uint32_t i;
+
+    for (i = 0; i < edges; i++) {
+        g_phase = (g_phase + direction) & 3;
+        g_levels[i] = g_phases[g_phase];
+    }
+    return edges;
+}
+
+/*
+ * Plays the levels period cycles apart and lets them all pass
+ */
+static void
+Play(uint32_t edges, uint32_t period)
+{
+    HostGpioPlay(GPIO_PORTB_BASE, g_levels, edges, period);
+    HostAdvance((edges + 1) * period);
+}
+
+static void
+StartQuad(void)
+{
+    g_phase = 0;
+    HostGpioSet(GPIO_PORTB_BASE, g_phases[0]);
+    InitQuad(&g_yawGpioSource);
+}
+
+/*
+ * Edges well apart count one each way, and the count zeros on a turn
+ */
+static void
+TestCount(void)
+{
+    StartQuad();
+
+    Play(Edges(300, 1), 1000);
+    CHECK_EQ(g_yawGpioSource.Read(), 300);
+    Play(Edges(200, -1), 1000);
+    CHECK_EQ(g_yawGpioSource.Read(), 100);
+    Play(Edges(STEP_MAX - 100 - 1, 1), 1000);
+    CHECK_EQ(g_yawGpioSource.Read(), STEP_MAX - 1);
+    Play(Edges(1, 1), 1000);
+    CHECK_EQ(g_yawGpioSource.Read(), 0);
+    Play(Edges(STEP_MAX + 5, -1), 1000);
+    CHECK_EQ(g_yawGpioSource.Read(), -5);
+    CHECK_EQ(GetYawMissedEdges(), 0);
+
+    // A bouncing contact, A up, down and up: one count on
+    Play(Edges(1, 1), 1000);
+    Play(Edges(1, -1), 1000);
+    Play(Edges(1, 1), 1000);
+    CHECK_EQ(g_yawGpioSource.Read(), -4);
+    CHECK_EQ(GetYawMissedEdges(), 0);
+}
+
+/*
+ * Two edges inside the interrupt entry: the handler sees both channels
+ * changed, counts a missed edge and leaves the count alone
+ */
+static void
+TestMissedEdge(void)
+{
+    StartQuad();
+
+    Play(Edges(10, 1), 1000);
+    Play(Edges(2, 1), HOST_IRQ_ENTRY_CYCLES / 3);
+    CHECK_EQ(GetYawMissedEdges(), 1);
+    CHECK_EQ(g_yawGpioSource.Read(), 10);
+
+    // Back in step from the next edge
+    Play(Edges(4, 1), 1000);
+    CHECK_EQ(g_yawGpioSource.Read(), 14);
+    CHECK_EQ(GetYawMissedEdges(), 1);
+}
+
+/*
+ * Shortest edge period in cycles that a stream of edges can keep up
+ * without a miss, with the handler taking handlerCycles
+ */
+static uint32_t
+MinEdgePeriod(uint32_t handlerCycles)
+{
+    uint32_t period;
+    uint32_t best = 0;
+
+    HostHandlerCycles(HOST_IRQ_GPIOB, handlerCycles);
+    for (period = 4 * (HOST_IRQ_ENTRY_CYCLES + handlerCycles); period > 0; period--) {
+        uint32_t missed = GetYawMissedEdges();
+        int16_t before = g_yawGpioSource.Read();
+        int16_t expected = (before + 1000) % STEP_MAX;
+
+        Play(Edges(1000, 1), period);
+        if (GetYawMissedEdges() != missed || g_yawGpioSource.Read() != expected) {
+            break;
+        }
+        best = period;
+    }
+    HostHandlerCycles(HOST_IRQ_GPIOB, 0);
+    return best;
+}
+
+/*
+ * Edges faster than the handler runs queue behind it until two land
+ * on one read, which must show as missed edges.
+ */
+static void
+TestEdgeRate(void)
+{
+    uint32_t missed;
+
+    StartQuad();
+    CHECK_EQ(MinEdgePeriod(QUAD_HANDLER_CYCLES), HOST_IRQ_ENTRY_CYCLES + QUAD_HANDLER_CYCLES);
+
+    missed = GetYawMissedEdges();
+    HostHandlerCycles(HOST_IRQ_GPIOB, QUAD_HANDLER_CYCLES);
+    Play(Edges(1000, 1), (HOST_IRQ_ENTRY_CYCLES + QUAD_HANDLER_CYCLES) * 3 / 4);
+    HostHandlerCycles(HOST_IRQ_GPIOB, 0);
+    CHECK(GetYawMissedEdges() > missed);
+}
+
+/*
+ * Starts edges at countsPerSecond for ms milliseconds, played as time
+ * passes
+ */
+static void
+StartRate(int32_t countsPerSecond, uint32_t ms)
+{
+    uint32_t speed = (countsPerSecond < 0) ? -countsPerSecond : countsPerSecond;
+    uint32_t edges = speed * ms / 1000;
+
+    Edges(edges, (countsPerSecond < 0) ? -1 : 1);
+    HostGpioPlay(GPIO_PORTB_BASE, g_levels, edges, HOST_CLOCK_HZ / speed);
+}
+
+/*
+ * Runs the controller's reading for periods control periods. Returns
+ * how many of the last check of them read other than expected degrees
+ * per second.
+ */
+static uint32_t
+RunControl(uint32_t periods, uint32_t check, int32_t expected)
+{
+    uint32_t wrong = 0;
+    uint32_t n;
+
+    for (n = 0; n < periods; n++) {
+        HostAdvance(CONTROL_CYCLES);
+        GetYawAngle();
+        if (n >= periods - check && GetYawRate() != expected) {
+            wrong++;
+        }
+    }
+    return wrong;
+}
+
+/*
+ * Degrees per second GetYawRate() gives for a count rate
+ */
+static int32_t
+Degrees(int32_t countsPerSecond)
+{
+    return countsPerSecond * 360 / STEP_MAX;
+}
+
+/*
+ * A staircase of rates, from less than an edge a control period to
+ * over 20, and back: each step must read its rate exactly once the
+ * timing has moved onto it
+ */
+static void
+TestRateSteps(void)
+{
+    static const int32_t rates[] = {200, 1000, 2500, 5000, 10000, -4000, -250};
+    uint32_t i;
+
+    StartQuad();
+    CHECK_EQ(RunControl(10, 10, 0), 0);
+    for (i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        StartRate(rates[i], 100);
+        CHECK_EQ(RunControl(50, 25, Degrees(rates[i])), 0);
+    }
+}
+
+/*
+ * From rest, the first edge only starts the timing. When the edges
+ * stop the rate falls as one count over the time since the last, and
+ * after half a second reads 0 again.
+ */
+static void
+TestRateStartStop(void)
+{
+    uint32_t n;
+    uint32_t wrong = 0;
+
+    StartQuad();
+
+    // 50 counts/s, an edge every 10 control periods: nothing until
+    // the second edge
+    StartRate(50, 300);
+    CHECK_EQ(RunControl(19, 19, 0), 0);
+    CHECK_EQ(RunControl(100, 100, Degrees(50)), 0);
+
+    // 1000 counts/s for 100 ms after the last, then stopped, the last
+    // edge on a control period
+    HostAdvance(HOST_CLOCK_HZ);
+    StartRate(1000, 100);
+    CHECK_EQ(RunControl(50, 40, Degrees(1000)), 0);
+    for (n = 1; n <= HOST_CLOCK_HZ / 2 / CONTROL_CYCLES; n++) {
+        HostAdvance(CONTROL_CYCLES);
+        GetYawAngle();
+        if (GetYawRate() != Degrees(HOST_CLOCK_HZ / (n * CONTROL_CYCLES))) {
+            wrong++;
+        }
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(RunControl(1, 1, 0), 0);
+
+    // Off again from rest, two edges a control period: the first
+    // reading has the rate from the second
+    StartRate(-1000, 100);
+    CHECK_EQ(RunControl(20, 20, Degrees(-1000)), 0);
+}
+
+/*
+ * With the controller off the edges pile up in the ring, overflowing
+ * it. Back on, they are dropped rather than taken as one burst: the
+ * first reading is 0 and the next the new rate.
+ */
+static void
+TestRateStaleFlush(void)
+{
+    StartQuad();
+
+    StartRate(2500, 1200);
+    CHECK_EQ(RunControl(100, 50, Degrees(2500)), 0);
+    HostAdvance(HOST_CLOCK_HZ);
+
+    StartRate(-2000, 100);
+    CHECK_EQ(RunControl(1, 1, 0), 0);
+    CHECK_EQ(RunControl(20, 19, Degrees(-2000)), 0);
+}
+
+/*
+ * Pushes and releases RIGHT, a 15 degree setpoint step, polling the
+ * buttons through the debounce as the button task would
+ */
+static void
+PushRight(void)
+{
+    uint32_t i;
+
+    HostGpioSet(GPIO_PORTF_BASE, RIGHT_PUSHED);
+    for (i = 0; i < NUM_BUT_POLLS; i++) {
+        updateButtons();
+    }
+    CheckYawSetButton();
+    HostGpioSet(GPIO_PORTF_BASE, BUTTONS_RELEASED);
+    for (i = 0; i < NUM_BUT_POLLS; i++) {
+        updateButtons();
+    }
+    CheckYawSetButton();
+}
+
+/*
+ * Moves the encoder one count, then lets the heli sit long enough for
+ * the rate to read 0, so only the proportional term acts
+ */
+static void
+Step(int32_t direction)
+{
+    Edges(1, direction);
+    HostGpioSet(GPIO_PORTB_BASE, g_levels[0]);
+    HostAdvance(HOST_CLOCK_HZ);
+}
+
+/*
+ * Tail duty for the controller's reading against the setpoint, with
+ * dt 0 so no integral builds up
+ */
+static int32_t
+TailDuty(void)
+{
+    GetYawAngle();
+    return YawController(0, 0);
+}
+
+/*
+ * Every setpoint against every encoder count, forward through a turn
+ * and back through the negative counts: the controller must act on the
+ * shortest turn, with the duty YAW_KP a degree of it from the
+ * feedforward. A count a turn on reads the same. Exactly half a turn
+ * apart either way is right, so those 8 positions, each met going
+ * forward and back, are left out.
+ */
+static void
+TestShortestError(void)
+{
+    uint32_t mismatches = 0;
+    uint32_t displayErrors = 0;
+    uint32_t pairs = 0;
+    int32_t offset;
+    uint32_t step, n;
+
+    HostGpioSet(GPIO_PORTF_BASE, BUTTONS_RELEASED);
+    initButtons();
+    StartQuad();
+    offset = TailDuty();
+
+    for (step = 0; step < YAW_SETPOINT_STEPS; step++) {
+        int32_t count = 0;
+
+        CHECK_EQ(GetYawSetpoint(), (int32_t)(step * 15 + 180) % 360 - 180);
+        for (n = 0; n < 2 * STEP_MAX; n++) {
+            double error, expected;
+            int32_t deci;
+
+            Step((n < STEP_MAX) ? 1 : -1);
+            count = (int32_t)((n + 1) % STEP_MAX) * ((n < STEP_MAX) ? 1 : -1);
+            if (g_yawGpioSource.Read() != count) {
+                mismatches++;
+                continue;
+            }
+
+            error = remainder(step * 15.0 - count * 360.0 / STEP_MAX, 360.0);
+            deci = GetYaw();
+            if (deci < -1800 || deci >= 1800 ||
+                fabs(remainder(deci / 10.0 - count * 360.0 / STEP_MAX, 360.0)) > 0.05 + 1e-9) {
+                displayErrors++;
+            }
+            if (fabs(error) > 179.99) {
+                continue;
+            }
+            expected = offset + YAW_KP * error;
+            expected = fmin(fmax(expected, MIN_YAW_OUTPUT), MAX_YAW_OUTPUT);
+            if (fabs(TailDuty() - expected) > 4) {
+                mismatches++;
+            }
+            pairs++;
+        }
+        PushRight();
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(displayErrors, 0);
+    CHECK_EQ(pairs, YAW_SETPOINT_STEPS * 2 * STEP_MAX - 2 * 8);
+    CHECK_EQ(GetYawSetpoint(), 0);
+}
+
+/*
+ * The fastest edge stream the decoder keeps up with, from the handler
+ * cycles on the target, and ns per QuadHandler on the host
+ */
+static void
+BenchQuad(void)
+{
+    static const uint32_t handlerCycles[] = {30, QUAD_HANDLER_CYCLES, 120};
+    const uint32_t calls = 10000000;
+    uint64_t start;
+    uint32_t i;
+
+    StartQuad();
+    for (i = 0; i < sizeof(handlerCycles) / sizeof(handlerCycles[0]); i++) {
+        uint32_t period = MinEdgePeriod(handlerCycles[i]);
+        printf("quad: handler %3u cycles, %4u cycles an edge at the least, %6u edges/s, %3u turns/s\n",
+               handlerCycles[i], period, HOST_CLOCK_HZ / period, HOST_CLOCK_HZ / period / STEP_MAX);
+    }
+
+    GPIOIntDisable(GPIO_PORTB_BASE, QUAD_CHANNEL_A | QUAD_CHANNEL_B);
+    start = BenchNs();
+    for (i = 0; i < calls; i++) {
+        HostGpioSet(GPIO_PORTB_BASE, g_phases[i & 3]);
+        QuadHandler();
+    }
+    printf("quad: %.1f ns per QuadHandler on the host\n", (double)(BenchNs() - start) / calls);
+}
+
+/*
+ * ns per control update on the host: the reading as a binary angle,
+ * the shortest error and the PID step
+ */
+static void
+BenchController(void)
+{
+    const uint32_t updates = 10000000;
+    uint64_t start;
+    uint32_t i;
+    volatile int32_t sink = 0;
+
+    StartQuad();
+    start = BenchNs();
+    for (i = 0; i < updates; i++) {
+        GetYawAngle();
+        sink += YawController(1000, 500);
+    }
+    printf("yaw: %.1f ns per GetYawAngle and YawController on the host\n",
+           (double)(BenchNs() - start) / updates);
+    (void)sink;
+}
+
+/*
+ * Encoder count to tenths of a degree, -1800 to 1799, worked in floating
+ * point
+ */
+static int32_t
+CountToDeci(int32_t count)
+{
+    int32_t deci = (int32_t)lround(count * 3600.0 / STEP_MAX) % 3600;
+
+    return (deci >= 1800) ? deci - 3600 : deci;
+}
+
+/*
+ * The QEI backend reads through GetYaw() as the GPIO one does: every
+ * position to within a tenth of a degree, a quarter turn at either
+ * backend's count of STEP_MAX / 4 the same 90 degrees
+ */
+static void
+TestQeiAngle(void)
+{
+    uint32_t offs = 0;
+    uint32_t position;
+
+    InitQuad(&g_yawQeiSource);
+    for (position = 0; position < STEP_MAX; position++) {
+        HostQeiSet(position, 0, 1);
+        if (abs(GetYaw() - CountToDeci(position)) > 1) {
+            offs++;
+        }
+    }
+    CHECK_EQ(offs, 0);
+
+    HostQeiSet(STEP_MAX / 4, 0, 1);
+    CHECK_EQ(GetYaw(), 900);
+    HostQeiSet(STEP_MAX / 2, 0, 1);
+    CHECK_EQ(GetYaw(), -1800);
+    HostQeiSet(STEP_MAX * 3 / 4, 0, 1);
+    CHECK_EQ(GetYaw(), -900);
+
+    StartQuad();
+    Play(Edges(STEP_MAX / 4, 1), 1000);
+    CHECK_EQ(GetYaw(), 900);
+}
+
+/*
+ * The index pulse zeroes the position and sets the reference flag,
+ * once: the handler turns its interrupt off
+ */
+static void
+TestQeiReference(void)
+{
+    InitQuad(&g_yawQeiSource);
+    HostQeiSet(100, 0, 1);
+    CHECK(!Stable());
+
+    HostQeiIndex();
+    CHECK(Stable());
+    CHECK_EQ(GetYaw(), 0);
+    CHECK_EQ(g_yawQeiSource.Read(), 0);
+    CHECK(!HostMasked());
+
+    // A later index still zeroes the position, with no interrupt
+    HostQeiSet(50, 0, 1);
+    HostQeiIndex();
+    CHECK_EQ(g_yawQeiSource.Read(), 0);
+}
+
+/*
+ * Edges per velocity window, signed by direction, reach GetYawRate()
+ * in degrees per second with the controller's reading
+ */
+static void
+TestQeiRate(void)
+{
+    InitQuad(&g_yawQeiSource);
+
+    // 4 edges a 10 ms window back is 400 counts/s
+    HostQeiSet(10, 4, -1);
+    CHECK_EQ(GetYawRate(), 0);
+    GetYawAngle();
+    CHECK_EQ(GetYawRate(), -400 * 360 / STEP_MAX);
+
+    HostQeiSet(20, 7, 1);
+    GetYawAngle();
+    CHECK_EQ(GetYawRate(), 700 * 360 / STEP_MAX);
+
+    HostQeiSet(20, 0, 1);
+    GetYawAngle();
+    CHECK_EQ(GetYawRate(), 0);
+}
+
+int
+main(int argc, char** argv)
+{
+    CheckIsolated(TestCount);
+    CheckIsolated(TestMissedEdge);
+    CheckIsolated(TestEdgeRate);
+    CheckIsolated(TestRateSteps);
+    CheckIsolated(TestRateStartStop);
+    CheckIsolated(TestRateStaleFlush);
+    CheckIsolated(TestShortestError);
+    CheckIsolated(TestQeiAngle);
+    CheckIsolated(TestQeiReference);
+    CheckIsolated(TestQeiRate);
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        CheckIsolated(BenchQuad);
+        CheckIsolated(BenchController);
+    }
+    return CheckDone("yaw");
+}
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+@filename: decode_telemetry.py
+@authors: Mark Day, Noah Walle
+@date: 23.05.2024
+@purpose: Decodes the binary flight data frames sent by SendValues()
+in serial.c from a captured UART byte stream into CSV on stdout. Frames
+are COBS encoded and end in a zero byte; each carries a sequence
+number, so frames lost on the link or to a full TX ring show up as
+gaps. A summary of good, corrupt and dropped frames goes to stderr;
+a corrupt frame also leaves a gap, which isn't counted again as a
+dropped one.
+
+usage: python3 tools/decode_telemetry.py [capture.bin] > flight.csv
+       (reads stdin without a file, e.g. straight from the serial port)
+"""
+
+import struct
+import sys
+
+FRAME_ID = 1
+FRAME = struct.Struct("<BHIhhhhHHhBH")
+PAYLOAD_SIZE = FRAME.size - 2
+
+# Kernel ticks per second (KERNEL_RATE_HZ in tasks.h)
+TICK_HZ = 2000
+
+COLUMNS = ("seq", "time_s", "altitude", "altitude_setpoint", "yaw", "yaw_setpoint",
+           "main_duty", "tail_duty", "yaw_rate", "flying")
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def frames(stream):
+    pending = bytearray()
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            return
+        for byte in chunk:
+            if byte == 0:
+                if pending:
+                    yield bytes(pending)
+                pending.clear()
+            else:
+                pending.append(byte)
+
+
+def main():
+    stream = open(sys.argv[1], "rb") if len(sys.argv) > 1 else sys.stdin.buffer
+    good, corrupt, dropped = 0, 0, 0
+    last_seq = None
+    corrupt_since = 0
+    first = True
+
+    print(",".join(COLUMNS))
+    for encoded in frames(stream):
+        frame = cobs_decode(encoded)
+        valid = (frame is not None and len(frame) == FRAME.size and frame[0] == FRAME_ID and
+                 crc16(frame[:PAYLOAD_SIZE]) == FRAME.unpack(frame)[-1])
+
+        # The capture usually starts part way through a frame
+        if not valid:
+            corrupt += not first
+            corrupt_since += not first
+            first = False
+            continue
+        first = False
+
+        _, seq, ticks, alt, alt_set, yaw, yaw_set, main_duty, tail_duty, rate, flags, _ = FRAME.unpack(frame)
+        if last_seq is not None:
+            dropped += max(((seq - last_seq - 1) & 0xFFFF) - corrupt_since, 0)
+        last_seq = seq
+        corrupt_since = 0
+        good += 1
+
+        print("%d,%.4f,%d,%d,%.1f,%d,%d,%d,%d,%d"
+              % (seq, ticks / TICK_HZ, alt, alt_set, yaw / 10, yaw_set,
+                 main_duty, tail_duty, rate, flags & 1))
+
+    print("%d frames, %d corrupt, %d dropped" % (good, corrupt, dropped), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
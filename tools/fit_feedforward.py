@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+@filename: fit_feedforward.py
+@authors: Mark Day, Noah Walle
+@date: 22.05.2024
+@purpose: Fits the main to tail feedforward in yaw.c from a flight
+log: the CSV from tools/decode_telemetry.py, or the text lines sent
+with TELEMETRY_BINARY 0. Samples where the heli hovers clear of the
+ground under the yaw controller, holding both setpoints, show the tail
+duty that balances each main duty; a least squares line through them
+gives YAW_FF_BIAS and YAW_FF_GAIN. Hover at a few altitudes in the log
+so the main duty has some spread, and refit on a flight flown with the
+new constants: the tail integral still carries some of the old ones.
+
+usage: python3 tools/fit_feedforward.py flight.csv|log.txt
+"""
+
+import csv
+import re
+import sys
+
+LINE = re.compile(r"a(-?\d+)\tA(-?\d+)\ty(-?\d+)\tY(-?\d+)\tMD(\d+)\tTD(\d+)\tOM(\d+)")
+
+# A sample counts as balanced when yaw is this close to the setpoint
+# and hasn't moved more than this since the line before, in degrees
+MAX_ERROR_DEG = 3
+MAX_STEP_DEG = 1
+
+# Likewise hovering: height this close to its setpoint, in percent, and
+# the main duty this still, in permille. Through a step the main duty
+# sits at a limit with the rotors lagging it and the tail catching up.
+MAX_ALT_ERROR = 3
+MAX_MAIN_STEP = 10
+
+# Below this height (percent) the rig may be holding the heli, and with
+# the tail off the takeoff ramp is still running, not the controller
+MIN_ALTITUDE = 5
+
+# Duties in the text log are percent, the feedforward works in permille
+PERMILLE_PER_PERCENT = 10
+
+
+def angle_diff(a, b):
+    return (a - b + 180) % 360 - 180
+
+
+def read_records(path):
+    """(altitude, its setpoint, yaw, yaw setpoint, main permille, tail permille,
+    flying) per line"""
+    log = open(path, errors="replace")
+    if log.readline().startswith("seq,"):
+        log.seek(0)
+        for row in csv.DictReader(log):
+            yield (int(row["altitude"]), int(row["altitude_setpoint"]), float(row["yaw"]),
+                   int(row["yaw_setpoint"]), int(row["main_duty"]), int(row["tail_duty"]),
+                   int(row["flying"]))
+        return
+
+    log.seek(0)
+    for line in log:
+        match = LINE.search(line)
+        if match:
+            altitude, alt_set, yaw, yaw_set, main, tail, flying = (int(v) for v in match.groups())
+            yield (altitude, alt_set, yaw, yaw_set, main * PERMILLE_PER_PERCENT,
+                   tail * PERMILLE_PER_PERCENT, flying)
+
+
+def read_samples(path):
+    samples = []
+    prev_yaw = None
+    prev_main = None
+    for altitude, alt_set, yaw, yaw_set, main, tail, flying in read_records(path):
+        steady = (prev_yaw is not None and abs(angle_diff(yaw, prev_yaw)) <= MAX_STEP_DEG
+                  and abs(main - prev_main) <= MAX_MAIN_STEP)
+        prev_yaw = yaw
+        prev_main = main
+        clear = altitude >= MIN_ALTITUDE and tail > 0
+        hovering = abs(altitude - alt_set) <= MAX_ALT_ERROR
+        balanced = abs(angle_diff(yaw, yaw_set)) <= MAX_ERROR_DEG
+        if flying and clear and hovering and steady and balanced:
+            samples.append((main, tail))
+    return samples
+
+
+def fit(samples):
+    n = len(samples)
+    sx = sum(x for x, _ in samples)
+    sy = sum(y for _, y in samples)
+    sxx = sum(x * x for x, _ in samples)
+    sxy = sum(x * y for x, y in samples)
+    spread = n * sxx - sx * sx
+    if spread == 0:
+        return sy / n, 0.0
+    gain = (n * sxy - sx * sy) / spread
+    return (sy - gain * sx) / n, gain
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: fit_feedforward.py flight.csv|log.txt")
+
+    samples = read_samples(sys.argv[1])
+    if len(samples) < 2:
+        sys.exit("need at least 2 balanced samples, found %d" % len(samples))
+
+    bias, gain = fit(samples)
+    mains = [x for x, _ in samples]
+    residual = (sum((y - bias - gain * x) ** 2 for x, y in samples) / len(samples)) ** 0.5
+    if min(mains) == max(mains):
+        print("main duty never changed, fitted the bias only")
+
+    print("%d samples, main %d to %d permille, rms residual %.1f permille"
+          % (len(samples), min(mains), max(mains), residual))
+    print("#define YAW_FF_BIAS %d" % round(bias))
+    print("#define YAW_FF_GAIN %.3ff" % gain)
+
+
+if __name__ == "__main__":
+    main()
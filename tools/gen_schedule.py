@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""
+@filename: gen_schedule.py
+@authors: Mark Day, Noah Walle
+@date: 16.05.2024
+@purpose: Builds the cyclic executive schedule for the task set in
+tasks.h and writes it to schedule.h. Phases are assigned exactly as
+AssignPhases() in kernel.c does, and the major frame is the LCM of the
+background task periods. Only ticks that release a background task
+are stored; foreground tasks run from the tick interrupt on their own
+phase but still count towards the tick load. Event tasks have no phase
+and are left out. Prints the
+dispatch sequence and tick load so it can be checked before flashing.
+
+usage: python3 tools/gen_schedule.py [tasks.h] [schedule.h]
+"""
+
+import re
+import sys
+from functools import reduce
+from math import gcd
+
+# Frames are uint32_t masks of task ids, ticks are uint16_t
+MAX_TASKS = 32
+MAX_MAJOR_TICKS = 65535
+
+
+def read_tasks(path):
+    text = open(path).read()
+    defines = dict(re.findall(r"^#define\s+(\w+)\s+(\w+)\s*$", text, re.M))
+
+    def symbol(token):
+        token = token.strip()
+        while token in defines:
+            token = defines[token]
+        return token
+
+    def value(token):
+        return int(symbol(token))
+
+    tasks = []
+    for args in re.findall(r"^\s*TASK\(([^)]*)\)", text, re.M):
+        fields = [f.strip() for f in args.split(",")]
+        if fields[0] == "function":
+            continue
+        tasks.append({"name": fields[0],
+                      "ticks": max(value(fields[1]), 1),
+                      "priority": value(fields[2]),
+                      "wcet": value(fields[4]),
+                      "foreground": len(fields) > 6 and symbol(fields[6]) == "TIER_FOREGROUND",
+                      "event": len(fields) > 7 and symbol(fields[7]) == "ACTIVATE_EVENT",
+                      "phase": None})
+    return tasks, value("KERNEL_RATE_HZ")
+
+
+def load_us(task, rate_hz):
+    # Best effort tasks are assumed to fill the tick
+    return task["wcet"] if task["wcet"] else 1000000 // rate_hz
+
+
+def assign_phases(tasks, rate_hz):
+    order = sorted([t for t in tasks if not t["event"]],
+                   key=lambda t: (t["ticks"], t["priority"]))
+    for i, task in enumerate(order):
+        best_cost, best_phase = None, 0
+        for phase in range(task["ticks"]):
+            cost = 0
+            for other in order[:i]:
+                common = gcd(task["ticks"], other["ticks"])
+                if phase % common == other["phase"] % common:
+                    cost += load_us(other, rate_hz)
+            if best_cost is None or cost < best_cost:
+                best_cost, best_phase = cost, phase
+            if cost == 0:
+                break
+        task["phase"] = best_phase
+
+
+def lcm(values):
+    return reduce(lambda a, b: a * b // gcd(a, b), values, 1)
+
+
+def build_schedule(tasks, rate_hz):
+    periodic = [t for t in tasks if not t["event"]]
+    major = lcm([t["ticks"] for t in periodic if not t["foreground"]])
+    if major > MAX_MAJOR_TICKS:
+        sys.exit("major frame of %d ticks is too long" % major)
+
+    # The load repeats over every task's period, the frames over the
+    # background periods only
+    hyperperiod = lcm([t["ticks"] for t in periodic])
+    frames = []
+    peak, total = 0, 0
+    for tick in range(hyperperiod):
+        mask, load = 0, 0
+        for i, task in enumerate(tasks):
+            if not task["event"] and tick % task["ticks"] == task["phase"]:
+                if not task["foreground"]:
+                    mask |= 1 << i
+                load += load_us(task, rate_hz)
+        if mask and tick < major:
+            frames.append((tick, mask))
+        peak = max(peak, load)
+        total += load
+    return major, frames, peak, total // hyperperiod
+
+
+def write_header(path, tasks, major, frames):
+    with open(path, "w") as out:
+        out.write("#ifndef SCHEDULE_H\n#define SCHEDULE_H\n\n")
+        out.write("/**\n")
+        out.write(" * @filename: schedule.h\n")
+        out.write(" * @purpose: Cyclic executive schedule, generated by\n")
+        out.write(" * tools/gen_schedule.py from tasks.h. Do not edit.\n")
+        out.write(" * Bit n of a frame is task id n:\n")
+        for i, task in enumerate(tasks):
+            if task["event"]:
+                timing = "on event, %4d ticks apart" % task["ticks"]
+            else:
+                timing = "every %4d ticks, phase %d" % (task["ticks"], task["phase"])
+            out.write(" *   %2d %-16s %s%s\n"
+                      % (i, task["name"], timing,
+                         ", foreground" if task["foreground"] else ""))
+        out.write("**/\n\n#include \"kernel.h\"\n\n")
+        out.write("#define CYCLIC_MAJOR_TICKS %d\n" % major)
+        out.write("#define CYCLIC_NUM_FRAMES %d\n\n" % len(frames))
+        out.write("static const CyclicFrame_t g_cyclicSchedule[CYCLIC_NUM_FRAMES] = {\n")
+        for start in range(0, len(frames), 6):
+            row = ", ".join("{%d, 0x%02x}" % f for f in frames[start:start + 6])
+            out.write("    %s,\n" % row)
+        out.write("};\n\n#endif\n")
+
+
+def main():
+    tasks_path = sys.argv[1] if len(sys.argv) > 1 else "tasks.h"
+    header_path = sys.argv[2] if len(sys.argv) > 2 else "schedule.h"
+
+    tasks, rate_hz = read_tasks(tasks_path)
+    if not tasks or len(tasks) > MAX_TASKS:
+        sys.exit("need 1 to %d tasks, found %d" % (MAX_TASKS, len(tasks)))
+
+    assign_phases(tasks, rate_hz)
+    major, frames, peak, mean = build_schedule(tasks, rate_hz)
+    write_header(header_path, tasks, major, frames)
+
+    print("major frame %d ticks, %d frames, tick load peak %d us mean %d us"
+          % (major, len(frames), peak, mean))
+    for tick, mask in frames:
+        names = [t["name"] for i, t in enumerate(tasks) if mask & (1 << i)]
+        print("%6d  %s" % (tick, " ".join(names)))
+
+
+if __name__ == "__main__":
+    main()
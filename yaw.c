@@ -6,85 +6,163 @@
 **/
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "inc/hw_gpio.h"
 #include "driverlib/gpio.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/qei.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/interrupt.h"
 #include "buttons4.h"
 
 #include "motors.h"
+#include "pid.h"
+#include "kernel.h"
+#include "ring.h"
 #include "yaw.h"
 
-// Define encoder values and convertsion to degrees 
-#define STEP_MAX 448
-#define YAW_SCALE 360 * 10 / STEP_MAX
-
-// Max/Min values for Motors
-#define MAX_YAW_OUTPUT 70
-#define MIN_YAW_OUTPUT 2
-
-// Encoder Pins
-#define QUAD_CHANNEL_A GPIO_PIN_0
-#define QUAD_CHANNEL_B GPIO_PIN_1
-#define REF_CHANNEL    GPIO_PIN_4
+// Yaw is a binary angle, BAM_TURN to the turn, so uint16_t arithmetic
+// wraps at 360 degrees and (int16_t)(a - b) is the shortest turn from
+// b to a. Degrees only appear at the display and telemetry.
+#define BAM_TURN 65536
+#define DECIDEGREES_TURN 3600
+
+// Setpoints are 15 degree steps, kept as a step index so they land
+// back on 0 exactly
+#define YAW_SETPOINT_STEPS 24
+
+// The controller sees errors in 1/1024 turn (0.35 degrees), finer
+// than the encoder and coarse enough for Ki to fit in Q16.16
+#define YAW_PID_SHIFT 6
+#define DEGREES_PER_PID_UNIT (360.0f / (BAM_TURN >> YAW_PID_SHIFT))
+
+// Tail duty that cancels the main rotor's reaction torque, in
+// permille: YAW_FF_BIAS + YAW_FF_GAIN * main duty. The controller works
+// around it, so an altitude step no longer has to turn the heli before
+// the tail responds. These give the old fixed 40% tail until both are
+// fitted with tools/fit_feedforward.py from a log of the real rig.
+#define YAW_FF_BIAS 400
+#define YAW_FF_GAIN 0.0f
+
+// Max/Min values for Motors, duty in permille
+#define MAX_YAW_OUTPUT 700
+#define MIN_YAW_OUTPUT 20
+
+// QEI0 pins, for an encoder wired to PD6 (A), PD7 (B) and PD3 (index).
+// PD7 is an NMI pin and has to be unlocked.
+#define QEI_CHANNEL_A  GPIO_PIN_6
+#define QEI_CHANNEL_B  GPIO_PIN_7
+#define QEI_INDEX      GPIO_PIN_3
+
+// The QEI counts edges over 1 / QEI_VELOCITY_HZ windows for its rate
+#define QEI_VELOCITY_HZ 100
+
+// Encoder backend chosen by InitQuad
+static const YawSource_t* g_yawSource;
 
 // Encoder Pin states
 static uint8_t g_previousState;
-static uint8_t g_previousState;
 static int16_t g_yaw;
 
-// Global for yawController 
+// Yaw step for each (previous state << 2 | state), B the high bit.
+// Forward runs 00, 01, 11, 10.
+static const int8_t g_quadTable[16] = {
+     0, +1, -1,  0,
+    -1,  0,  0, +1,
+    +1,  0,  0, -1,
+     0, -1, +1,  0
+};
+
+// Indices where both channels changed at once (00-11, 01-10 and back):
+// an edge was missed and the direction is unknown
+#define QUAD_ILLEGAL ((1 << 0x3) | (1 << 0x6) | (1 << 0x9) | (1 << 0xC))
+static volatile uint32_t g_missedEdges;
+
+// Each counted edge with its time, from QuadHandler to the rate
+// estimator. 32 edges cover a control period up to 16k edges/s.
+typedef struct {
+    uint32_t Cycles;
+    int8_t Step;
+} YawEdge_t;
+
+#define EDGE_RING_SIZE 32
+static YawEdge_t g_edgeStore[EDGE_RING_SIZE];
+static Ring_t g_edgeRing;
+
+// Rate estimator. With no edge for 1 / RATE_IDLE_HZ the heli reads
+// as stopped and the next edge only restarts the timing. The same goes
+// after the estimator hasn't run for that long (controller off), as the
+// edges queued meanwhile are stale.
+#define RATE_IDLE_HZ 2
+static uint32_t g_cyclesPerSecond;
+static uint32_t g_rateLastCall;
+static uint32_t g_rateLastEdge;
+static bool g_rateIdle = true;
+static int32_t g_rateEstimate;
+
+// Latest rate in counts per second, taken with the controller's reading
+static int32_t g_yawRate;
+
+// Global for yawController. g_yawOffset is the tail duty (percent)
+// turning the heli to find the reference.
 static int32_t g_yawOffset = 40;
+static int32_t g_yawFeedforwardBias = YAW_FF_BIAS;
+static q16_t g_yawFeedforwardGain = FLOAT_TO_Q16(YAW_FF_GAIN);
 static int32_t g_yawControlEffort;
 static int32_t g_yawError;
-float g_yawDeltaT = 0.0005;
+static uint8_t g_yawSetpointStep;
 
 // flag set at first zero degree interupt
 bool g_refFlag = 0;
 
-// Struct for control parameters 
+// Struct for control parameters. setpoint and read_value are binary
+// angles, the gains permille of duty per degree scaled to the
+// controller's units. More tail thrust turns the heli towards lower
+// yaw, hence the negative gains. The angle wraps and is quantised, so
+// the derivative comes from the measured rate in read_rate rather
+// than differencing.
 static PID_t g_yawControl = {.setpoint = 0,
                              .prev_setpoint = 0,
                              .read_value = 0,
                              .prev_read_value = 0,
-                             .Kp = 0.89,
-                             .Ki = 0.02,
-                             .Kd = 0};
+                             .Kp = -8.9 * DEGREES_PER_PID_UNIT,
+                             .Ki = -0.005 * DEGREES_PER_PID_UNIT,
+                             .Kd = -0.45 * DEGREES_PER_PID_UNIT,
+                             .RateInput = true,
+                             .DFilter = 0.5,
+                             .Kt = 0.0006,
+                             .OutMin = MIN_YAW_OUTPUT,
+                             .OutMax = MAX_YAW_OUTPUT};
 
 /*
- * Interrupt Handler for the encoder Pins iterates yaw based on encoder state
+ * Interrupt Handler for the encoder Pins iterates yaw based on encoder state.
+ * The same few instructions on every edge: the step comes from
+ * g_quadTable, an illegal jump is counted from QUAD_ILLEGAL. Counted
+ * edges are timestamped into g_edgeRing for the rate estimator.
  */
 void
 QuadHandler(void)
 {
-    g_previousState = g_previousState;
-    g_previousState = GPIOPinRead(GPIO_PORTB_BASE, QUAD_CHANNEL_A | QUAD_CHANNEL_B);
-    if (g_previousState == 0b00) {
-        if (g_previousState == 0b01) {
-            g_yaw++;
-        } else if (g_previousState == 0b10) {
-            g_yaw--;
-        }
-    } else if (g_previousState == 0b01) {
-        if (g_previousState == 0b11) {
-            g_yaw++;
-        } else if (g_previousState == 0b00) {
-            g_yaw--;
-        }
-    } else if (g_previousState == 0b10) {
-        if (g_previousState == 0b11) {
-            g_yaw--;
-        } else if (g_previousState == 0b00) {
-            g_yaw++;
-        }
-    } else if (g_previousState == 0b11) {
-        if (g_previousState == 0b01) {
-            g_yaw--;
-        } else if (g_previousState == 0b10) {
-            g_yaw++;
-        }
+    uint8_t state;
+    uint8_t index;
+    YawEdge_t edge;
+
+    edge.Cycles = GetCycleCount();
+    state = GPIOPinRead(GPIO_PORTB_BASE, QUAD_CHANNEL_A | QUAD_CHANNEL_B);
+    index = (g_previousState << 2) | state;
+    g_previousState = state;
+
+    edge.Step = g_quadTable[index];
+    g_yaw += edge.Step;
+    g_missedEdges += (QUAD_ILLEGAL >> index) & 1;
+
+    if (edge.Step != 0) {
+        RingWrite(&g_edgeRing, &edge);
     }
+
     // Zeros yaw if a full cycle is completed
     // Has redundancy with reference interrupt
     if (g_yaw >= STEP_MAX || g_yaw <= -STEP_MAX)
@@ -112,15 +190,19 @@ RefHandler(void)
 /*
  * Initialises Both Interrupts (RefHandler, QuadHandler)
  */
-void
-InitQuad(void)
+static void
+YawGpioInit(void)
 {
+    RingInit(&g_edgeRing, g_edgeStore, EDGE_RING_SIZE, sizeof(YawEdge_t));
+    g_cyclesPerSecond = SysCtlClockGet();
+
     SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);
     GPIOPinTypeGPIOInput(GPIO_PORTB_BASE, QUAD_CHANNEL_A | QUAD_CHANNEL_B);
 
     GPIOIntDisable(GPIO_PORTB_BASE, QUAD_CHANNEL_A | QUAD_CHANNEL_B);
     GPIOIntClear(GPIO_PORTB_BASE, QUAD_CHANNEL_A | QUAD_CHANNEL_B);
 
+    g_previousState = GPIOPinRead(GPIO_PORTB_BASE, QUAD_CHANNEL_A | QUAD_CHANNEL_B);
     GPIOIntRegister(GPIO_PORTB_BASE, QuadHandler);
     GPIOIntTypeSet(GPIO_PORTB_BASE, QUAD_CHANNEL_A | QUAD_CHANNEL_B, GPIO_BOTH_EDGES);
 
@@ -139,64 +221,277 @@ InitQuad(void)
 }
 
 /*
- * Returns Value of Yaw in degrees
- * Updates the read_value in g_yawControl
- * Updates the prev_read_value in g_yawControl
+ * Count kept by QuadHandler
  */
-int16_t
-GetYaw(void)
+static int16_t
+YawGpioRead(void)
 {
-    int32_t new_yaw;
-    g_yawControl.prev_read_value = g_yawControl.read_value;
+    return g_yaw;
+}
 
-    if (abs(g_yaw) <= (STEP_MAX / 2))
-    {
-        g_yawControl.read_value = g_yaw * YAW_SCALE / 10;
-        return g_yaw * YAW_SCALE;
-    } else {
-        if (g_yaw > 0) {
-            new_yaw = g_yaw - 448;
+/*
+ * Drops the queued edges and waits for the next one to start timing
+ */
+static void
+YawRateRestart(void)
+{
+    RingConsume(&g_edgeRing, RingCount(&g_edgeRing));
+    g_rateIdle = true;
+    g_rateEstimate = 0;
+}
+
+/*
+ * Counts per second from the edge timestamps (M/T method): the counts
+ * since the last call over the time between the last edge before them
+ * and the newest. Fast, that is edge counting over a precisely timed
+ * span; slow, with an edge or less per call, it is the period of the
+ * last edge. With no new edge the rate can be no more than one count
+ * over the time since the last, so it decays while slowing to a stop.
+ */
+static int32_t
+YawGpioRate(void)
+{
+    YawEdge_t edge;
+    uint32_t edges = 0;
+    int32_t counts = 0;
+    uint32_t now = GetCycleCount();
+    uint32_t last = g_rateLastEdge;
+    uint32_t since;
+    int32_t limit;
+
+    if (now - g_rateLastCall > g_cyclesPerSecond / RATE_IDLE_HZ) {
+        YawRateRestart();
+    }
+    g_rateLastCall = now;
+
+    while (RingCount(&g_edgeRing) > 0) {
+        RingRead(&g_edgeRing, &edge);
+        if (g_rateIdle) {
+            // First edge from rest only starts the timing
+            g_rateIdle = false;
+            g_rateEstimate = 0;
+            g_rateLastEdge = edge.Cycles;
         } else {
-            new_yaw = g_yaw + 448;
+            counts += edge.Step;
+            edges++;
         }
-        g_yawControl.read_value = g_yaw * YAW_SCALE / 10;
-        return new_yaw * YAW_SCALE;
+        last = edge.Cycles;
+    }
+
+    if (edges > 0) {
+        g_rateEstimate = (int64_t)counts * g_cyclesPerSecond / (last - g_rateLastEdge);
+        g_rateLastEdge = last;
+        return g_rateEstimate;
     }
+    g_rateLastEdge = last;
+
+    if (g_rateIdle) {
+        return 0;
+    }
+
+    since = GetCycleCount() - g_rateLastEdge;
+    if (since > g_cyclesPerSecond / RATE_IDLE_HZ) {
+        YawRateRestart();
+        return 0;
+    }
+
+    // An edge read on the cycle it came is a cycle old
+    limit = g_cyclesPerSecond / (since ? since : 1);
+    if (g_rateEstimate > limit) {
+        return limit;
+    } else if (g_rateEstimate < -limit) {
+        return -limit;
+    }
+    return g_rateEstimate;
+}
+
+/*
+ * QEI index interrupt: the QEI has zeroed its position on the
+ * reference, as RefHandler does for the GPIO backend
+ */
+void
+QeiIndexHandler(void)
+{
+    QEIIntClear(QEI0_BASE, QEI_INTINDEX);
+    g_refFlag = 1;
+    QEIIntDisable(QEI0_BASE, QEI_INTINDEX);
+}
+
+/*
+ * Sets up QEI0 to count every edge of both channels over one turn,
+ * zero on the index pulse and time its velocity
+ */
+static void
+YawQeiInit(void)
+{
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_QEI0);
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOD);
+
+    HWREG(GPIO_PORTD_BASE + GPIO_O_LOCK) = GPIO_LOCK_KEY;
+    HWREG(GPIO_PORTD_BASE + GPIO_O_CR) |= QEI_CHANNEL_B;
+    HWREG(GPIO_PORTD_BASE + GPIO_O_LOCK) = 0;
+
+    GPIOPinConfigure(GPIO_PD6_PHA0);
+    GPIOPinConfigure(GPIO_PD7_PHB0);
+    GPIOPinConfigure(GPIO_PD3_IDX0);
+    GPIOPinTypeQEI(GPIO_PORTD_BASE, QEI_CHANNEL_A | QEI_CHANNEL_B | QEI_INDEX);
+
+    QEIConfigure(QEI0_BASE, QEI_CONFIG_CAPTURE_A_B | QEI_CONFIG_RESET_IDX | QEI_CONFIG_QUADRATURE |
+                 QEI_CONFIG_NO_SWAP, STEP_MAX - 1);
+    QEIVelocityConfigure(QEI0_BASE, QEI_VELDIV_1, SysCtlClockGet() / QEI_VELOCITY_HZ);
+    QEIPositionSet(QEI0_BASE, 0);
+
+    QEIIntRegister(QEI0_BASE, QeiIndexHandler);
+    QEIIntEnable(QEI0_BASE, QEI_INTINDEX);
+
+    QEIVelocityEnable(QEI0_BASE);
+    QEIEnable(QEI0_BASE);
+}
+
+/*
+ * QEI position, 0 to STEP_MAX - 1
+ */
+static int16_t
+YawQeiRead(void)
+{
+    return QEIPositionGet(QEI0_BASE);
+}
+
+/*
+ * Counts per second from the QEI velocity timer, signed by direction
+ */
+static int32_t
+YawQeiRate(void)
+{
+    return (int32_t)QEIVelocityGet(QEI0_BASE) * QEI_VELOCITY_HZ * QEIDirectionGet(QEI0_BASE);
+}
+
+const YawSource_t g_yawGpioSource = {.Init = YawGpioInit, .Read = YawGpioRead, .Rate = YawGpioRate};
+const YawSource_t g_yawQeiSource = {.Init = YawQeiInit, .Read = YawQeiRead, .Rate = YawQeiRate};
+
+/*
+ * Sets up yaw sensing through source
+ */
+void
+InitQuad(const YawSource_t* source)
+{
+    g_yawSource = source;
+    source->Init();
+
+    PidInit(&g_yawControl);
+}
+
+/*
+ * Yaw rate in degrees per second as of the controller's last reading,
+ * 0 if the backend can't measure it
+ */
+int32_t
+GetYawRate(void)
+{
+    return g_yawRate * 360 / STEP_MAX;
+}
+
+/*
+ * Encoder count, within a turn of 0, to binary angle. The count is
+ * moved up a turn first so the division always rounds down: counts a
+ * whole turn apart give exactly the same angle, so no folding is needed.
+ */
+static uint16_t
+CountToAngle(int16_t count)
+{
+    return (uint16_t)(((int32_t)count + STEP_MAX) * BAM_TURN / STEP_MAX);
+}
+
+/*
+ * Binary angle to the nearest tenth of a degree, -1800 to 1799.
+ * Setpoints fall between binary angles, so truncating would show 30
+ * degrees as 29.9.
+ */
+static int16_t
+AngleToDeciDegrees(uint16_t angle)
+{
+    int32_t deci = ((uint32_t)angle * DECIDEGREES_TURN + BAM_TURN / 2) / BAM_TURN % DECIDEGREES_TURN;
+
+    return (deci >= DECIDEGREES_TURN / 2) ? deci - DECIDEGREES_TURN : deci;
+}
+
+/*
+ * Current yaw as a binary angle
+ */
+static uint16_t
+ReadYawAngle(void)
+{
+    return CountToAngle(g_yawSource->Read());
+}
+
+/*
+ * Returns yaw as a binary angle and makes it, and the rate, the
+ * controller's reading, stamped with the cycle count it was read at.
+ * For the controller only: the GPIO rate estimator drains the edge ring.
+ */
+uint16_t
+GetYawAngle(void)
+{
+    uint16_t angle = ReadYawAngle();
+
+    g_yawControl.read_cycles = GetCycleCount();
+
+    g_yawRate = (g_yawSource->Rate != NULL) ? g_yawSource->Rate() : 0;
+    g_yawControl.read_value = angle;
+    g_yawControl.read_rate = g_yawRate * (BAM_TURN >> YAW_PID_SHIFT) / STEP_MAX;
+    return angle;
+}
+
+/*
+ * Returns Value of Yaw in tenths of a degree, for display and telemetry
+ */
+int16_t
+GetYaw(void)
+{
+    return AngleToDeciDegrees(ReadYawAngle());
+}
+
+/*
+ * Tail duty in permille to balance the torque of the main rotor at
+ * mainPermille
+ */
+static int32_t
+YawFeedforward(int32_t mainPermille)
+{
+    return g_yawFeedforwardBias + (int32_t)(((int64_t)g_yawFeedforwardGain * mainPermille) >> 16);
+}
+
+/*
+ * Replaces the feedforward's YAW_FF_BIAS and YAW_FF_GAIN, e.g. with a
+ * fit being tried out
+ */
+void
+SetYawFeedforward(int32_t bias, float gain)
+{
+    g_yawFeedforwardBias = bias;
+    g_yawFeedforwardGain = FLOAT_TO_Q16(gain);
 }
 
 /*
  * (Inspired by Ciaran Moore Lecture notes)
- * PI Controller for Yaw
+ * PI Controller for Yaw, dtUs since its last run, on top of the
+ * feedforward for the main duty about to be set. Returns the tail
+ * duty in permille
  */
 int16_t 
-YawController(void) 
+YawController(uint32_t dtUs, int32_t mainPermille) 
 {
-    static float iSum = 0;
-
     // Resets I_sum for new setpoint
     if (g_yawControl.setpoint != g_yawControl.prev_setpoint) {
-        iSum= 0;
+        PidResetIntegral(&g_yawControl);
         g_yawControl.prev_setpoint = g_yawControl.setpoint;
     }
 
-    // Logic for choosing the shortest distance to setpoint 
-    g_yawError = g_yawControl.read_value - g_yawControl.setpoint;
-    if (abs(g_yawError) > 180) {
-        g_yawError = g_yawControl.read_value + g_yawControl.setpoint;
-    }
-
-    float pControl = g_yawControl.Kp * g_yawError;
-    float iControl = g_yawControl.Ki * g_yawError * g_yawDeltaT; 
-    g_yawControlEffort = pControl + iSum + iControl + g_yawOffset;
+    // Modular difference is the shortest distance to setpoint
+    g_yawError = (int16_t)(g_yawControl.setpoint - g_yawControl.read_value) >> YAW_PID_SHIFT;
 
-    iSum = (iSum + iControl);
-
-    // limits g_yawControlEffort to values that the motor is able to take
-    if (g_yawControlEffort > MAX_YAW_OUTPUT) {
-        g_yawControlEffort = MAX_YAW_OUTPUT;
-    } else if(g_yawControlEffort < MIN_YAW_OUTPUT) {
-        g_yawControlEffort = MIN_YAW_OUTPUT;
-    }
+    g_yawControl.Offset = YawFeedforward(mainPermille);
+    g_yawControlEffort = PidStep(&g_yawControl, g_yawError, dtUs);
 
     return g_yawControlEffort;
 }
@@ -209,28 +504,46 @@ CheckYawSetButton(void)
 {
     uint8_t butState = checkButton(RIGHT);
     if (butState == PUSHED) {
-        g_yawControl.prev_setpoint = g_yawControl.setpoint;
-        g_yawControl.setpoint += 15;
+        g_yawSetpointStep = (g_yawSetpointStep + 1) % YAW_SETPOINT_STEPS;
     }
     butState = checkButton(LEFT);
     if (butState == PUSHED) {
-        g_yawControl.prev_setpoint = g_yawControl.setpoint;
-        g_yawControl.setpoint -= 15;
+        g_yawSetpointStep = (g_yawSetpointStep + YAW_SETPOINT_STEPS - 1) % YAW_SETPOINT_STEPS;
     }
 
-    // sets the "wrap-around"
-    if (g_yawControl.setpoint > 180) {
-        g_yawControl.setpoint = g_yawControl.setpoint - 360;
-    } else if (g_yawControl.setpoint <= -180) {
-        g_yawControl.setpoint += 360;
+    int32_t setpoint = (uint16_t)((g_yawSetpointStep * BAM_TURN + YAW_SETPOINT_STEPS / 2) /
+                                  YAW_SETPOINT_STEPS);
+    if (setpoint != g_yawControl.setpoint) {
+        g_yawControl.prev_setpoint = g_yawControl.setpoint;
+        g_yawControl.setpoint = setpoint;
     }
 }
 
 
+/*
+ * Encoder transitions that skipped a state, each one a lost count
+ */
+uint32_t
+GetYawMissedEdges(void)
+{
+    return g_missedEdges;
+}
+
+/*
+ * Cycle count (GetCycleCount) when the controller last read yaw.
+ * The count is kept up to date by the encoder, so the reading is as
+ * old as that read, however long ago the last edge was.
+ */
+uint32_t
+GetYawSampleCycles(void)
+{
+    return g_yawControl.read_cycles;
+}
+
 int16_t
 GetYawSetpoint(void)
 {
-    return g_yawControl.setpoint;
+    return AngleToDeciDegrees(g_yawControl.setpoint) / 10;
 }
 
 /*
@@ -240,7 +553,7 @@ GetYawSetpoint(void)
 bool
 Stable(void)
 {
-    if (g_yaw != 0) {
+    if (ReadYawAngle() != 0) {
         SetTailPWM(g_yawOffset);
     }
     return g_refFlag;
@@ -253,7 +566,8 @@ Stable(void)
 uint8_t
 YawLand(void)
 {
-    if (GetYaw() != 0){
+    if (ReadYawAngle() != 0){
+        g_yawSetpointStep = 0;
         g_yawControl.setpoint = 0;
         return 0;
     } else {
@@ -12,6 +12,32 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Define encoder values and convertsion to degrees 
+#define STEP_MAX 448
+
+// Encoder Pins, PB0/PB1 and the PC4 reference
+#define QUAD_CHANNEL_A GPIO_PIN_0
+#define QUAD_CHANNEL_B GPIO_PIN_1
+#define REF_CHANNEL    GPIO_PIN_4
+
+/*
+ * Where the encoder count comes from. Read returns the current count,
+ * within a turn of 0. Rate gives counts per second, NULL if the
+ * backend can't; it is called once per control period.
+ */
+typedef struct {
+    void (*Init)(void);
+    int16_t (*Read)(void);
+    int32_t (*Rate)(void);
+} YawSource_t;
+
+// Edge interrupts on PB0/PB1 decoded in QuadHandler, PC4 reference
+extern const YawSource_t g_yawGpioSource;
+
+// QEI0 on PD6/PD7 with the index on PD3, counting and timing in
+// hardware with no interrupt per edge
+extern const YawSource_t g_yawQeiSource;
+
 void
 QuadHandler(void);
 
@@ -19,17 +45,35 @@ void
 RefHandler(void);
 
 void
-InitQuad(void);
+QeiIndexHandler(void);
+
+void
+InitQuad(const YawSource_t* source);
+
+int32_t
+GetYawRate(void);
+
+uint16_t
+GetYawAngle(void);
 
 int16_t
 GetYaw(void);
 
 int16_t 
-YawController(void);
+YawController(uint32_t dtUs, int32_t mainPermille);
+
+void
+SetYawFeedforward(int32_t bias, float gain);
 
 void
 CheckYawSetButton(void);
 
+uint32_t
+GetYawMissedEdges(void);
+
+uint32_t
+GetYawSampleCycles(void);
+
 int16_t
 GetYawSetpoint(void);
 